@@ -0,0 +1,146 @@
+#include <arpa/inet.h>
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "waxwing/server.hh"
+
+namespace {
+using waxwing::ServeMode;
+
+constexpr std::string_view HOST = "127.0.0.1";
+constexpr uint16_t BASE_PORT = 18480;
+constexpr std::string_view REQUEST =
+    "GET /hello HTTP/1.1\r\nHost: bench\r\n\r\n";
+
+uint16_t port(const ServeMode mode) {
+    return BASE_PORT + static_cast<uint16_t>(mode);
+}
+
+/// Start serving on a background thread, which lives until the process exits
+void start_server(const ServeMode mode) {
+    static std::array<bool, 3> started{};
+    if (started[static_cast<size_t>(mode)]) {
+        return;
+    }
+    started[static_cast<size_t>(mode)] = true;
+
+    auto server = std::make_unique<waxwing::Server>();
+    server->route(waxwing::HttpMethod::Get, "/hello", [] {
+        return waxwing::ResponseBuilder{waxwing::HttpStatusCode::Ok_200}
+            .body("Hello world!")
+            .content_type(waxwing::content_type::plaintext)
+            .build();
+    });
+    server->configure({
+        .max_requests_per_connection = 0,
+        .idle_timeout = std::chrono::milliseconds::zero(),
+    });
+
+    const waxwing::Result<void, std::string> bound =
+        server->bind(HOST, port(mode));
+    if (!bound) {
+        spdlog::error("{}", bound.error());
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::thread{[server = std::move(server), mode] { server->serve(mode); }}
+        .detach();
+}
+
+int connect_to(const ServeMode mode) {
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{.sin_family = AF_INET, .sin_port = ::htons(port(mode))};
+    ::inet_pton(AF_INET, HOST.data(), &addr.sin_addr);
+
+    // the server thread might not be listening yet
+    while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) <
+           0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    return fd;
+}
+
+/// Read responses until `count` of them are received. `pending` keeps the
+/// data which came after the last of them
+void read_responses(const int fd, std::string& pending, size_t count) {
+    std::array<char, 65536> buf{};
+    while (count > 0) {
+        const size_t headers_end = pending.find("\r\n\r\n");
+        if (headers_end != std::string::npos) {
+            const size_t length_pos = pending.find("Content-Length: ");
+            size_t content_length = 0;
+            const char* length_start = pending.data() + length_pos + 16;
+            std::from_chars(length_start, pending.data() + headers_end,
+                            content_length);
+
+            const size_t response_size = headers_end + 4 + content_length;
+            if (pending.size() >= response_size) {
+                pending.erase(0, response_size);
+                --count;
+                continue;
+            }
+        }
+
+        const ssize_t received = ::recv(fd, buf.data(), buf.size(), 0);
+        if (received <= 0) {
+            std::abort();
+        }
+        pending.append(buf.data(), static_cast<size_t>(received));
+    }
+}
+
+/// Requests per second over a single connection, writing `depth` requests at
+/// once before reading any of the responses
+void BM_Pipelining(benchmark::State& state) {
+    const auto mode = static_cast<ServeMode>(state.range(0));
+    const auto depth = static_cast<size_t>(state.range(1));
+    start_server(mode);
+
+    std::string batch;
+    for (size_t i = 0; i < depth; ++i) {
+        batch += REQUEST;
+    }
+
+    const int fd = connect_to(mode);
+    std::string pending;
+    for (auto _ : state) {
+        ::send(fd, batch.data(), batch.size(), 0);
+        read_responses(fd, pending, depth);
+    }
+    ::close(fd);
+
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(depth));
+}
+
+BENCHMARK(BM_Pipelining)
+    ->ArgNames({"mode", "depth"})
+    ->ArgsProduct({
+        {static_cast<int64_t>(ServeMode::ThreadPool),
+         static_cast<int64_t>(ServeMode::IoUring),
+         static_cast<int64_t>(ServeMode::Epoll)},
+        {1, 8, 32},
+    })
+    ->UseRealTime();
+}  // namespace
+
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::off);
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+}
@@ -0,0 +1,49 @@
+#include "request_parser.hh"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <string_view>
+
+#include "char_scan.hh"
+#include "waxwing/config.hh"
+
+namespace {
+using waxwing::internal::RequestParser;
+
+/// What a browser sends when fetching a page
+constexpr std::string_view BROWSER_REQUEST =
+    "GET /wp-content/uploads/2010/03/hello-kitty-darth-vader-pink.jpg "
+    "HTTP/1.1\r\n"
+    "Host: www.kittyhell.com\r\n"
+    "User-Agent: Mozilla/5.0 (Macintosh; U; Intel Mac OS X 10_6_3; ja-JP-mac; "
+    "rv:1.9.2.3) Gecko/20100401 Firefox/3.6.3 Pathtraq/0.9\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;"
+    "q=0.8\r\n"
+    "Accept-Language: ja,en-us;q=0.7,en;q=0.3\r\n"
+    "Accept-Encoding: gzip,deflate\r\n"
+    "Accept-Charset: Shift_JIS,utf-8;q=0.7,*;q=0.7\r\n"
+    "Keep-Alive: 115\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: wp_ozh_wsa_visits=2; wp_ozh_wsa_visit_lasttime=xxxxxxxxxx; "
+    "__utma=xxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.x; "
+    "__utmz=xxxxxxxxx.xxxxxxxxxx.x.x.utmccn=(referral)|utmcsr=reader."
+    "livedoor.com|utmcct=/reader/|utmcmd=referral\r\n"
+    "\r\n";
+
+void BM_ParseRequest(benchmark::State& state) {
+    const waxwing::ServerConfig config;
+    RequestParser parser{config};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parser.parse(BROWSER_REQUEST));
+        parser.reset();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(BROWSER_REQUEST.size()));
+    state.SetLabel(std::string{waxwing::internal::char_scan::implementation()});
+}
+BENCHMARK(BM_ParseRequest);
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,124 @@
+#include "waxwing/router.hh"
+
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+using waxwing::HttpMethod;
+using waxwing::Request;
+using waxwing::Response;
+using waxwing::ResponseBuilder;
+using waxwing::internal::Router;
+
+Response ok(const Request&, const waxwing::PathParameters) {
+    return ResponseBuilder{waxwing::HttpStatusCode::Ok_200}.build();
+}
+
+/// Routes of one benchmark. The routers refer to the targets, so they're
+/// kept together
+struct Routes {
+    std::deque<std::string> targets;
+    Router router;
+
+    void add(std::string target) {
+        const std::string& stored = targets.emplace_back(std::move(target));
+        router.add_route(HttpMethod::Get, stored, ok);
+    }
+};
+
+/// Every combination of a literal `a` and a parameter over `depth`
+/// components, followed by `end`. A target of `depth` times `a` followed by
+/// anything else matches all of them up to the last component, so the tree
+/// tries all 2^depth of them
+Routes ambiguous_routes(const int64_t depth) {
+    Routes routes;
+    for (int64_t bits = 0; bits < int64_t{1} << depth; ++bits) {
+        std::string target;
+        for (int64_t i = 0; i < depth; ++i) {
+            target += (bits >> i & 1) != 0 ? "/a" : fmt::format("/:p{}", i);
+        }
+        routes.add(target + "/end");
+    }
+    return routes;
+}
+
+/// `count` routes starting with differently named parameters followed by
+/// the same components. A target matching them up to the last component
+/// makes the tree walk every one of them
+Routes wide_routes(const int64_t count) {
+    Routes routes;
+    for (int64_t i = 0; i < count; ++i) {
+        routes.add(fmt::format("/:p{}/x/x/x/x/x/x/end{}", i, i));
+    }
+    return routes;
+}
+
+/// Thousands of literal routes with a parameter, like a large API
+Routes api_routes(const int64_t count) {
+    Routes routes;
+    for (int64_t i = 0; i < count; ++i) {
+        routes.add(fmt::format("/api/v1/resource{}/:id", i));
+        routes.add(fmt::format("/api/v1/resource{}/:id/items", i));
+    }
+    return routes;
+}
+
+void route(benchmark::State& state, const Router& router,
+           const std::string_view target) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(router.route(HttpMethod::Get, target));
+    }
+}
+
+void BM_AmbiguousMiss(benchmark::State& state, const bool frozen) {
+    Routes routes = ambiguous_routes(state.range(0));
+    if (frozen) {
+        routes.router.freeze();
+    }
+    std::string target;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        target += "/a";
+    }
+    route(state, routes.router, target + "/miss");
+}
+BENCHMARK_CAPTURE(BM_AmbiguousMiss, tree, false)->DenseRange(4, 12, 4);
+BENCHMARK_CAPTURE(BM_AmbiguousMiss, frozen, true)->DenseRange(4, 12, 4);
+
+void BM_WideMiss(benchmark::State& state, const bool frozen) {
+    Routes routes = wide_routes(state.range(0));
+    if (frozen) {
+        routes.router.freeze();
+    }
+    route(state, routes.router, "/x/x/x/x/x/x/x/miss");
+}
+BENCHMARK_CAPTURE(BM_WideMiss, tree, false)
+    ->RangeMultiplier(8)
+    ->Range(8, 512);
+BENCHMARK_CAPTURE(BM_WideMiss, frozen, true)
+    ->RangeMultiplier(8)
+    ->Range(8, 512);
+
+void BM_ApiHit(benchmark::State& state, const bool frozen) {
+    Routes routes = api_routes(state.range(0));
+    if (frozen) {
+        routes.router.freeze();
+    }
+    const std::string target =
+        fmt::format("/api/v1/resource{}/42/items", state.range(0) / 2);
+    route(state, routes.router, target);
+}
+BENCHMARK_CAPTURE(BM_ApiHit, tree, false)
+    ->RangeMultiplier(10)
+    ->Range(10, 10000);
+BENCHMARK_CAPTURE(BM_ApiHit, frozen, true)
+    ->RangeMultiplier(10)
+    ->Range(10, 10000);
+}  // namespace
+
+BENCHMARK_MAIN();
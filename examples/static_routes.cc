@@ -0,0 +1,53 @@
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "waxwing/server.hh"
+
+waxwing::Response hello(const waxwing::Request&,
+                        const waxwing::PathParameters) {
+    return waxwing::ResponseBuilder(waxwing::HttpStatusCode::Ok_200)
+        .body("Hello, world!")
+        .content_type(waxwing::content_type::plaintext)
+        .build();
+}
+
+waxwing::Response user(const waxwing::Request&,
+                       const waxwing::PathParameters params) {
+    std::string body = fmt::format("Requested user `{}`", params[0]);
+
+    return waxwing::ResponseBuilder(waxwing::HttpStatusCode::Ok_200)
+        .body(std::move(body))
+        .content_type(waxwing::content_type::plaintext)
+        .build();
+}
+
+// the whole table is known at compile time, so its trie is built by the
+// compiler and the handlers are called directly
+using Routes = waxwing::StaticRoutes<
+    waxwing::StaticRoute<waxwing::HttpMethod::Get, "/", hello>,
+    waxwing::StaticRoute<waxwing::HttpMethod::Get, "/users/:id", user>>;
+
+int main() {
+    constexpr std::string_view HOST = "127.0.0.1";
+    constexpr uint16_t PORT = 8080;
+
+    waxwing::Server s{};
+    s.route_static(Routes{});
+
+    const waxwing::Result<void, std::string> bind_result = s.bind(HOST, PORT);
+    if (bind_result.has_error()) {
+        spdlog::error(bind_result.error());
+        return EXIT_FAILURE;
+    }
+
+    spdlog::info("serving on {}:{}", HOST, PORT);
+    s.serve();
+
+    return EXIT_SUCCESS;
+}
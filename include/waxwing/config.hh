@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace waxwing {
+/// Connection handling settings shared by every `ServeMode`
+struct ServerConfig {
+    /// Number of requests served over a single connection before it's
+    /// closed. Zero means no limit
+    size_t max_requests_per_connection = 1000;
+    /// Time a connection may stay without any traffic before it's closed.
+    /// Zero means no timeout
+    std::chrono::milliseconds idle_timeout = std::chrono::seconds{5};
+    /// Longest accepted request line, longer ones are answered with 414
+    size_t max_request_line_size = 8192;
+    /// Most bytes the header fields of a request may take together, more
+    /// is answered with 431
+    size_t max_headers_size = 16384;
+    /// Most header fields a request may have, more is answered with 431
+    size_t max_header_count = 100;
+    /// Largest accepted request body, larger ones are answered with 413
+    /// before they are received. Zero means no limit
+    size_t max_body_size = 1024 * 1024;
+};
+
+/// Settings of a single route, overriding the `ServerConfig` ones
+struct RouteConfig {
+    /// Largest request body the route accepts, the server-wide limit
+    /// applies if empty. Zero means no limit
+    std::optional<size_t> max_body_size;
+};
+}  // namespace waxwing
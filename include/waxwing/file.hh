@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "waxwing/result.hh"
+
+namespace waxwing {
+/// Regular file opened for reading. Responses refer to it instead of holding
+/// its contents, which are sent straight from the page cache
+class File final {
+    int fd_;
+    size_t size_;
+
+    File(const int fd, const size_t size) : fd_{fd}, size_{size} {}
+
+public:
+    ~File();
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    File(File&& other) noexcept;
+    File& operator=(File&& rhs) noexcept;
+
+    /// Fails for anything but a regular file, without waiting for it to
+    /// become readable. A symbolic link is refused as well, so it can't
+    /// point outside of a served directory
+    static Result<File, std::string> open(const std::string& path);
+
+    int fd() const noexcept;
+    /// Size at the moment of opening
+    size_t size() const noexcept;
+};
+
+/// Part of a file used as a response body
+struct FileRange {
+    std::shared_ptr<const File> file;
+    size_t offset;
+    size_t length;
+};
+}  // namespace waxwing
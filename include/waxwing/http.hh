@@ -1,69 +1,99 @@
 #pragma once
 
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 #include <optional>
 #include <span>
 #include <string>
 #include <string_view>
-#include <type_traits>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "waxwing/str_util.hh"
 
 namespace waxwing {
+/// Memory of the request being handled on the calling thread, or the default
+/// resource outside of requests. Everything allocated from it is released
+/// as soon as the response is serialized, so it may only back a response
+/// returned from the handler, e.g. `ResponseBuilder{status, request_memory()}`,
+/// never one kept around or handed to another thread
+std::pmr::memory_resource* request_memory() noexcept;
+
+/// Header fields of a response, or of a request being built. Fields are
+/// kept in a flat array in the order they were added, along with the case
+/// insensitive hashes of their names. The common fields are also indexed by
+/// a perfect hash, so looking them up takes a single probe.
+///
+/// Fields are allocated from the default resource, unless other memory is
+/// given, which then has to outlive the headers. Copies are allocated from
+/// the default resource. There's no inline capacity, since values rarely fit
+/// into it anyway: headers built from `request_memory` are the ones that
+/// don't allocate
 class Headers {
-    struct string_hash {
-        using hash_type = std::hash<std::string_view>;
-        using is_transparent = std::true_type;
+public:
+    using Field = std::pair<std::pmr::string, std::pmr::string>;
+    using const_iterator = std::pmr::vector<Field>::const_iterator;
 
-        size_t operator()(const char* str) const { return hash_type{}(str); }
-        size_t operator()(std::string_view str) const {
-            return hash_type{}(str);
-        }
-        size_t operator()(std::string const& str) const {
-            return hash_type{}(str);
-        }
-    };
-    struct eq_comparator {
-        using is_transparent = std::true_type;
+    /// Number of the fields indexed by the perfect hash
+    static constexpr size_t KNOWN_FIELD_COUNT = 32;
 
-        bool operator()(std::string_view lhs, std::string_view rhs) const {
-            return str_util::case_insensitive_eq(lhs, rhs);
-        }
-    };
-    using ReprType = std::unordered_map<std::string, std::string, string_hash,
-                                        eq_comparator>;
-    ReprType repr_;
+private:
+    std::pmr::vector<Field> fields_;
+    // parallel to `fields_`
+    std::pmr::vector<size_t> hashes_;
+    // position in `fields_` plus one of every known field, zero if absent
+    std::array<uint32_t, KNOWN_FIELD_COUNT> known_{};
+
+    std::optional<size_t> find(std::string_view key,
+                               size_t hash) const noexcept;
+    void add(std::string_view key, std::string_view value, size_t hash);
 
 public:
-    Headers() = default;
+    Headers() : Headers{std::pmr::get_default_resource()} {}
+    explicit Headers(std::pmr::memory_resource* memory)
+        : fields_{memory}, hashes_{memory} {}
 
+    /// Add the field unless there's one with the same name already
     template <typename K, typename V>
         requires(std::constructible_from<std::string, K>) &&
-                (std::constructible_from<std::string, V>)
-    void insert(K&& key, V&& value) {
-        repr_.try_emplace(std::forward<K>(key), std::forward<V>(value));
+                (std::convertible_to<const K&, std::string_view>) &&
+                (std::convertible_to<const V&, std::string_view>)
+    void insert(const K& key, const V& value) {
+        const std::string_view name{key};
+        const size_t hash = str_util::case_insensitive_hash(name);
+        if (!find(name, hash).has_value()) {
+            add(name, value, hash);
+        }
     }
 
     template <typename K, typename V>
         requires(std::constructible_from<std::string, K>) &&
-                (std::constructible_from<std::string, V>)
-    void insert_or_assign(K&& key, V&& value) {
-        auto [it, success] =
-            repr_.try_emplace(std::forward<K>(key), std::forward<V>(value));
-        if (!success) {
-            it->second = std::forward<V>(value);
+                (std::convertible_to<const K&, std::string_view>) &&
+                (std::convertible_to<const V&, std::string_view>)
+    void insert_or_assign(const K& key, const V& value) {
+        const std::string_view name{key};
+        const size_t hash = str_util::case_insensitive_hash(name);
+        const std::optional<size_t> position = find(name, hash);
+        if (position.has_value()) {
+            fields_[*position].second = std::string_view{value};
+        } else {
+            add(name, value, hash);
         }
     }
 
     bool contains(std::string_view key) const noexcept;
     std::optional<std::string_view> get(std::string_view key) const noexcept;
 
-    ReprType::iterator begin() noexcept { return repr_.begin(); }
-    ReprType::iterator end() noexcept { return repr_.end(); }
-    ReprType::const_iterator begin() const noexcept { return repr_.cbegin(); }
-    ReprType::const_iterator end() const noexcept { return repr_.cend(); }
-    ReprType::const_iterator cbegin() const noexcept { return repr_.cbegin(); }
-    ReprType::const_iterator cend() const noexcept { return repr_.cend(); }
+    size_t size() const noexcept { return fields_.size(); }
+    bool empty() const noexcept { return fields_.empty(); }
+
+    const_iterator begin() const noexcept { return fields_.cbegin(); }
+    const_iterator end() const noexcept { return fields_.cend(); }
+    const_iterator cbegin() const noexcept { return fields_.cbegin(); }
+    const_iterator cend() const noexcept { return fields_.cend(); }
 };
 
 using PathParameters = std::span<std::string_view const>;
@@ -147,6 +177,8 @@ enum class HttpStatusCode {
 std::string_view format_method(HttpMethod method) noexcept;
 std::optional<HttpMethod> parse_method(std::string_view s) noexcept;
 std::string_view format_status_code(HttpStatusCode code) noexcept;
+/// Status line ready to be written, e.g. `HTTP/1.1 200 OK\r\n`
+std::string_view format_status_line(HttpStatusCode code) noexcept;
 
 namespace content_type {
 constexpr std::string_view plaintext = "text/plain";
@@ -161,5 +193,7 @@ constexpr std::string_view ico = "image/vnd.microsoft.icon";
 constexpr std::string_view jpeg = "image/jpeg";
 constexpr std::string_view png = "image/png";
 constexpr std::string_view gif = "image/gif";
+constexpr std::string_view svg = "image/svg+xml";
+constexpr std::string_view octet_stream = "application/octet-stream";
 }  // namespace content_type
 }  // namespace waxwing
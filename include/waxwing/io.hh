@@ -1,14 +1,21 @@
 #pragma once
 
+#include <sys/uio.h>
+
 #include <cstddef>
 #include <cstdint>
 #include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
 
 #include "waxwing/result.hh"
 
 namespace waxwing::internal {
+/// Result of an operation on a non-blocking descriptor.
+/// `std::errc::resource_unavailable_try_again` means it would block
+using IoResult = Result<size_t, std::errc>;
+
 class Connection final {
     int fd_;
 
@@ -23,9 +30,25 @@ public:
     Connection& operator=(Connection&&) noexcept;
 
     size_t recv(std::string& s, size_t n) const;
-    size_t send(std::span<char> s) const;
+    /// Send the whole `s`, returns less than its size only on failure
+    size_t send(std::span<const char> s) const;
+
+    /// Single `recv` call, zero bytes read means the peer has shut down. With
+    /// `nonblocking` it fails instead of waiting, even on a blocking socket
+    IoResult try_recv(std::span<char> buf,
+                      bool nonblocking = false) const noexcept;
+    /// Single `send` call, which may write only a part of `s`
+    IoResult try_send(std::span<const char> s) const noexcept;
+    /// Single gathered write of the buffers in order, which may write only a
+    /// part of them
+    IoResult try_send(std::span<const iovec> buffers) const noexcept;
+    /// Single `sendfile` call, copying up to `length` bytes of the file
+    /// starting at `offset` without passing them through user space
+    IoResult try_send_file(int file_fd, size_t offset,
+                           size_t length) const noexcept;
 
     bool is_valid() const noexcept;
+    int fd() const noexcept;
 };
 
 class Socket final {
@@ -37,8 +60,11 @@ public:
     Socket() : fd_{-1} {}
     ~Socket();
 
+    /// With `reuse_port` other sockets created the same way may listen on the
+    /// same port, and the kernel balances incoming connections between them
     static Result<Socket, std::string> create(std::string_view address,
-                                              uint16_t port, int backlog);
+                                              uint16_t port, int backlog,
+                                              bool reuse_port = false);
 
     Socket(const Socket&) = delete;
     Socket& operator=(const Socket&) = delete;
@@ -46,6 +72,48 @@ public:
     Socket(Socket&&) noexcept;
     Socket& operator=(Socket&&) noexcept;
 
-    Connection accept() const;
+    Connection accept(bool nonblocking = false) const;
+
+    Result<void, std::string> set_nonblocking() const noexcept;
+    /// Port the socket is bound to, the one picked by the kernel if it was
+    /// created with port zero. Zero on failure
+    uint16_t port() const noexcept;
+    int fd() const noexcept;
+};
+
+/// Edge-triggered readiness notifications on top of epoll. Descriptors are
+/// registered with an arbitrary token which is reported back with events
+class Reactor final {
+    int fd_;
+
+    explicit Reactor(const int fd) : fd_{fd} {}
+
+public:
+    struct Event {
+        uint64_t token;
+        bool readable;
+        bool writable;
+        /// Error or hang up, the descriptor is not usable anymore
+        bool failed;
+    };
+
+    ~Reactor();
+
+    static Result<Reactor, std::string> create();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    Reactor(Reactor&&) noexcept;
+    Reactor& operator=(Reactor&&) noexcept;
+
+    /// Watch `fd` for both reading and writing readiness
+    Result<void, std::string> add(int fd, uint64_t token) const noexcept;
+    void remove(int fd) const noexcept;
+
+    /// Block until some of the descriptors are ready, filling `events`.
+    /// Negative `timeout_ms` means waiting indefinitely
+    Result<size_t, std::string> wait(std::span<Event> events,
+                                     int timeout_ms = -1) const noexcept;
 };
 }  // namespace waxwing::internal
@@ -1,22 +1,59 @@
 #pragma once
 
+#include <memory>
 #include <optional>
+#include <span>
+#include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "waxwing/http.hh"
+#include "waxwing/response.hh"
 
 namespace waxwing {
+namespace internal {
+class Session;
+}
+
+/// Header field of a request, refers to the data of the request
+struct HeaderField {
+    std::string_view name;
+    std::string_view value;
+};
+
+/// Parsed request. Requests received by the server refer straight to the
+/// connection's buffer, so their target, headers and body are valid only
+/// until the handler returns. Handlers that need them later have to copy
+/// them, e.g. with `to_owned`
 class Request {
     friend class RequestBuilder;
+    friend class internal::Session;
 
-    HttpMethod method_;
-    std::string target_;
-    Headers headers_;
-    std::string body_;
+    /// Data of a request that isn't backed by a connection's buffer
+    struct Storage {
+        std::string data;
+        std::vector<HeaderField> headers;
+        std::vector<HeaderField> trailers;
+    };
 
-    Request(HttpMethod method, std::string&& target, Headers&& headers,
-            std::string&& body);
+    HttpMethod method_;
+    std::string_view target_;
+    std::span<const HeaderField> headers_;
+    std::string_view body_;
+    std::span<const HeaderField> trailers_;
+    // kept behind a pointer, so the views stay valid when moving
+    std::unique_ptr<Storage> storage_;
+
+    Request(HttpMethod method, std::string_view target,
+            std::span<const HeaderField> headers, std::string_view body,
+            std::span<const HeaderField> trailers = {}) noexcept;
+
+    /// Request owning a copy of the given parts
+    static Request owned(HttpMethod method, std::string_view target,
+                         std::span<const HeaderField> headers,
+                         std::string_view body,
+                         std::span<const HeaderField> trailers = {});
 
 public:
     Request(const Request&) = delete;
@@ -28,7 +65,33 @@ public:
     HttpMethod method() const noexcept;
     std::string_view target() const noexcept;
     std::string_view body() const noexcept;
+    /// Value of the first field named `key`, compared case insensitively
     std::optional<std::string_view> header(std::string_view key) const noexcept;
+    /// Every header field in the order they were received
+    std::span<const HeaderField> headers() const noexcept;
+    /// Fields sent after a chunked body, in the order they were received
+    std::span<const HeaderField> trailers() const noexcept;
+
+    /// Copy of the request that owns all of its data, so it may outlive the
+    /// handler
+    Request to_owned() const;
+};
+
+/// Receives the body of a request piece by piece while it arrives, so
+/// large uploads never have to fit in memory. Created by the handler of a
+/// streaming route once the head of a request is received
+class BodyConsumer {
+public:
+    virtual ~BodyConsumer() = default;
+
+    /// Next piece of the body, valid only until the call returns
+    virtual void consume(std::span<const char> chunk) = 0;
+    /// Fields sent after a chunked body, called before `finish` if there
+    /// are any. Ignored unless overridden
+    virtual void consume_trailers(std::span<const HeaderField> /*trailers*/) {
+    }
+    /// Response to the request, once the whole body has been consumed
+    virtual Response finish() = 0;
 };
 
 class RequestBuilder final {
@@ -47,7 +110,8 @@ public:
         requires(std::constructible_from<std::string, S1>) &&
                 (std::constructible_from<std::string, S2>)
     RequestBuilder& header(S1&& key, S2&& value) & {
-        headers_[std::forward<S1>(key)] = std::forward<S2>(value);
+        headers_.insert_or_assign(std::forward<S1>(key),
+                                  std::forward<S2>(value));
         return *this;
     }
 
@@ -55,7 +119,8 @@ public:
         requires(std::constructible_from<std::string, S1>) &&
                 (std::constructible_from<std::string, S2>)
     RequestBuilder&& header(S1&& key, S2&& value) && {
-        headers_[std::forward<S1>(key)] = std::forward<S2>(value);
+        headers_.insert_or_assign(std::forward<S1>(key),
+                                  std::forward<S2>(value));
         return std::move(*this);
     }
 
@@ -1,11 +1,42 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
 
+#include "waxwing/file.hh"
 #include "waxwing/http.hh"
 
 namespace waxwing {
+/// Produces a body piece by piece, returning the next piece on every call
+/// and nothing once the body is complete. An empty piece completes the body
+/// too, since the producer is never waited for. It's called again only after
+/// the previous pieces have been sent, so the whole body never has to be in
+/// memory, however slow the client is
+using BodyProducer = std::function<std::optional<std::string>()>;
+
+/// Body generated while the response is being sent
+struct ProducedBody {
+    BodyProducer producer;
+    /// Total length, if known in advance. Otherwise the body is sent with
+    /// the chunked transfer coding
+    std::optional<size_t> length;
+};
+
+/// Immutable buffer shared by many responses, e.g. a cached payload. It's
+/// sent to every client from the same memory, never copied
+using SharedBody = std::shared_ptr<const std::string>;
+
+/// Piece of a segmented body. Views aren't copied either, so they have to
+/// stay valid until the response is sent, which is always true for literals
+using BodySegment = std::variant<std::string, SharedBody, std::string_view>;
+
 class Response final {
     friend class ResponseBuilder;
 
@@ -13,12 +44,21 @@ private:
     HttpStatusCode status_code_;
     Headers headers_;
     std::optional<std::string> body_;
+    std::vector<BodySegment> segments_;
+    std::optional<FileRange> file_body_;
+    std::optional<ProducedBody> produced_body_;
 
     Response(HttpStatusCode code, Headers&& headers,
-             std::optional<std::string>&& body) noexcept
+             std::optional<std::string>&& body,
+             std::vector<BodySegment>&& segments,
+             std::optional<FileRange>&& file_body,
+             std::optional<ProducedBody>&& produced_body) noexcept
         : status_code_{code},
           headers_{std::move(headers)},
-          body_{std::move(body)} {}
+          body_{std::move(body)},
+          segments_{std::move(segments)},
+          file_body_{std::move(file_body)},
+          produced_body_{std::move(produced_body)} {}
 
 public:
     Response(const Response&) = delete;
@@ -30,15 +70,73 @@ public:
     HttpStatusCode status() const noexcept;
     Headers& headers() & noexcept;
     std::optional<std::string_view> body() const noexcept;
+    /// Move the body out, leaving the response without one
+    std::optional<std::string> take_body() noexcept;
+    /// Move the segments of a segmented body out, empty unless the body was
+    /// built from segments or a shared buffer. Takes precedence over `body`
+    std::vector<BodySegment> take_segments() noexcept;
+    /// Body sent straight from a file, if any. Takes precedence over `body`
+    std::optional<FileRange> take_file_body() noexcept;
+    /// Body generated while it's sent, if any. Takes precedence over the
+    /// other bodies
+    std::optional<ProducedBody> take_produced_body() noexcept;
+};
+
+/// Response serialized once, when its route is added, and written as is to
+/// every client. Only the cached `Date` and a `Connection` header when it's
+/// needed are added, so nothing is formatted per request. Only bodies held
+/// in memory can be prepared, a file or produced body throws
+/// `std::invalid_argument`
+class PreparedResponse final {
+    HttpStatusCode status_;
+    // status line and header fields, the length included
+    SharedBody head_;
+    // empty line that ends the head, followed by the body
+    SharedBody tail_;
+    bool closes_;
+    bool adds_date_;
+
+public:
+    explicit PreparedResponse(Response&& resp);
+
+    HttpStatusCode status() const noexcept;
+    const SharedBody& head() const noexcept;
+    const SharedBody& tail() const noexcept;
+    /// Whether the response asks for the connection to be closed
+    bool closes() const noexcept;
+    /// Whether the current `Date` is added, unless the response has its own
+    bool adds_date() const noexcept;
 };
 
 class ResponseBuilder final {
     HttpStatusCode status_code_;
     Headers headers_{};
     std::optional<std::string> body_{};
+    std::vector<BodySegment> segments_{};
+    std::optional<FileRange> file_body_{};
+    std::optional<ProducedBody> produced_body_{};
+
+    void set_shared_body(SharedBody data) {
+        body_.reset();
+        segments_.clear();
+        segments_.emplace_back(std::move(data));
+    }
+
+    void add_segment(BodySegment segment) {
+        // a plain body set earlier becomes the first segment
+        if (body_.has_value()) {
+            segments_.emplace_back(std::move(*body_));
+            body_.reset();
+        }
+        segments_.push_back(std::move(segment));
+    }
 
 public:
     ResponseBuilder(HttpStatusCode code) noexcept : status_code_{code} {}
+    /// Headers are allocated from `memory`, such as the `request_memory`
+    ResponseBuilder(HttpStatusCode code,
+                    std::pmr::memory_resource* memory) noexcept
+        : status_code_{code}, headers_{memory} {}
 
     template <typename S1, typename S2>
         requires(std::constructible_from<std::string, S1>) &&
@@ -61,6 +159,7 @@ public:
     template <typename S>
         requires(std::constructible_from<std::string, S>)
     ResponseBuilder& body(S&& data) & {
+        segments_.clear();
         body_ = std::forward<S>(data);
         return *this;
     }
@@ -68,10 +167,61 @@ public:
     template <typename S>
         requires(std::constructible_from<std::string, S>)
     ResponseBuilder&& body(S&& data) && {
+        segments_.clear();
         body_ = std::forward<S>(data);
         return std::move(*this);
     }
 
+    /// Send a shared immutable buffer as the body, without copying it
+    ResponseBuilder& body(SharedBody data) & {
+        set_shared_body(std::move(data));
+        return *this;
+    }
+
+    ResponseBuilder&& body(SharedBody data) && {
+        set_shared_body(std::move(data));
+        return std::move(*this);
+    }
+
+    /// Append a segment to the body. Segments are written one after another
+    /// with a gathered write, so only the small ones are ever copied
+    ResponseBuilder& segment(BodySegment segment) & {
+        add_segment(std::move(segment));
+        return *this;
+    }
+
+    ResponseBuilder&& segment(BodySegment segment) && {
+        add_segment(std::move(segment));
+        return std::move(*this);
+    }
+
+    /// Send a part of a file as the body without reading it into memory
+    ResponseBuilder& file(FileRange range) & {
+        file_body_ = std::move(range);
+        return *this;
+    }
+
+    ResponseBuilder&& file(FileRange range) && {
+        file_body_ = std::move(range);
+        return std::move(*this);
+    }
+
+    /// Generate the body with `producer` while it's being sent, for bodies
+    /// too large to build in memory. `length` has to match the produced
+    /// length if given
+    ResponseBuilder& producer(BodyProducer producer,
+                              std::optional<size_t> length = std::nullopt) & {
+        produced_body_ = ProducedBody{std::move(producer), length};
+        return *this;
+    }
+
+    ResponseBuilder&& producer(
+        BodyProducer producer,
+        std::optional<size_t> length = std::nullopt) && {
+        produced_body_ = ProducedBody{std::move(producer), length};
+        return std::move(*this);
+    }
+
     template <typename S>
         requires(std::constructible_from<std::string, S>)
     ResponseBuilder& content_type(S&& type) & {
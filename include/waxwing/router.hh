@@ -3,11 +3,18 @@
 #include <fmt/core.h>
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "waxwing/config.hh"
 #include "waxwing/http.hh"
 #include "waxwing/request.hh"
 #include "waxwing/response.hh"
@@ -16,6 +23,28 @@
 namespace waxwing::internal {
 using RequestHandler =
     std::function<Response(Request const&, const PathParameters)>;
+/// Handler of a route receiving the body as it arrives. Gets the request
+/// without its body, which is valid only during the call
+using StreamingHandler = std::function<std::unique_ptr<BodyConsumer>(
+    Request const&, const PathParameters)>;
+
+/// Most path parameters a route may have, so the values of a routed target
+/// are collected without allocating
+constexpr size_t MAX_PATH_PARAMETERS = 16;
+
+/// Number of `HttpMethod` values
+constexpr size_t METHOD_COUNT = static_cast<size_t>(HttpMethod::Patch) + 1;
+
+/// Set of methods, a bit per `HttpMethod`
+using MethodMask = uint16_t;
+
+constexpr MethodMask method_bit(const HttpMethod method) noexcept {
+    return static_cast<MethodMask>(1U << static_cast<unsigned>(method));
+}
+
+/// Value of the `Allow` header listing `methods`. Every one of them is
+/// formatted ahead of time, so it never allocates
+std::string_view format_allowed_methods(MethodMask methods) noexcept;
 
 /// Class for compile-time checks of targets
 class RouteTarget {
@@ -42,6 +71,7 @@ public:
             target = target.substr(1);
         }
 
+        size_t parameters = 0;
         auto split = str_util::split(target, '/');
         for (std::optional<std::string_view> component = split.next();
              component.has_value(); component = split.next()) {
@@ -55,6 +85,10 @@ public:
                 !(component->starts_with('*') || component->starts_with(':'))) {
                 return false;
             }
+            parameters += param_indicators_count;
+            if (parameters > MAX_PATH_PARAMETERS) {
+                return false;
+            }
 
             const bool all_chars_are_valid = std::all_of(
                 component->begin(), component->end(), is_legal_char);
@@ -69,20 +103,68 @@ public:
     constexpr operator std::string_view() const noexcept { return target_; }
 };
 
-class RoutingResult final {
-    RequestHandler handler_;
-    std::vector<std::string_view> parameters_;
+/// Handler of a route together with its settings. Exactly one of the
+/// handlers, the function or the prepared response is set
+struct Route {
+    RequestHandler handler;
+    StreamingHandler streaming_handler;
+    RouteConfig config;
+    std::shared_ptr<const PreparedResponse> prepared;
+    // handler of a static route, called without a `std::function`
+    Response (*function)(const Request&, const PathParameters) = nullptr;
+};
+
+/// Values of the path parameters of a target being routed, kept inline
+class ParameterBuffer final {
+    std::array<std::string_view, MAX_PATH_PARAMETERS> values_{};
+    size_t size_ = 0;
 
 public:
-    RoutingResult(RequestHandler handler,
-                  std::vector<std::string_view>&& params)
-        : handler_{handler}, parameters_{std::move(params)} {}
+    /// Returns false if the buffer is full
+    bool push(std::string_view value) noexcept;
+    void pop() noexcept;
+    PathParameters view() const noexcept;
+};
+
+/// Route a target was matched to. It refers to the route stored in the
+/// router, and the parameters refer to the target
+class RoutingResult final {
+    const Route* route_;
+    ParameterBuffer parameters_;
+    bool found_;
+    MethodMask allowed_methods_;
 
-    RequestHandler handler() const noexcept;
+public:
+    RoutingResult(const Route& route, const ParameterBuffer& params,
+                  bool found = true, MethodMask allowed_methods = 0) noexcept
+        : route_{&route},
+          parameters_{params},
+          found_{found},
+          allowed_methods_{allowed_methods} {}
+
+    const RequestHandler& handler() const noexcept;
+    /// Set instead of `handler` for streaming routes
+    const StreamingHandler& streaming_handler() const noexcept;
+    /// Set instead of `handler` for routes answered the same way every time
+    const PreparedResponse* prepared() const noexcept;
+    /// Set instead of `handler` for static routes
+    auto function() const noexcept -> decltype(Route::function);
     PathParameters parameters() const noexcept;
+    const RouteConfig& config() const noexcept;
+    /// Whether a route matched, otherwise the handler answers with an error
+    bool found() const noexcept;
+    /// Methods the target is routed for, set only if the requested method
+    /// isn't one of them
+    MethodMask allowed_methods() const noexcept;
+    /// Value of the `Allow` header listing the `allowed_methods`
+    std::string_view allow() const noexcept;
 };
 
+class FrozenRouteTable;
+
 class RouteTree final {
+    friend class FrozenRouteTable;
+
     class Node final {
     public:
         enum class Type {
@@ -95,7 +177,10 @@ class RouteTree final {
         Type type_;
         std::string_view key_;
         std::vector<Node> children_;
-        std::vector<std::pair<HttpMethod, RequestHandler>> handlers_;
+        // indexed by method, so dispatching is a single load. The routes are
+        // kept apart from the node, which stays small and never moves them
+        std::array<std::unique_ptr<const Route>, METHOD_COUNT> routes_;
+        MethodMask allowed_ = 0;
 
         static Type parse_type(std::string_view key) noexcept;
         static std::string_view parse_key(std::string_view key) noexcept;
@@ -110,60 +195,226 @@ class RouteTree final {
         bool matches(std::string_view key) const noexcept;
         bool is_parameter() const noexcept;
 
-        void insert_or_replace_handler(HttpMethod method,
-                                       RequestHandler handler);
+        void insert_or_replace_handler(HttpMethod method, Route route);
         Node& insert_or_get_child(Node&& child);
 
-        std::optional<RequestHandler> find_handler(
-            HttpMethod method) const noexcept;
-
-        std::vector<std::reference_wrapper<const Node>> find_matching_children(
-            std::string_view component) const noexcept;
+        const Route* find_handler(HttpMethod method) const noexcept;
+        /// Methods with a route
+        MethodMask allowed() const noexcept;
+        /// Sorted by type, so literals come before parameters
+        const std::vector<Node>& children() const noexcept;
 
         void print(uint8_t layer = 0, bool last = false) const noexcept;
     };
 
     Node root_{""};
     static void insert(Node& cur_node, HttpMethod method,
-                       std::string_view target, RequestHandler handler);
-    static std::optional<RoutingResult> get(
-        Node const& cur_node, std::vector<std::string_view>& params,
-        HttpMethod method, std::string_view target) noexcept;
+                       std::string_view target, Route route);
+    static const Route* get(Node const& cur_node, ParameterBuffer& params,
+                            HttpMethod method, std::string_view target,
+                            MethodMask& allowed) noexcept;
 
 public:
     RouteTree() = default;
 
     void insert(HttpMethod method, std::string_view target,
-                RequestHandler handler) noexcept;
+                RequestHandler handler, RouteConfig config = {}) noexcept;
+    void insert(HttpMethod method, std::string_view target,
+                Route route) noexcept;
 
+    /// Never allocates, the result refers to the tree and to `target`
     std::optional<RoutingResult> get(HttpMethod method,
                                      std::string_view target) const noexcept;
+    /// Same as above, also collecting the methods `target` is routed for
+    /// into `allowed` when there's no route for `method`
+    std::optional<RoutingResult> get(HttpMethod method,
+                                     std::string_view target,
+                                     MethodMask& allowed) const noexcept;
 
     void print() const noexcept;
 };
 
+/// Immutable, determinized copy of a `RouteTree` laid out for lookups.
+/// Every state stands for the set of tree nodes a prefix of a target may have
+/// reached, so a target is routed with a single pass over its components and
+/// never backtracks, with the same precedence as the tree. States are stored
+/// in breadth-first order, their literal transitions are contiguous ranges
+/// and the literal keys are packed into a single string. Routes that would
+/// need more than `MAX_STATES` states are matched against the tree nodes
+/// instead, tracking the nodes a prefix has reached in lockstep, which takes
+/// a single pass too and no more than `MAX_LOCKSTEP_WIDTH` nodes. Routes it
+/// returns are the ones stored in the tree,
+/// which must outlive the table and stay unmodified
+class FrozenRouteTable final {
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct State {
+        // literal transitions are `[literals_begin, literals_end)`, sorted by
+        // their keys
+        uint32_t literals_begin = 0;
+        uint32_t literals_end = 0;
+        // transitions for an empty component, and for any other one
+        uint32_t empty = NONE;
+        uint32_t other = NONE;
+        // index to `accepts_` if a route ends in this state
+        uint32_t accept = NONE;
+    };
+
+    struct Literal {
+        // a part of `keys_`
+        uint32_t key_offset = 0;
+        uint32_t key_size = 0;
+        uint32_t target = NONE;
+    };
+
+    /// Routes of the targets ending in a state, resolved for every method
+    struct Accept {
+        // index to `endpoints_` of the route that wins for each method
+        std::array<uint32_t, METHOD_COUNT> endpoints{};
+        MethodMask allowed = 0;
+    };
+
+    /// Tree node with routes
+    struct Endpoint {
+        std::array<const Route*, METHOD_COUNT> routes{};
+        // depths of the components that are parameters, a part of
+        // `parameter_depths_`
+        uint32_t parameters_begin = 0;
+        uint32_t parameters_end = 0;
+    };
+
+    std::vector<State> states_;
+    std::vector<Literal> literals_;
+    // first byte of every literal's key, so the keys compared to a
+    // component are narrowed down without touching the others
+    std::vector<char> first_bytes_;
+    std::string keys_;
+    std::vector<Accept> accepts_;
+    std::vector<Endpoint> endpoints_;
+    std::vector<uint32_t> parameter_depths_;
+
+    // set only if the states weren't compiled, the target is matched against
+    // the nodes under it then
+    const RouteTree::Node* root_ = nullptr;
+    std::unordered_map<const RouteTree::Node*, uint32_t> node_endpoints_;
+    // most nodes a prefix may reach at once
+    size_t width_ = 0;
+
+    FrozenRouteTable() = default;
+
+    std::string_view key(const Literal& literal) const noexcept;
+    uint32_t next(const State& state,
+                  std::string_view component) const noexcept;
+    std::optional<RoutingResult> get_lockstep(
+        HttpMethod method, std::string_view target,
+        MethodMask& allowed) const noexcept;
+    std::optional<RoutingResult> resolve(
+        uint32_t endpoint_index, HttpMethod method,
+        std::string_view target) const noexcept;
+
+public:
+    /// Most states a table may have. Ambiguous parameters may need a state
+    /// for every combination of the routes they lead to, so larger ones
+    /// aren't compiled
+    static constexpr size_t MAX_STATES = 1 << 16;
+    /// Most nodes the lookups without the states may track at once. They're
+    /// kept on the stack, so lookups never allocate
+    static constexpr size_t MAX_LOCKSTEP_WIDTH = 256;
+
+    /// Empty if the routes need more than `MAX_STATES` states and more than
+    /// `MAX_LOCKSTEP_WIDTH` nodes may be reached at once
+    static std::optional<FrozenRouteTable> compile(const RouteTree& tree);
+
+    /// Same as `RouteTree::get`, in time linear in the length of `target`.
+    /// Without the states, the time is also linear in the most nodes a
+    /// prefix may reach at once
+    std::optional<RoutingResult> get(HttpMethod method,
+                                     std::string_view target,
+                                     MethodMask& allowed) const noexcept;
+    /// Whether the states were compiled
+    bool determinized() const noexcept;
+    size_t states() const noexcept;
+};
+
+/// Lookup of the routes of a `StaticRoutes` table
+using StaticLookup = std::optional<RoutingResult> (*)(HttpMethod,
+                                                      std::string_view,
+                                                      MethodMask&) noexcept;
+
 class Router final {
+    // only returned from the handler, so they take the request memory
     constexpr static auto default_not_found_handler =
         [](const Request&, const PathParameters&) {
-            return ResponseBuilder(HttpStatusCode::NotFound_404).build();
+            return ResponseBuilder(HttpStatusCode::NotFound_404,
+                                   request_memory())
+                .build();
+        };
+    constexpr static auto method_not_allowed_handler =
+        [](const Request&, const PathParameters&) {
+            return ResponseBuilder(HttpStatusCode::MethodNotAllowed_405,
+                                   request_memory())
+                .build();
         };
 
+    /// Route matching every target under `prefix`, the rest of the target
+    /// is passed as the only path parameter
+    struct PrefixRoute {
+        HttpMethod method;
+        std::string prefix;
+        Route route;
+    };
+
     RouteTree tree_{};
-    RequestHandler not_found_handler_;
+    // sorted by descending prefix length, so the longest prefix wins
+    std::vector<PrefixRoute> prefix_routes_;
+    Route not_found_;
+    Route method_not_allowed_{method_not_allowed_handler};
+    // compiled by `freeze`, dropped whenever a route is added
+    std::optional<FrozenRouteTable> frozen_;
+    StaticLookup static_routes_ = nullptr;
 
 public:
     Router(RequestHandler not_found_handler = default_not_found_handler)
-        : not_found_handler_{not_found_handler} {}
+        : not_found_{not_found_handler} {}
 
     void add_route(HttpMethod method, std::string_view target,
-                   const RequestHandler& handler) noexcept;
+                   const RequestHandler& handler,
+                   const RouteConfig& config = {}) noexcept;
+    /// Route whose handler receives the body as it arrives
+    void add_streaming_route(HttpMethod method, std::string_view target,
+                             const StreamingHandler& handler,
+                             const RouteConfig& config = {}) noexcept;
+    /// Route answered with `response`, serialized once right away
+    void add_prepared_route(HttpMethod method, std::string_view target,
+                            PreparedResponse response,
+                            const RouteConfig& config = {});
+    /// Route every target starting with `prefix` followed by a slash. Routes
+    /// added with `add_route` take precedence
+    void add_prefix_route(HttpMethod method, std::string_view prefix,
+                          const RequestHandler& handler,
+                          const RouteConfig& config = {});
 
     /// Parse given target and return corresponding request handler and parsed
-    /// path parameters. If handler was not found, returns 404 hanlder
+    /// path parameters. If handler was not found, returns 404 hanlder, or a
+    /// 405 one if the target is routed for other methods, which the result
+    /// lists for the `Allow` header. Never allocates, the result stays valid
+    /// until the router is modified
     RoutingResult route(HttpMethod method,
                         std::string_view target) const noexcept;
 
+    /// Routes compiled into the program, which take precedence over the
+    /// ones added otherwise. The added routes are only looked at if the
+    /// table doesn't route the target for the method, so a parameter of the
+    /// table wins over a literal added otherwise
+    void set_static_routes(StaticLookup lookup) noexcept;
+
+    /// Compile the routes into a table laid out for lookups, used until the
+    /// next route is added. Returns false if the routes are too ambiguous to
+    /// be looked up without allocating, they aren't served then
+    bool freeze();
+
     void set_not_found_handler(RequestHandler handler) noexcept;
+    void set_not_found_response(PreparedResponse response);
     void print_tree() const noexcept;
 };
 }  // namespace waxwing::internal
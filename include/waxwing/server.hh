@@ -1,34 +1,98 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <string_view>
 
+#include "waxwing/config.hh"
 #include "waxwing/io.hh"
 #include "waxwing/result.hh"
 #include "waxwing/router.hh"
+#include "waxwing/static_routes.hh"
 
 namespace waxwing {
+/// The way `Server::serve` handles connections
+enum class ServeMode {
+    /// Requests are handled by the threads of a pool, which send responses
+    /// with blocking I/O. Connections waiting for more of their requests are
+    /// parked instead of holding a thread, and resumed once they're readable
+    ThreadPool,
+    /// Single thread drives all of the connections through io_uring
+    IoUring,
+    /// Single thread drives all of the connections, waiting for their
+    /// readiness with epoll. For kernels without io_uring support
+    Epoll,
+    /// Every thread accepts connections on its own `SO_REUSEPORT` socket and
+    /// serves them like `Epoll` does, the kernel balances connections
+    /// between the threads. Requires the socket to be bound with
+    /// `share_port`, which becomes the socket of the calling thread
+    Sharded,
+};
+
 class Server final {
     internal::Router router_;
     internal::Socket socket_;
+    // sharded serving creates more sockets bound to the same address
+    std::string address_;
+    int backlog_ = 0;
+    bool share_port_ = false;
+    ServerConfig config_;
 
 public:
     void route(HttpMethod method, internal::RouteTarget target,
-               const internal::RequestHandler& handler) noexcept;
+               const internal::RequestHandler& handler,
+               const RouteConfig& config = {}) noexcept;
+    void route(HttpMethod method, internal::RouteTarget target,
+               const std::function<Response()>& handler,
+               const RouteConfig& config = {}) noexcept;
     void route(HttpMethod method, internal::RouteTarget target,
-               const std::function<Response()>& handler) noexcept;
+               const std::function<Response(Request const&)>& handler,
+               const RouteConfig& config = {}) noexcept;
     void route(HttpMethod method, internal::RouteTarget target,
-               const std::function<Response(Request const&)>& handler) noexcept;
-    void route(
-        HttpMethod method, internal::RouteTarget target,
-        const std::function<Response(const PathParameters)>& handler) noexcept;
+               const std::function<Response(const PathParameters)>& handler,
+               const RouteConfig& config = {}) noexcept;
+    /// Route answered with the same `response` every time. It's serialized
+    /// once, here, so it's only written out for each request
+    void route(HttpMethod method, internal::RouteTarget target,
+               Response response, const RouteConfig& config = {});
+    /// Route whose handler receives the body as it arrives, through the
+    /// `BodyConsumer` it creates for every request
+    void route_streaming(HttpMethod method, internal::RouteTarget target,
+                         const internal::StreamingHandler& handler,
+                         const RouteConfig& config = {}) noexcept;
+
+    /// Route the targets of a table compiled into the program. They take
+    /// precedence over the routes added otherwise, literal or not: a static
+    /// `/users/:id` is chosen over a `/users/me` added with `route`
+    template <typename... Routes>
+    void route_static(StaticRoutes<Routes...> /*routes*/) noexcept {
+        router_.set_static_routes(&StaticRoutes<Routes...>::get);
+    }
+
+    /// Serve files under `root` for GET requests of targets under `prefix`,
+    /// e.g. `/assets/app.js` maps to `<root>/app.js` for the `/assets`
+    /// prefix. Supports single `Range` requests. Only regular files are
+    /// served, symbolic links to them aren't
+    void serve_static(std::string_view prefix, std::string root);
 
     void set_not_found_handler(internal::RequestHandler handler);
+    /// Answer unrouted requests with the same `response` every time
+    void set_not_found_response(Response response);
+    void configure(const ServerConfig& config) noexcept;
 
+    /// Bind the listening socket, to a port picked by the kernel if `port`
+    /// is zero. Other sockets may listen on the same port only with
+    /// `share_port`, which `ServeMode::Sharded` requires
     Result<void, std::string> bind(std::string_view address, uint16_t port,
-                                   int backlog = 100) noexcept;
+                                   int backlog = 100,
+                                   bool share_port = false) noexcept;
+    /// Port of the bound socket, zero if it isn't bound
+    uint16_t port() const noexcept;
 
-    void serve() const noexcept;
+    /// Serve requests on the bound socket. The routes are compiled into a
+    /// lookup table first, so they shouldn't be changed while serving. Routes
+    /// too ambiguous to be looked up without allocating aren't served
+    void serve(ServeMode mode = ServeMode::ThreadPool) noexcept;
     void print_route_tree() const noexcept;
 };
 };  // namespace waxwing
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+#include "waxwing/http.hh"
+#include "waxwing/request.hh"
+#include "waxwing/response.hh"
+#include "waxwing/router.hh"
+
+namespace waxwing {
+namespace internal {
+/// Target of a static route, kept in the type of the route. Checked the same
+/// way `RouteTarget` is
+template <size_t N>
+struct FixedTarget {
+    // public, so the target can be a template argument
+    std::array<char, N - 1> chars{};
+
+    consteval FixedTarget(const char (&target)[N]) {
+        std::copy_n(target, N - 1, chars.begin());
+        if (!RouteTarget::check({target, N - 1})) {
+            throw std::invalid_argument("Invalid target");
+        }
+    }
+
+    constexpr std::string_view view() const noexcept {
+        return {chars.data(), chars.size()};
+    }
+};
+
+/// Missing node of the static trie, or a missing route
+constexpr size_t NO_STATIC_INDEX = SIZE_MAX;
+
+struct StaticRouteSpec {
+    HttpMethod method;
+    std::string_view target;
+};
+
+/// Node of the trie of static routes, built at compile time. Siblings are
+/// linked in the order `RouteTree` tries them, so literals come first
+struct StaticNode {
+    enum class Type : uint8_t {
+        Literal,
+        ParamNonEmpty,
+        ParamAny,
+    };
+
+    Type type = Type::Literal;
+    std::string_view key;
+    size_t parent = NO_STATIC_INDEX;
+    // index of the component of a target the node matches
+    size_t depth = 0;
+    size_t first_child = NO_STATIC_INDEX;
+    size_t next_sibling = NO_STATIC_INDEX;
+    // index of the route for each method
+    std::array<size_t, METHOD_COUNT> routes{};
+    MethodMask allowed = 0;
+
+    constexpr bool matches(const std::string_view component) const noexcept {
+        switch (type) {
+            case Type::Literal:
+                return component == key;
+            case Type::ParamNonEmpty:
+                return !component.empty();
+            case Type::ParamAny:
+                return true;
+        }
+        return false;
+    }
+};
+
+/// Same as `target.find('/')`, which GCC 12 can't evaluate at compile time
+/// for targets kept in template arguments
+constexpr size_t find_slash(const std::string_view target) noexcept {
+    for (size_t i = 0; i < target.size(); ++i) {
+        if (target[i] == '/') {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+/// Most nodes the trie of `specs` may need, one per component
+template <size_t N>
+consteval size_t count_static_nodes(
+    const std::array<StaticRouteSpec, N>& specs) {
+    size_t count = 1;
+    for (const StaticRouteSpec& spec : specs) {
+        count += static_cast<size_t>(
+                     std::count(spec.target.begin(), spec.target.end(), '/')) +
+                 1;
+    }
+    return count;
+}
+
+/// Child of `parent` for `component`, inserted into `nodes` if missing
+template <size_t N>
+consteval size_t insert_static_child(std::array<StaticNode, N>& nodes,
+                                     size_t& size, const size_t parent,
+                                     std::string_view component) {
+    StaticNode::Type type = StaticNode::Type::Literal;
+    if (component.starts_with(':')) {
+        type = StaticNode::Type::ParamNonEmpty;
+        component.remove_prefix(1);
+    } else if (component.starts_with('*')) {
+        type = StaticNode::Type::ParamAny;
+        component.remove_prefix(1);
+    }
+
+    size_t previous = NO_STATIC_INDEX;
+    size_t next = nodes[parent].first_child;
+    for (size_t child = next; child != NO_STATIC_INDEX;
+         child = nodes[child].next_sibling) {
+        if (nodes[child].type == type && nodes[child].key == component) {
+            return child;
+        }
+    }
+    // the same position `RouteTree` inserts the child at, so routes take
+    // precedence the same way
+    while (next != NO_STATIC_INDEX && nodes[next].type < type) {
+        previous = next;
+        next = nodes[next].next_sibling;
+    }
+
+    const size_t child = size++;
+    nodes[child].type = type;
+    nodes[child].key = component;
+    nodes[child].parent = parent;
+    nodes[child].depth = parent == 0 ? 0 : nodes[parent].depth + 1;
+    nodes[child].routes.fill(NO_STATIC_INDEX);
+    nodes[child].next_sibling = next;
+    if (previous == NO_STATIC_INDEX) {
+        nodes[parent].first_child = child;
+    } else {
+        nodes[previous].next_sibling = child;
+    }
+    return child;
+}
+
+template <size_t NodeCount, size_t RouteCount>
+consteval std::array<StaticNode, NodeCount> build_static_trie(
+    const std::array<StaticRouteSpec, RouteCount>& specs) {
+    std::array<StaticNode, NodeCount> nodes{};
+    nodes[0].routes.fill(NO_STATIC_INDEX);
+    size_t size = 1;
+    for (size_t route = 0; route < RouteCount; ++route) {
+        // leading slash is insignificant
+        std::string_view target = specs[route].target;
+        if (target.starts_with('/')) {
+            target.remove_prefix(1);
+        }
+
+        size_t node = 0;
+        for (;;) {
+            const size_t slash_pos = find_slash(target);
+            node = insert_static_child(nodes, size, node,
+                                       target.substr(0, slash_pos));
+            if (slash_pos == std::string_view::npos) {
+                break;
+            }
+            target.remove_prefix(slash_pos + 1);
+        }
+        // a later route for the same method and target replaces the earlier
+        nodes[node].routes[static_cast<size_t>(specs[route].method)] = route;
+        nodes[node].allowed |= method_bit(specs[route].method);
+    }
+    return nodes;
+}
+
+/// Most nodes of the trie matching the same component, which bounds the
+/// nodes a prefix of a target may reach
+template <size_t N>
+consteval size_t static_trie_width(const std::array<StaticNode, N>& nodes) {
+    std::array<size_t, N> counts{};
+    for (size_t node = 1; node < N; ++node) {
+        if (nodes[node].parent != NO_STATIC_INDEX) {
+            ++counts[nodes[node].depth];
+        }
+    }
+    return std::max<size_t>(*std::max_element(counts.begin(), counts.end()),
+                            1);
+}
+
+/// Same as `RouteTree::get`, returns the index of the route found. Rather
+/// than backtracking, every node a prefix of the target reaches is tracked
+/// in lockstep, ordered the way the tree tries them, so the time is linear
+/// in the length of the target and the `Width` of the trie
+template <size_t Width>
+size_t find_static_route(const std::span<const StaticNode> nodes,
+                         ParameterBuffer& params, const HttpMethod method,
+                         const std::string_view target,
+                         MethodMask& allowed) noexcept {
+    // every node is reached by a single path, so they never repeat
+    std::array<std::array<size_t, Width>, 2> levels;
+    size_t current = 0;
+    levels[current][0] = 0;
+    size_t reached = 1;
+    for (size_t begin = 0;;) {
+        const size_t slash_pos = target.find('/', begin);
+        const std::string_view component =
+            target.substr(begin, slash_pos - begin);
+        size_t next_reached = 0;
+        for (size_t i = 0; i < reached; ++i) {
+            for (size_t child = nodes[levels[current][i]].first_child;
+                 child != NO_STATIC_INDEX; child = nodes[child].next_sibling) {
+                if (nodes[child].matches(component)) {
+                    levels[current ^ 1][next_reached++] = child;
+                }
+            }
+        }
+        if (next_reached == 0) {
+            return NO_STATIC_INDEX;
+        }
+        current ^= 1;
+        reached = next_reached;
+        if (slash_pos == std::string_view::npos) {
+            break;
+        }
+        begin = slash_pos + 1;
+    }
+
+    // the methods allowed are the ones of the nodes the tree would try
+    size_t winner = NO_STATIC_INDEX;
+    for (size_t i = 0; i < reached && winner == NO_STATIC_INDEX; ++i) {
+        const StaticNode& node = nodes[levels[current][i]];
+        allowed |= node.allowed;
+        if (node.routes[static_cast<size_t>(method)] != NO_STATIC_INDEX) {
+            winner = levels[current][i];
+        }
+    }
+    if (winner == NO_STATIC_INDEX) {
+        return NO_STATIC_INDEX;
+    }
+
+    // only now it's known which components are parameters, collected from
+    // the last one
+    std::array<size_t, MAX_PATH_PARAMETERS> depths{};
+    size_t parameters = 0;
+    for (size_t node = winner; node != 0; node = nodes[node].parent) {
+        if (nodes[node].type != StaticNode::Type::Literal) {
+            if (parameters == depths.size()) {
+                return NO_STATIC_INDEX;
+            }
+            depths[parameters++] = nodes[node].depth;
+        }
+    }
+    size_t depth = 0;
+    size_t begin = 0;
+    for (size_t i = parameters; i-- > 0;) {
+        for (; depth < depths[i]; ++depth) {
+            begin = target.find('/', begin) + 1;
+        }
+        params.push(target.substr(begin, target.find('/', begin) - begin));
+    }
+    return nodes[winner].routes[static_cast<size_t>(method)];
+}
+}  // namespace internal
+
+/// Route of a `StaticRoutes` table. `Handler` is called directly, so it may
+/// be inlined into the code calling it
+template <HttpMethod Method, internal::FixedTarget Target, auto Handler>
+    requires(std::is_invocable_r_v<Response, decltype(Handler),
+                                   const Request&, const PathParameters>)
+struct StaticRoute {
+    static constexpr HttpMethod METHOD = Method;
+    static constexpr std::string_view TARGET = Target.view();
+
+    static Response call(const Request& req, const PathParameters params) {
+        return std::invoke(Handler, req, params);
+    }
+};
+
+/// Table of routes known at compile time, e.g.
+///
+///     using Routes = StaticRoutes<
+///         StaticRoute<HttpMethod::Get, "/users/:id", get_user>,
+///         StaticRoute<HttpMethod::Post, "/users", create_user>>;
+///     server.route_static(Routes{});
+///
+/// Its trie is built by the compiler, so serving doesn't construct anything,
+/// and no handler is called through a `std::function`. Targets match the
+/// same way as the ones of `Server::route`, in a single pass over them
+/// however ambiguous the routes are
+template <typename... Routes>
+class StaticRoutes final {
+    static constexpr std::array<internal::StaticRouteSpec, sizeof...(Routes)>
+        SPECS{{{Routes::METHOD, Routes::TARGET}...}};
+    static constexpr std::array NODES =
+        internal::build_static_trie<internal::count_static_nodes(SPECS)>(
+            SPECS);
+    static constexpr size_t WIDTH = internal::static_trie_width(NODES);
+    static inline const std::array<internal::Route, sizeof...(Routes)> ROUTES{
+        {internal::Route{.function = &Routes::call}...}};
+
+public:
+    /// Lookup for `Router::set_static_routes`
+    static std::optional<internal::RoutingResult> get(
+        const HttpMethod method, std::string_view target,
+        internal::MethodMask& allowed) noexcept {
+        // leading slash is insignificant
+        if (target.starts_with('/')) {
+            target = target.substr(1);
+        }
+
+        internal::ParameterBuffer params;
+        const size_t route = internal::find_static_route<WIDTH>(
+            NODES, params, method, target, allowed);
+        if (route == internal::NO_STATIC_INDEX) {
+            return std::nullopt;
+        }
+        return internal::RoutingResult{ROUTES[route], params};
+    }
+};
+}  // namespace waxwing
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string_view>
 
 namespace waxwing::str_util {
@@ -7,4 +8,21 @@ std::string_view ltrim(std::string_view s);
 std::string_view rtrim(std::string_view s);
 std::string_view trim(std::string_view s);
 bool case_insensitive_eq(std::string_view lhs, std::string_view rhs);
+
+constexpr char to_lower_ascii(const char c) noexcept {
+    return 'A' <= c && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+/// FNV-1a over ASCII lowercased characters, usable at compile time
+constexpr size_t case_insensitive_hash(const std::string_view s) noexcept {
+    constexpr size_t OFFSET_BASIS = 14695981039346656037ULL;
+    constexpr size_t PRIME = 1099511628211ULL;
+
+    size_t hash = OFFSET_BASIS;
+    for (const char c : s) {
+        hash ^= static_cast<unsigned char>(to_lower_ascii(c));
+        hash *= PRIME;
+    }
+    return hash;
+}
 }  // namespace waxwing::str_util
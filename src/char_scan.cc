@@ -0,0 +1,312 @@
+#include "char_scan.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace waxwing::internal::char_scan {
+namespace {
+constexpr bool is_token_char(const char c) noexcept {
+    constexpr std::string_view SPECIAL = "!#$%&'*+-.^_`|~";
+    return ('0' <= c && c <= '9') || ('a' <= c && c <= 'z') ||
+           ('A' <= c && c <= 'Z') || SPECIAL.find(c) != std::string_view::npos;
+}
+
+constexpr bool is_visible_char(const char c) noexcept {
+    return '!' <= c && c <= '~';
+}
+
+constexpr bool is_value_char(const char c) noexcept {
+    const auto byte = static_cast<unsigned char>(c);
+    return c == '\t' || (byte >= ' ' && byte != 0x7f);
+}
+
+template <bool (*Pred)(char)>
+constexpr std::array<bool, 256> make_table() noexcept {
+    std::array<bool, 256> table{};
+    for (size_t i = 0; i < table.size(); ++i) {
+        table[i] = Pred(static_cast<char>(i));
+    }
+    return table;
+}
+
+constexpr std::array<bool, 256> TOKEN_TABLE = make_table<is_token_char>();
+constexpr std::array<bool, 256> VISIBLE_TABLE = make_table<is_visible_char>();
+constexpr std::array<bool, 256> VALUE_TABLE = make_table<is_value_char>();
+
+size_t scan_table(const std::array<bool, 256>& table, const char* const data,
+                  const size_t size, size_t from) noexcept {
+    while (from < size && table[static_cast<unsigned char>(data[from])]) {
+        ++from;
+    }
+    return from;
+}
+
+#if defined(__x86_64__)
+/// Token characters are classified with two shuffles, like in simdjson. A
+/// byte is a token character if the class bits of its high nibble and its
+/// low nibble intersect. Every distinct set of valid low nibbles gets its own
+/// bit, which fits in a byte as long as there are at most eight of them
+struct NibbleTables {
+    std::array<uint8_t, 16> high{};
+    std::array<uint8_t, 16> low{};
+};
+
+constexpr NibbleTables make_nibble_tables() noexcept {
+    NibbleTables tables;
+    std::array<uint16_t, 16> rows{};
+    for (size_t high = 0; high < 16; ++high) {
+        for (size_t low = 0; low < 16; ++low) {
+            if (TOKEN_TABLE[high << 4 | low]) {
+                rows[high] |= static_cast<uint16_t>(1 << low);
+            }
+        }
+    }
+
+    size_t classes = 0;
+    for (size_t high = 0; high < 16; ++high) {
+        if (rows[high] == 0) {
+            continue;
+        }
+        const auto bit = static_cast<uint8_t>(1 << classes++);
+        tables.high[high] = bit;
+        for (size_t low = 0; low < 16; ++low) {
+            if ((rows[high] >> low & 1) != 0) {
+                tables.low[low] |= bit;
+            }
+        }
+    }
+    return tables;
+}
+
+constexpr NibbleTables TOKEN_NIBBLES = make_nibble_tables();
+
+constexpr bool nibble_tables_match() noexcept {
+    for (size_t c = 0; c < 256; ++c) {
+        const bool classified =
+            (TOKEN_NIBBLES.high[c >> 4] & TOKEN_NIBBLES.low[c & 0xf]) != 0;
+        if (classified != TOKEN_TABLE[c]) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(nibble_tables_match());
+
+const __m128i* nibbles(const std::array<uint8_t, 16>& table) noexcept {
+    return reinterpret_cast<const __m128i*>(table.data());
+}
+#endif
+
+using Scanner = size_t (*)(const char*, size_t, size_t) noexcept;
+
+struct Scanners {
+    Scanner token;
+    Scanner visible;
+    Scanner value;
+    std::string_view name;
+};
+
+Scanners detect() noexcept {
+#if defined(__x86_64__)
+    if (has_avx2()) {
+        return {token_avx2, visible_avx2, value_avx2, "avx2"};
+    }
+    if (has_sse42()) {
+        return {token_sse42, visible_sse42, value_sse42, "sse4.2"};
+    }
+#endif
+    return {token_scalar, visible_scalar, value_scalar, "scalar"};
+}
+
+const Scanners& scanners() noexcept {
+    static const Scanners SCANNERS = detect();
+    return SCANNERS;
+}
+}  // namespace
+
+size_t token(const std::string_view data, const size_t from) noexcept {
+    return scanners().token(data.data(), data.size(), from);
+}
+
+size_t visible(const std::string_view data, const size_t from) noexcept {
+    return scanners().visible(data.data(), data.size(), from);
+}
+
+size_t value(const std::string_view data, const size_t from) noexcept {
+    return scanners().value(data.data(), data.size(), from);
+}
+
+std::string_view implementation() noexcept { return scanners().name; }
+
+// ===== scalar =====
+size_t token_scalar(const char* const data, const size_t size,
+                    const size_t from) noexcept {
+    return scan_table(TOKEN_TABLE, data, size, from);
+}
+
+size_t visible_scalar(const char* const data, const size_t size,
+                      const size_t from) noexcept {
+    return scan_table(VISIBLE_TABLE, data, size, from);
+}
+
+size_t value_scalar(const char* const data, const size_t size,
+                    const size_t from) noexcept {
+    return scan_table(VALUE_TABLE, data, size, from);
+}
+
+#if defined(__x86_64__)
+// ===== SSE 4.2 =====
+bool has_sse42() noexcept { return __builtin_cpu_supports("sse4.2"); }
+
+[[gnu::target("sse4.2")]] size_t token_sse42(const char* const data,
+                                             const size_t size,
+                                             size_t from) noexcept {
+    const __m128i high_table = _mm_loadu_si128(nibbles(TOKEN_NIBBLES.high));
+    const __m128i low_table = _mm_loadu_si128(nibbles(TOKEN_NIBBLES.low));
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+
+    for (; from + 16 <= size; from += 16) {
+        const __m128i chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+        const __m128i high =
+            _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble_mask);
+        const __m128i low = _mm_and_si128(chunk, nibble_mask);
+        const __m128i classes =
+            _mm_and_si128(_mm_shuffle_epi8(high_table, high),
+                          _mm_shuffle_epi8(low_table, low));
+        const auto stops = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(classes, _mm_setzero_si128())));
+        if (stops != 0) {
+            return from + static_cast<size_t>(__builtin_ctz(stops));
+        }
+    }
+    return token_scalar(data, size, from);
+}
+
+/// Index of the first byte of the 16 at `data` which falls into one of the
+/// inclusive byte `ranges`, 16 if there is none. Same as picohttpparser does
+[[gnu::target("sse4.2")]] inline int find_in_ranges(
+    const char* const data, const __m128i ranges,
+    const int ranges_size) noexcept {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    return _mm_cmpestri(ranges, ranges_size, chunk, 16,
+                        _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES |
+                            _SIDD_LEAST_SIGNIFICANT);
+}
+
+[[gnu::target("sse4.2")]] size_t visible_sse42(const char* const data,
+                                               const size_t size,
+                                               size_t from) noexcept {
+    const __m128i ranges = _mm_setr_epi8('\x00', ' ', '\x7f', '\xff', 0, 0, 0,
+                                         0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (; from + 16 <= size; from += 16) {
+        const int found = find_in_ranges(data + from, ranges, 4);
+        if (found != 16) {
+            return from + static_cast<size_t>(found);
+        }
+    }
+    return visible_scalar(data, size, from);
+}
+
+[[gnu::target("sse4.2")]] size_t value_sse42(const char* const data,
+                                             const size_t size,
+                                             size_t from) noexcept {
+    const __m128i ranges = _mm_setr_epi8('\x00', '\x08', '\x0a', '\x1f',
+                                         '\x7f', '\x7f', 0, 0, 0, 0, 0, 0, 0,
+                                         0, 0, 0);
+    for (; from + 16 <= size; from += 16) {
+        const int found = find_in_ranges(data + from, ranges, 6);
+        if (found != 16) {
+            return from + static_cast<size_t>(found);
+        }
+    }
+    return value_scalar(data, size, from);
+}
+
+// ===== AVX2 =====
+// Each scan leaves the rest, which is shorter than a vector, to the SSE 4.2
+// one, as it may still be worth scanning half as wide
+bool has_avx2() noexcept { return __builtin_cpu_supports("avx2"); }
+
+[[gnu::target("avx2")]] size_t token_avx2(const char* const data,
+                                          const size_t size,
+                                          size_t from) noexcept {
+    // shuffles work within 128 bit lanes, so both get the same table
+    const __m256i high_table = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(nibbles(TOKEN_NIBBLES.high)));
+    const __m256i low_table = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(nibbles(TOKEN_NIBBLES.low)));
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+
+    for (; from + 32 <= size; from += 32) {
+        const __m256i chunk =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+        const __m256i high =
+            _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble_mask);
+        const __m256i low = _mm256_and_si256(chunk, nibble_mask);
+        const __m256i classes =
+            _mm256_and_si256(_mm256_shuffle_epi8(high_table, high),
+                             _mm256_shuffle_epi8(low_table, low));
+        const auto stops = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(classes, _mm256_setzero_si256())));
+        if (stops != 0) {
+            return from + static_cast<size_t>(__builtin_ctz(stops));
+        }
+    }
+    return token_sse42(data, size, from);
+}
+
+[[gnu::target("avx2")]] size_t visible_avx2(const char* const data,
+                                            const size_t size,
+                                            size_t from) noexcept {
+    // bytes past 0x7f are negative, so they fail the first comparison
+    const __m256i above = _mm256_set1_epi8(' ');
+    const __m256i below = _mm256_set1_epi8('\x7f');
+
+    for (; from + 32 <= size; from += 32) {
+        const __m256i chunk =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+        const __m256i visible = _mm256_and_si256(
+            _mm256_cmpgt_epi8(chunk, above), _mm256_cmpgt_epi8(below, chunk));
+        const auto stops =
+            ~static_cast<uint32_t>(_mm256_movemask_epi8(visible));
+        if (stops != 0) {
+            return from + static_cast<size_t>(__builtin_ctz(stops));
+        }
+    }
+    return visible_sse42(data, size, from);
+}
+
+[[gnu::target("avx2")]] size_t value_avx2(const char* const data,
+                                          const size_t size,
+                                          size_t from) noexcept {
+    const __m256i last_control = _mm256_set1_epi8('\x1f');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8('\x7f');
+
+    for (; from + 32 <= size; from += 32) {
+        const __m256i chunk =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+        // unsigned `chunk <= 0x1f`
+        const __m256i control = _mm256_cmpeq_epi8(
+            _mm256_min_epu8(chunk, last_control), chunk);
+        const __m256i invalid = _mm256_or_si256(
+            _mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, tab), control),
+            _mm256_cmpeq_epi8(chunk, del));
+        const auto stops =
+            static_cast<uint32_t>(_mm256_movemask_epi8(invalid));
+        if (stops != 0) {
+            return from + static_cast<size_t>(__builtin_ctz(stops));
+        }
+    }
+    return value_sse42(data, size, from);
+}
+#endif
+}  // namespace waxwing::internal::char_scan
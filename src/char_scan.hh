@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace waxwing::internal {
+/// Scanners for the parser's hot loops. Each returns the position of the
+/// first byte from `from` that doesn't belong to the scanned class, or the
+/// size of `data` if there is none. Vectorized versions are picked at runtime
+/// depending on the CPU, the scalar ones are the fallback
+namespace char_scan {
+/// Characters of a method or a header name
+size_t token(std::string_view data, size_t from) noexcept;
+/// Visible ASCII, the characters of a target or a version
+size_t visible(std::string_view data, size_t from) noexcept;
+/// Characters of a header value, anything but controls except for the tab
+size_t value(std::string_view data, size_t from) noexcept;
+
+/// Name of the instruction set the scanners use, for diagnostics
+std::string_view implementation() noexcept;
+
+// every implementation is exposed for testing them against each other
+size_t token_scalar(const char* data, size_t size, size_t from) noexcept;
+size_t visible_scalar(const char* data, size_t size, size_t from) noexcept;
+size_t value_scalar(const char* data, size_t size, size_t from) noexcept;
+
+#if defined(__x86_64__)
+bool has_sse42() noexcept;
+size_t token_sse42(const char* data, size_t size, size_t from) noexcept;
+size_t visible_sse42(const char* data, size_t size, size_t from) noexcept;
+size_t value_sse42(const char* data, size_t size, size_t from) noexcept;
+
+bool has_avx2() noexcept;
+size_t token_avx2(const char* data, size_t size, size_t from) noexcept;
+size_t visible_avx2(const char* data, size_t size, size_t from) noexcept;
+size_t value_avx2(const char* data, size_t size, size_t from) noexcept;
+#endif
+}  // namespace char_scan
+}  // namespace waxwing::internal
@@ -0,0 +1,267 @@
+#include "chunked_decoder.hh"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "char_scan.hh"
+#include "parse_error.hh"
+#include "waxwing/http.hh"
+#include "waxwing/result.hh"
+#include "waxwing/str_util.hh"
+
+namespace waxwing::internal {
+namespace {
+// sizes of up to 15 hex digits can't overflow
+constexpr size_t MAX_SIZE_DIGITS = 15;
+constexpr size_t MAX_EXTENSIONS_SIZE = 1024;
+
+int hex_digit(const char c) noexcept {
+    if ('0' <= c && c <= '9') {
+        return c - '0';
+    }
+    if ('a' <= c && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if ('A' <= c && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool is_whitespace(const char c) noexcept { return c == ' ' || c == '\t'; }
+
+Error<ParseError> bad_request(std::string message) {
+    return Error{
+        ParseError{HttpStatusCode::BadRequest_400, std::move(message)}};
+}
+}  // namespace
+
+Result<ChunkedDecoder::Decoded, ParseError> ChunkedDecoder::decode(
+    const std::string_view input) {
+    size_t pos = 0;
+    while (pos < input.size() && state_ != State::Done) {
+        const char c = input[pos];
+        switch (state_) {
+            case State::Size: {
+                const int digit = hex_digit(c);
+                if (digit >= 0) {
+                    if (size_digits_ == MAX_SIZE_DIGITS) {
+                        return bad_request("chunk size is too large");
+                    }
+                    chunk_remaining_ = chunk_remaining_ << 4 |
+                                       static_cast<size_t>(digit);
+                    ++size_digits_;
+                    ++pos;
+                } else if (size_digits_ == 0 ||
+                           !(c == ';' || c == '\r' || c == '\n' ||
+                             is_whitespace(c))) {
+                    return bad_request("malformed chunk size");
+                } else if (is_whitespace(c)) {
+                    state_ = State::SizeWhitespace;
+                } else {
+                    // extensions aren't used for anything, only skipped
+                    state_ = State::Extension;
+                }
+                break;
+            }
+
+            case State::SizeWhitespace:
+                if (is_whitespace(c)) {
+                    if (++extension_size_ > MAX_EXTENSIONS_SIZE) {
+                        return bad_request("chunk extensions are too long");
+                    }
+                    ++pos;
+                } else if (c == ';' || c == '\r' || c == '\n') {
+                    state_ = State::Extension;
+                } else {
+                    // anything else would be read differently by someone
+                    // else, which smuggles requests past them
+                    return bad_request("malformed chunk size");
+                }
+                break;
+
+            case State::Extension: {
+                // skipped in a single scan, up to the control ending them
+                const size_t end = char_scan::value(input, pos);
+                extension_size_ += end - pos;
+                if (extension_size_ > MAX_EXTENSIONS_SIZE) {
+                    return bad_request("chunk extensions are too long");
+                }
+                pos = end;
+                if (pos == input.size()) {
+                    break;
+                }
+                if (input[pos] == '\r') {
+                    state_ = State::SizeLineEnd;
+                    ++pos;
+                    break;
+                }
+                if (input[pos] != '\n') {
+                    return bad_request("control character in a chunk size");
+                }
+                ++pos;
+                Result<void, ParseError> finished = finish_size_line();
+                if (!finished) {
+                    return Error{std::move(finished.error())};
+                }
+                break;
+            }
+
+            case State::SizeLineEnd: {
+                if (c != '\n') {
+                    return bad_request("expected a line feed");
+                }
+                ++pos;
+                Result<void, ParseError> finished = finish_size_line();
+                if (!finished) {
+                    return Error{std::move(finished.error())};
+                }
+                break;
+            }
+
+            case State::Data: {
+                const size_t length =
+                    std::min(chunk_remaining_, input.size() - pos);
+                const std::string_view data = input.substr(pos, length);
+                pos += length;
+                chunk_remaining_ -= length;
+                if (chunk_remaining_ == 0) {
+                    state_ = State::DataEnd;
+                }
+                return Decoded{pos, data, false};
+            }
+
+            case State::DataEnd:
+                if (c == '\r') {
+                    state_ = State::DataLineEnd;
+                } else if (c == '\n') {
+                    state_ = State::Size;
+                } else {
+                    return bad_request("expected the end of a chunk");
+                }
+                ++pos;
+                break;
+
+            case State::DataLineEnd:
+                if (c != '\n') {
+                    return bad_request("expected a line feed");
+                }
+                state_ = State::Size;
+                ++pos;
+                break;
+
+            case State::Trailers: {
+                const size_t line_end = input.find('\n', pos);
+                const size_t end = line_end == std::string_view::npos
+                                       ? input.size()
+                                       : line_end + 1;
+                trailer_data_ += input.substr(pos, end - pos);
+                pos = end;
+                if (trailer_data_.size() > config_.max_headers_size) {
+                    return Error{ParseError{
+                        HttpStatusCode::RequestHeaderFieldsTooLarge_431,
+                        "trailer fields are too large"}};
+                }
+                if (line_end == std::string_view::npos) {
+                    break;
+                }
+
+                const std::string_view line =
+                    std::string_view{trailer_data_}.substr(
+                        trailer_line_start_);
+                trailer_line_start_ = trailer_data_.size();
+                if (line == "\n" || line == "\r\n") {
+                    Result<void, ParseError> parsed = parse_trailers();
+                    if (!parsed) {
+                        return Error{std::move(parsed.error())};
+                    }
+                    state_ = State::Done;
+                }
+                break;
+            }
+
+            case State::Done:
+                break;
+        }
+    }
+    return Decoded{pos, {}, state_ == State::Done};
+}
+
+Result<void, ParseError> ChunkedDecoder::finish_size_line() {
+    size_digits_ = 0;
+    extension_size_ = 0;
+
+    // the last chunk is empty and followed by the trailer section
+    if (chunk_remaining_ == 0) {
+        state_ = State::Trailers;
+        return {};
+    }
+    if (max_size_ != 0 && chunk_remaining_ > max_size_ - decoded_) {
+        return Error{ParseError{
+            HttpStatusCode::ContentTooLarge_413,
+            fmt::format("chunked body exceeds {} bytes", max_size_)}};
+    }
+    decoded_ += chunk_remaining_;
+    state_ = State::Data;
+    return {};
+}
+
+Result<void, ParseError> ChunkedDecoder::parse_trailers() {
+    // the section doesn't change from now on, so the fields may refer to it
+    const std::string_view section = trailer_data_;
+    size_t line_start = 0;
+    for (;;) {
+        const size_t line_end = section.find('\n', line_start);
+        std::string_view line =
+            section.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+        if (line.ends_with('\r')) {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            return {};
+        }
+
+        const size_t name_end = char_scan::token(line, 0);
+        if (name_end == 0 || name_end == line.size() ||
+            line[name_end] != ':') {
+            return bad_request("malformed trailer field");
+        }
+        const std::string_view value =
+            str_util::trim(line.substr(name_end + 1));
+        if (char_scan::value(value, 0) != value.size()) {
+            return bad_request("control character in a trailer field");
+        }
+
+        trailers_.push_back(HeaderField{line.substr(0, name_end), value});
+        if (trailers_.size() > config_.max_header_count) {
+            return Error{
+                ParseError{HttpStatusCode::RequestHeaderFieldsTooLarge_431,
+                           "too many trailer fields"}};
+        }
+    }
+}
+
+void ChunkedDecoder::reset(const size_t max_size) noexcept {
+    state_ = State::Size;
+    max_size_ = max_size;
+    decoded_ = 0;
+    chunk_remaining_ = 0;
+    size_digits_ = 0;
+    extension_size_ = 0;
+    trailer_data_.clear();
+    trailer_line_start_ = 0;
+    trailers_.clear();
+}
+
+size_t ChunkedDecoder::decoded() const noexcept { return decoded_; }
+
+std::span<const HeaderField> ChunkedDecoder::trailers() const noexcept {
+    return trailers_;
+}
+}  // namespace waxwing::internal
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parse_error.hh"
+#include "waxwing/config.hh"
+#include "waxwing/request.hh"
+#include "waxwing/result.hh"
+
+namespace waxwing::internal {
+/// Decoder of the chunked transfer coding of request bodies. Unlike the
+/// request parser it's fed every byte exactly once, so the input may be
+/// dropped as soon as it's decoded. Decoded data is never copied, but handed
+/// out as parts of the input
+class ChunkedDecoder final {
+public:
+    /// Outcome of a single `decode` call
+    struct Decoded {
+        /// Bytes of the input used up
+        size_t consumed = 0;
+        /// Decoded data, a part of the input
+        std::string_view data;
+        /// Whether the body is complete, trailer fields included
+        bool done = false;
+    };
+
+private:
+    enum class State {
+        Size,
+        // whitespace after the size, only followed by an extension or the
+        // end of the line
+        SizeWhitespace,
+        Extension,
+        SizeLineEnd,
+        Data,
+        DataEnd,
+        DataLineEnd,
+        Trailers,
+        Done,
+    };
+
+    const ServerConfig& config_;
+
+    State state_ = State::Size;
+    // zero means no limit
+    size_t max_size_ = 0;
+    size_t decoded_ = 0;
+    // while reading the size line it's the size read so far
+    size_t chunk_remaining_ = 0;
+    size_t size_digits_ = 0;
+    size_t extension_size_ = 0;
+    // trailer section, kept until it's complete to parse it at once
+    std::string trailer_data_;
+    size_t trailer_line_start_ = 0;
+    std::vector<HeaderField> trailers_;
+
+    Result<void, ParseError> finish_size_line();
+    Result<void, ParseError> parse_trailers();
+
+public:
+    explicit ChunkedDecoder(const ServerConfig& config) noexcept
+        : config_{config} {}
+
+    /// Decode the beginning of `input`, which continues right where the
+    /// input of the previous call ended. Stops after every piece of data, so
+    /// it has to be called again until the input is used up or the body is
+    /// done
+    Result<Decoded, ParseError> decode(std::string_view input);
+    /// Start decoding another body of at most `max_size` bytes, zero means
+    /// no limit
+    void reset(size_t max_size) noexcept;
+
+    /// Bytes of the body decoded so far
+    size_t decoded() const noexcept;
+    /// Trailer fields, valid once the body is done until the next `reset`
+    std::span<const HeaderField> trailers() const noexcept;
+};
+}  // namespace waxwing::internal
@@ -0,0 +1,95 @@
+#include "connection_park.hh"
+
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "idle_timer.hh"
+#include "waxwing/io.hh"
+#include "waxwing/result.hh"
+
+namespace waxwing::internal {
+namespace {
+constexpr size_t MAX_EVENTS = 256;
+}  // namespace
+
+void ConnectionPark::park(
+    std::unique_ptr<ParkedConnection> connection) noexcept {
+    const int fd = connection->connection.fd();
+
+    const std::lock_guard lock{mutex_};
+    ParkedConnection& parked = *parked_.emplace(fd, std::move(connection))
+                                    .first->second;
+    idle_timer_.start(static_cast<uint64_t>(fd), parked.idle);
+
+    // data that has arrived in the meantime is reported right away
+    const Result<void, std::string> added =
+        reactor_.add(fd, static_cast<uint64_t>(fd));
+    if (!added) {
+        spdlog::warn("watching connection failed: {}", added.error());
+        idle_timer_.stop(parked.idle);
+        parked_.erase(fd);
+    }
+}
+
+std::unique_ptr<ParkedConnection> ConnectionPark::take(const int fd) noexcept {
+    const std::lock_guard lock{mutex_};
+    const auto iter = parked_.find(fd);
+    if (iter == parked_.end()) {
+        return nullptr;
+    }
+    std::unique_ptr<ParkedConnection> connection = std::move(iter->second);
+    parked_.erase(iter);
+
+    // it's added again once it's parked again
+    reactor_.remove(fd);
+    idle_timer_.stop(connection->idle);
+    return connection;
+}
+
+Result<void, std::string> ConnectionPark::run() {
+    // parking a connection can't cut the wait short, so the deadlines are
+    // looked for regularly instead
+    const int timeout_ms =
+        idle_timeout_ == std::chrono::milliseconds::zero()
+            ? -1
+            : static_cast<int>(idle_check_interval(idle_timeout_).count());
+
+    std::array<Reactor::Event, MAX_EVENTS> events{};
+    for (;;) {
+        const Result<size_t, std::string> ready =
+            reactor_.wait(events, timeout_ms);
+        if (!ready) {
+            return Error{ready.error()};
+        }
+
+        for (size_t i = 0; i < *ready; ++i) {
+            // every connection is writable once it's added
+            const Reactor::Event& event = events[i];
+            if (!event.readable && !event.failed) {
+                continue;
+            }
+            std::unique_ptr<ParkedConnection> connection =
+                take(static_cast<int>(event.token));
+            if (connection == nullptr) {
+                continue;
+            }
+            // the worker finds out about failures when it receives
+            resume_(std::move(connection));
+        }
+
+        const std::lock_guard lock{mutex_};
+        idle_timer_.expire([this](const uint64_t fd) {
+            const int raw_fd = static_cast<int>(fd);
+            reactor_.remove(raw_fd);
+            parked_.erase(raw_fd);
+        });
+    }
+}
+}  // namespace waxwing::internal
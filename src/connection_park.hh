@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "idle_timer.hh"
+#include "session.hh"
+#include "waxwing/config.hh"
+#include "waxwing/io.hh"
+#include "waxwing/result.hh"
+#include "waxwing/router.hh"
+
+namespace waxwing::internal {
+/// Connection served by the thread pool, together with the state of its
+/// session, which outlives the worker that served it last
+struct ParkedConnection {
+    ParkedConnection(const Router& router, const ServerConfig& config,
+                     Connection&& connection)
+        : connection{std::move(connection)}, session{router, config} {}
+
+    Connection connection;
+    Session session;
+    IdleTimer::Handle idle;
+};
+
+/// Connections of the thread pool waiting for more of their requests. Workers
+/// park them instead of blocking until the data arrives, so idle clients
+/// don't hold the workers up. A parked connection is resumed once it's
+/// readable, and closed once it stays idle for too long
+class ConnectionPark final {
+public:
+    /// Hands a readable connection back to be served
+    using Resume = std::function<void(std::unique_ptr<ParkedConnection>)>;
+
+private:
+    Reactor reactor_;
+    Resume resume_;
+    std::chrono::milliseconds idle_timeout_;
+
+    // guards the connections, which workers park while they're resumed
+    std::mutex mutex_;
+    IdleTimer idle_timer_;
+    std::unordered_map<int, std::unique_ptr<ParkedConnection>> parked_;
+
+    /// Stop watching the connection `fd`, empty if it isn't parked
+    std::unique_ptr<ParkedConnection> take(int fd) noexcept;
+
+public:
+    ConnectionPark(Reactor&& reactor, Resume resume,
+                   std::chrono::milliseconds idle_timeout)
+        : reactor_{std::move(reactor)},
+          resume_{std::move(resume)},
+          idle_timeout_{idle_timeout},
+          idle_timer_{idle_timeout} {}
+
+    /// Watch `connection` until it's readable. Can be called from any thread
+    void park(std::unique_ptr<ParkedConnection> connection) noexcept;
+
+    /// Resume and expire the parked connections from the calling thread.
+    /// Returns only on failure
+    Result<void, std::string> run();
+};
+}  // namespace waxwing::internal
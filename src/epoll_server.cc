@@ -0,0 +1,291 @@
+#include "epoll_server.hh"
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "idle_timer.hh"
+#include "output_buffer.hh"
+#include "session.hh"
+#include "waxwing/config.hh"
+#include "waxwing/file.hh"
+#include "waxwing/io.hh"
+#include "waxwing/result.hh"
+#include "waxwing/router.hh"
+
+namespace waxwing::internal {
+namespace {
+constexpr size_t MAX_EVENTS = 256;
+constexpr uint64_t LISTENER_TOKEN = std::numeric_limits<uint64_t>::max();
+/// How soon accepting is tried again once it failed for lack of descriptors
+constexpr int ACCEPT_RETRY_MS = 100;
+
+bool would_block(const std::errc error) noexcept {
+    return error == std::errc::resource_unavailable_try_again ||
+           error == std::errc::operation_would_block;
+}
+
+/// Milliseconds to pass to `Reactor::wait`, rounded up so the deadline has
+/// passed once it returns
+int wait_timeout(const std::optional<IdleTimer::Clock::duration> timeout) {
+    if (!timeout.has_value()) {
+        return -1;
+    }
+    return static_cast<int>(
+        std::chrono::ceil<std::chrono::milliseconds>(*timeout).count());
+}
+
+struct EpollConnection {
+    EpollConnection(const Router& router, const ServerConfig& config,
+                    Connection&& connection)
+        : connection{std::move(connection)}, session{router, config} {}
+
+    Connection connection;
+    Session session;
+    IdleTimer::Handle idle;
+
+    OutputBuffer sending;
+
+    // peer won't send anything else, but still waits for the responses
+    bool eof = false;
+    // receiving stopped before the socket was drained, since the session
+    // didn't want any more input
+    bool stalled = false;
+};
+
+class EpollServer final {
+    const Router& router_;
+    const Socket& socket_;
+    const ServerConfig& config_;
+    Reactor reactor_;
+    IdleTimer idle_timer_;
+
+    // connections are indexed by their descriptors, which are unique for as
+    // long as the connection is open
+    std::vector<std::unique_ptr<EpollConnection>> connections_;
+    // accepting failed before the listener was drained, and the listener
+    // won't report the connections that are left again
+    bool accept_pending_ = false;
+
+    void accept_all();
+    void close(int fd);
+
+    /// Read until the socket is drained, or the session doesn't want more.
+    /// Returns `false` on failure
+    bool receive(EpollConnection& conn);
+    /// Send pending output until the socket is full. Returns `false` on
+    /// failure
+    bool flush(EpollConnection& conn);
+
+    void on_event(const Reactor::Event& event);
+
+public:
+    EpollServer(const Router& router, const Socket& socket,
+                const ServerConfig& config, Reactor&& reactor)
+        : router_{router},
+          socket_{socket},
+          config_{config},
+          reactor_{std::move(reactor)},
+          idle_timer_{config.idle_timeout} {}
+
+    Result<void, std::string> run();
+};
+
+void EpollServer::accept_all() {
+    const bool retrying = accept_pending_;
+    accept_pending_ = false;
+    for (;;) {
+        Connection connection = socket_.accept(true);
+        if (!connection.is_valid()) {
+            const int error = errno;
+            if (error == ECONNABORTED || error == EINTR) {
+                continue;
+            }
+            if (!would_block(std::errc{error})) {
+                // e.g. out of descriptors, which closing connections frees
+                if (!retrying) {
+                    spdlog::warn(
+                        "accept failed: {}",
+                        std::make_error_code(std::errc{error}).message());
+                }
+                accept_pending_ = true;
+            }
+            return;
+        }
+
+        const int fd = connection.fd();
+        const Result<void, std::string> added =
+            reactor_.add(fd, static_cast<uint64_t>(fd));
+        if (!added) {
+            spdlog::warn("watching connection failed: {}", added.error());
+            continue;
+        }
+
+        if (static_cast<size_t>(fd) >= connections_.size()) {
+            connections_.resize(static_cast<size_t>(fd) + 1);
+        }
+        connections_[fd] = std::make_unique<EpollConnection>(
+            router_, config_, std::move(connection));
+        idle_timer_.start(static_cast<uint64_t>(fd), connections_[fd]->idle);
+    }
+}
+
+void EpollServer::close(const int fd) {
+    reactor_.remove(fd);
+    idle_timer_.stop(connections_[fd]->idle);
+    connections_[fd].reset();
+}
+
+bool EpollServer::receive(EpollConnection& conn) {
+    conn.stalled = false;
+    while (!conn.eof && !conn.session.should_close()) {
+        if (!conn.session.wants_input()) {
+            // the socket won't report the data that's left again, so it's
+            // received once the session catches up
+            conn.stalled = true;
+            break;
+        }
+        const IoResult received =
+            conn.connection.try_recv(conn.session.input_buffer());
+        conn.session.commit_input(received ? *received : 0);
+        if (!received) {
+            return would_block(received.error());
+        }
+        if (*received == 0) {
+            conn.eof = true;
+            break;
+        }
+
+        idle_timer_.touch(conn.idle);
+    }
+    return true;
+}
+
+bool EpollServer::flush(EpollConnection& conn) {
+    std::array<iovec, OutputBuffer::MAX_IOVECS> iovecs{};
+    for (;;) {
+        if (conn.sending.empty()) {
+            if (!conn.session.has_output()) {
+                return true;
+            }
+            conn.sending = conn.session.take_output();
+        }
+
+        const std::optional<FileRange> file = conn.sending.front_file();
+        const IoResult sent =
+            file.has_value()
+                ? conn.connection.try_send_file(file->file->fd(),
+                                                file->offset, file->length)
+                : conn.connection.try_send(
+                      std::span{iovecs.data(), conn.sending.gather(iovecs)});
+        if (!sent) {
+            // the rest goes out once the socket reports it's writable again
+            return would_block(sent.error());
+        }
+        conn.sending.consume(*sent);
+        idle_timer_.touch(conn.idle);
+    }
+}
+
+void EpollServer::on_event(const Reactor::Event& event) {
+    if (event.token == LISTENER_TOKEN) {
+        accept_all();
+        return;
+    }
+
+    const auto fd = static_cast<int>(event.token);
+    if (!connections_[fd]) {
+        // closed while handling an earlier event of the same batch
+        return;
+    }
+    EpollConnection& conn = *connections_[fd];
+
+    if (event.readable && !receive(conn)) {
+        close(fd);
+        return;
+    }
+    if (!flush(conn)) {
+        close(fd);
+        return;
+    }
+    while (conn.stalled && conn.session.wants_input()) {
+        if (!receive(conn) || !flush(conn)) {
+            close(fd);
+            return;
+        }
+    }
+
+    const bool output_done =
+        conn.sending.empty() && !conn.session.has_output();
+    if (output_done && (conn.eof || conn.session.should_close())) {
+        close(fd);
+    } else if (event.failed) {
+        close(fd);
+    }
+}
+
+Result<void, std::string> EpollServer::run() {
+    Result<void, std::string> result = socket_.set_nonblocking();
+    if (!result) {
+        return result;
+    }
+    result = reactor_.add(socket_.fd(), LISTENER_TOKEN);
+    if (!result) {
+        return result;
+    }
+
+    std::array<Reactor::Event, MAX_EVENTS> events{};
+    for (;;) {
+        int timeout = wait_timeout(idle_timer_.next_expiry());
+        if (accept_pending_ && (timeout < 0 || timeout > ACCEPT_RETRY_MS)) {
+            timeout = ACCEPT_RETRY_MS;
+        }
+        const Result<size_t, std::string> ready =
+            reactor_.wait(events, timeout);
+        if (!ready) {
+            return Error{ready.error()};
+        }
+
+        for (size_t i = 0; i < *ready; ++i) {
+            on_event(events[i]);
+        }
+
+        idle_timer_.expire(
+            [this](const uint64_t fd) { close(static_cast<int>(fd)); });
+        if (accept_pending_) {
+            accept_all();
+        }
+    }
+}
+}  // namespace
+
+Result<void, std::string> serve_epoll(const Router& router,
+                                      const Socket& socket,
+                                      const ServerConfig& config) noexcept {
+    try {
+        Result<Reactor, std::string> reactor = Reactor::create();
+        if (!reactor) {
+            return Error{
+                fmt::format("epoll setup failed: {}", reactor.error())};
+        }
+
+        EpollServer server{router, socket, config, std::move(reactor.value())};
+        return server.run();
+    } catch (const std::exception& e) {
+        return Error{std::string{e.what()}};
+    }
+}
+}  // namespace waxwing::internal
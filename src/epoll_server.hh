@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+#include "waxwing/config.hh"
+#include "waxwing/io.hh"
+#include "waxwing/result.hh"
+#include "waxwing/router.hh"
+
+namespace waxwing::internal {
+/// Serve connections accepted on `socket` from the calling thread, waiting for
+/// readiness of all of them with an edge-triggered epoll reactor. Returns only
+/// on failure
+Result<void, std::string> serve_epoll(const Router& router,
+                                      const Socket& socket,
+                                      const ServerConfig& config) noexcept;
+}  // namespace waxwing::internal
@@ -0,0 +1,56 @@
+#include "waxwing/file.hh"
+
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "waxwing/result.hh"
+
+namespace waxwing {
+File::~File() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+File::File(File&& other) noexcept
+    : fd_{std::exchange(other.fd_, -1)}, size_{other.size_} {}
+
+File& File::operator=(File&& rhs) noexcept {
+    std::swap(fd_, rhs.fd_);
+    std::swap(size_, rhs.size_);
+    return *this;
+}
+
+Result<File, std::string> File::open(const std::string& path) {
+    // opening a FIFO would wait for a writer, so nothing is known to be a
+    // regular file until it's open. Reads of regular files never block
+    // anyway, so the flag doesn't need to be cleared afterwards
+    const int fd =
+        ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK | O_NOFOLLOW);
+    if (fd < 0) {
+        return Error{std::make_error_code(std::errc{errno}).message()};
+    }
+    File file{fd, 0};
+
+    struct stat info {};
+    if (::fstat(fd, &info) < 0) {
+        return Error{std::make_error_code(std::errc{errno}).message()};
+    }
+    if (!S_ISREG(info.st_mode)) {
+        return Error{fmt::format("`{}` is not a regular file", path)};
+    }
+
+    file.size_ = static_cast<size_t>(info.st_size);
+    return file;
+}
+
+int File::fd() const noexcept { return fd_; }
+size_t File::size() const noexcept { return size_; }
+}  // namespace waxwing
@@ -1,21 +1,217 @@
 #include "waxwing/http.hh"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <utility>
+
+#include "waxwing/str_util.hh"
 
 namespace waxwing {
+namespace {
+/// Fields looked up by the server itself or commonly set by handlers,
+/// lowercased
+constexpr std::array<std::string_view, Headers::KNOWN_FIELD_COUNT>
+    KNOWN_FIELDS{
+        "accept",          "accept-encoding",   "accept-language",
+        "accept-ranges",   "authorization",     "cache-control",
+        "connection",      "content-encoding",  "content-length",
+        "content-range",   "content-type",      "cookie",
+        "date",            "etag",              "expect",
+        "host",            "if-modified-since", "if-none-match",
+        "keep-alive",      "last-modified",     "location",
+        "origin",          "range",             "referer",
+        "server",          "set-cookie",        "te",
+        "trailer",         "transfer-encoding", "upgrade",
+        "user-agent",      "vary",
+    };
+
+// the table has four times as many slots as there are known fields, which
+// makes finding a multiplier without collisions quick
+constexpr size_t SLOT_BITS = 7;
+constexpr uint8_t NO_FIELD = 0xff;
+static_assert(KNOWN_FIELDS.size() < NO_FIELD);
+
+constexpr size_t slot_of(const size_t hash, const uint64_t multiplier) {
+    return static_cast<size_t>((hash * multiplier) >> (64 - SLOT_BITS));
+}
+
+/// Multiplier that gives every known field its own slot
+constexpr uint64_t find_multiplier() {
+    for (uint64_t multiplier = 0x9e3779b97f4a7c15ULL;; multiplier += 2) {
+        std::array<bool, size_t{1} << SLOT_BITS> used{};
+        bool collision = false;
+        for (const std::string_view name : KNOWN_FIELDS) {
+            const size_t slot =
+                slot_of(str_util::case_insensitive_hash(name), multiplier);
+            collision = collision || used[slot];
+            used[slot] = true;
+        }
+        if (!collision) {
+            return multiplier;
+        }
+    }
+}
+
+constexpr uint64_t MULTIPLIER = find_multiplier();
+
+constexpr std::array<uint8_t, size_t{1} << SLOT_BITS> make_slots() {
+    std::array<uint8_t, size_t{1} << SLOT_BITS> slots{};
+    slots.fill(NO_FIELD);
+    for (size_t i = 0; i < KNOWN_FIELDS.size(); ++i) {
+        slots[slot_of(str_util::case_insensitive_hash(KNOWN_FIELDS[i]),
+                      MULTIPLIER)] = static_cast<uint8_t>(i);
+    }
+    return slots;
+}
+
+constexpr std::array<uint8_t, size_t{1} << SLOT_BITS> SLOTS = make_slots();
+
+/// Index of the known field named `name`, whose hash is `hash`
+std::optional<size_t> known_field(const std::string_view name,
+                                  const size_t hash) noexcept {
+    const uint8_t index = SLOTS[slot_of(hash, MULTIPLIER)];
+    if (index == NO_FIELD ||
+        !str_util::case_insensitive_eq(KNOWN_FIELDS[index], name)) {
+        return std::nullopt;
+    }
+    return index;
+}
+
+constexpr size_t STATUS_CODE_LIMIT = 600;
+
+/// Status lines ready to be written, in the order of their codes
+constexpr std::array STATUS_LINE_LIST{
+    "HTTP/1.1 100 Continue\r\n",
+    "HTTP/1.1 101 Switching Protocols\r\n",
+    "HTTP/1.1 102 Processing\r\n",
+    "HTTP/1.1 103 EarlyHints\r\n",
+    "HTTP/1.1 200 OK\r\n",
+    "HTTP/1.1 201 Created\r\n",
+    "HTTP/1.1 202 Accepted\r\n",
+    "HTTP/1.1 203 Non-Authoritative Information\r\n",
+    "HTTP/1.1 204 No Content\r\n",
+    "HTTP/1.1 205 Reset Content\r\n",
+    "HTTP/1.1 206 Partial Content\r\n",
+    "HTTP/1.1 207 Multi-Status\r\n",
+    "HTTP/1.1 208 Already Reported\r\n",
+    "HTTP/1.1 226 IM Used\r\n",
+    "HTTP/1.1 300 Multiple Choices\r\n",
+    "HTTP/1.1 301 Moved Permanently\r\n",
+    "HTTP/1.1 302 Found\r\n",
+    "HTTP/1.1 303 See Other\r\n",
+    "HTTP/1.1 304 Not Modified\r\n",
+    "HTTP/1.1 307 Temporary Redirect\r\n",
+    "HTTP/1.1 308 Permanent Redirect\r\n",
+    "HTTP/1.1 400 Bad Request\r\n",
+    "HTTP/1.1 401 Unauthorized\r\n",
+    "HTTP/1.1 402 Payment Required\r\n",
+    "HTTP/1.1 403 Forbidden\r\n",
+    "HTTP/1.1 404 Not Found\r\n",
+    "HTTP/1.1 405 Method Not Allowed\r\n",
+    "HTTP/1.1 406 Not Acceptable\r\n",
+    "HTTP/1.1 407 Proxy Authentication Required\r\n",
+    "HTTP/1.1 408 Request Timeout\r\n",
+    "HTTP/1.1 409 Conflict\r\n",
+    "HTTP/1.1 410 Gone\r\n",
+    "HTTP/1.1 411 Length Required\r\n",
+    "HTTP/1.1 412 Precondition Failed\r\n",
+    "HTTP/1.1 413 Content Too Large\r\n",
+    "HTTP/1.1 414 URI Too Long\r\n",
+    "HTTP/1.1 415 Unsupported Media Type\r\n",
+    "HTTP/1.1 416 Range Not Satisfiable\r\n",
+    "HTTP/1.1 417 Expectation Failed\r\n",
+    "HTTP/1.1 418 I'a a teapot\r\n",
+    "HTTP/1.1 421 Misdirected Request\r\n",
+    "HTTP/1.1 422 Unprocessable Content\r\n",
+    "HTTP/1.1 423 Locked\r\n",
+    "HTTP/1.1 424 Failed Dependency\r\n",
+    "HTTP/1.1 425 Too Early\r\n",
+    "HTTP/1.1 426 Upgrade Required\r\n",
+    "HTTP/1.1 428 Precondition Required\r\n",
+    "HTTP/1.1 429 Too Many Requests\r\n",
+    "HTTP/1.1 431 Request Header Fields Too Large\r\n",
+    "HTTP/1.1 451 Unavailable For Legal Reasons\r\n",
+    "HTTP/1.1 500 Internal Server Error\r\n",
+    "HTTP/1.1 501 Not Implemented\r\n",
+    "HTTP/1.1 502 Bad Gateway\r\n",
+    "HTTP/1.1 503 Service Unavailable\r\n",
+    "HTTP/1.1 504 Gateway Timeout\r\n",
+    "HTTP/1.1 505 HTTP Version Not Supported\r\n",
+    "HTTP/1.1 506 Variant Also Negotiates\r\n",
+    "HTTP/1.1 507 Insufficient Storage\r\n",
+    "HTTP/1.1 508 Loop Detected\r\n",
+    "HTTP/1.1 510 Not Extended\r\n",
+    "HTTP/1.1 511 Network Authentication Required\r\n",
+};
+
+/// Offset of the status code within a status line
+constexpr size_t STATUS_CODE_OFFSET = std::string_view{"HTTP/1.1 "}.size();
+
+constexpr size_t status_code_of(const std::string_view line) noexcept {
+    size_t code = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        code = code * 10 +
+               static_cast<size_t>(line[STATUS_CODE_OFFSET + i] - '0');
+    }
+    return code;
+}
+
+/// Status lines indexed by their code, empty for unknown codes
+constexpr std::array<std::string_view, STATUS_CODE_LIMIT> STATUS_LINES = [] {
+    std::array<std::string_view, STATUS_CODE_LIMIT> lines{};
+    for (const char* const line : STATUS_LINE_LIST) {
+        lines[status_code_of(line)] = line;
+    }
+    return lines;
+}();
+static_assert(STATUS_LINES[200] == "HTTP/1.1 200 OK\r\n");
+}  // namespace
+
+std::optional<size_t> Headers::find(const std::string_view key,
+                                    const size_t hash) const noexcept {
+    const std::optional<size_t> known = known_field(key, hash);
+    if (known.has_value()) {
+        const uint32_t position = known_[*known];
+        return position == 0 ? std::nullopt
+                             : std::optional<size_t>{position - 1};
+    }
+
+    for (size_t i = 0; i < hashes_.size(); ++i) {
+        if (hashes_[i] == hash &&
+            str_util::case_insensitive_eq(fields_[i].first, key)) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+void Headers::add(const std::string_view key, const std::string_view value,
+                  const size_t hash) {
+    const std::optional<size_t> known = known_field(key, hash);
+    // the strings are given the allocator of the array
+    fields_.emplace_back(key, value);
+    hashes_.push_back(hash);
+    if (known.has_value()) {
+        known_[*known] = static_cast<uint32_t>(fields_.size());
+    }
+}
+
 bool Headers::contains(const std::string_view key) const noexcept {
-    return repr_.contains(key);
+    return find(key, str_util::case_insensitive_hash(key)).has_value();
 }
 
 std::optional<std::string_view> Headers::get(
     const std::string_view key) const noexcept {
-    const auto iter = repr_.find(key);
-    if (iter == repr_.end()) {
+    const std::optional<size_t> position =
+        find(key, str_util::case_insensitive_hash(key));
+    if (!position.has_value()) {
         return std::nullopt;
     }
-
-    return iter->second;
+    return fields_[*position].second;
 }
 
 std::string_view format_method(const HttpMethod method) noexcept {
@@ -74,130 +270,13 @@ std::optional<HttpMethod> parse_method(const std::string_view s) noexcept {
 }
 
 std::string_view format_status_code(const HttpStatusCode code) noexcept {
-    switch (code) {
-        case HttpStatusCode::Continue_100:
-            return "100 Continue";
-        case HttpStatusCode::SwitchingProtocols_101:
-            return "101 Switching Protocols";
-        case HttpStatusCode::Processing_102:
-            return "102 Processing";
-        case HttpStatusCode::EarlyHints_103:
-            return "103 EarlyHints";
-        case HttpStatusCode::Ok_200:
-            return "200 OK";
-        case HttpStatusCode::Created_201:
-            return "201 Created";
-        case HttpStatusCode::Accepted_202:
-            return "202 Accepted";
-        case HttpStatusCode::NonAuthoritativeInformation_203:
-            return "203 Non-Authoritative Information";
-        case HttpStatusCode::NoContent_204:
-            return "204 No Content";
-        case HttpStatusCode::ResetContent_205:
-            return "205 Reset Content";
-        case HttpStatusCode::PartialContent_206:
-            return "206 Partial Content";
-        case HttpStatusCode::MultiStatus_207:
-            return "207 Multi-Status";
-        case HttpStatusCode::AlreadyReported_208:
-            return "208 Already Reported";
-        case HttpStatusCode::IMUsed_226:
-            return "226 IM Used";
-        case HttpStatusCode::MultipleChoices_300:
-            return "300 Multiple Choices";
-        case HttpStatusCode::MovedPermanently_301:
-            return "301 Moved Permanently";
-        case HttpStatusCode::Found_302:
-            return "302 Found";
-        case HttpStatusCode::SeeOther_303:
-            return "303 See Other";
-        case HttpStatusCode::NotModified_304:
-            return "304 Not Modified";
-        case HttpStatusCode::TemporaryRedirect_307:
-            return "307 Temporary Redirect";
-        case HttpStatusCode::PermanentRedirect_308:
-            return "308 Permanent Redirect";
-        case HttpStatusCode::BadRequest_400:
-            return "400 Bad Request";
-        case HttpStatusCode::Unauthorized_401:
-            return "401 Unauthorized";
-        case HttpStatusCode::PaymentRequired_402:
-            return "402 Payment Required";
-        case HttpStatusCode::Forbidden_403:
-            return "403 Forbidden";
-        case HttpStatusCode::NotFound_404:
-            return "404 Not Found";
-        case HttpStatusCode::MethodNotAllowed_405:
-            return "405 Method Not Allowed";
-        case HttpStatusCode::NotAcceptable_406:
-            return "406 Not Acceptable";
-        case HttpStatusCode::ProxyAuthenticationRequired_407:
-            return "407 Proxy Authentication Required";
-        case HttpStatusCode::RequestTimeout_408:
-            return "408 Request Timeout";
-        case HttpStatusCode::Conflict_409:
-            return "409 Conflict";
-        case HttpStatusCode::Gone_410:
-            return "410 Gone";
-        case HttpStatusCode::LengthRequired_411:
-            return "411 Length Required";
-        case HttpStatusCode::PreconditionFailed_412:
-            return "412 Precondition Failed";
-        case HttpStatusCode::ContentTooLarge_413:
-            return "413 Content Too Large";
-        case HttpStatusCode::URITooLong_414:
-            return "414 URI Too Long";
-        case HttpStatusCode::UnsupportedMediaType_415:
-            return "415 Unsupported Media Type";
-        case HttpStatusCode::RangeNotSatisfiable_416:
-            return "416 Range Not Satisfiable";
-        case HttpStatusCode::ExpectationFailed_417:
-            return "417 Expectation Failed";
-        case HttpStatusCode::ImATeapot_418:
-            return "418 I'a a teapot";
-        case HttpStatusCode::MisdirectedRequest_421:
-            return "421 Misdirected Request";
-        case HttpStatusCode::UnprocessableContent_422:
-            return "422 Unprocessable Content";
-        case HttpStatusCode::Locked_423:
-            return "423 Locked";
-        case HttpStatusCode::FailedDependency_424:
-            return "424 Failed Dependency";
-        case HttpStatusCode::TooEarly_425:
-            return "425 Too Early";
-        case HttpStatusCode::UpgradeRequired_426:
-            return "426 Upgrade Required";
-        case HttpStatusCode::PreconditionRequired_428:
-            return "428 Precondition Required";
-        case HttpStatusCode::TooManyRequests_429:
-            return "429 Too Many Requests";
-        case HttpStatusCode::RequestHeaderFieldsTooLarge_431:
-            return "431 Request Header Fields Too Large";
-        case HttpStatusCode::UnavailableForLegalReasons_451:
-            return "451 Unavailable For Legal Reasons";
-        case HttpStatusCode::InternalServerError_500:
-            return "500 Internal Server Error";
-        case HttpStatusCode::NotImplemented_501:
-            return "501 Not Implemented";
-        case HttpStatusCode::BadGateway_502:
-            return "502 Bad Gateway";
-        case HttpStatusCode::ServiceUnavailable_503:
-            return "503 Service Unavailable";
-        case HttpStatusCode::GatewayTimeout_504:
-            return "504 Gateway Timeout";
-        case HttpStatusCode::HTTPVersionNotSupported_505:
-            return "505 HTTP Version Not Supported";
-        case HttpStatusCode::VariantAlsoNegotiates_506:
-            return "506 Variant Also Negotiates";
-        case HttpStatusCode::InsufficientStorage_507:
-            return "507 Insufficient Storage";
-        case HttpStatusCode::LoopDetected_508:
-            return "508 Loop Detected";
-        case HttpStatusCode::NotExtended_510:
-            return "510 Not Extended";
-        case HttpStatusCode::NetworkAuthenticationRequired_511:
-            return "511 Network Authentication Required";
-    }
-    __builtin_unreachable();
+    const std::string_view line = format_status_line(code);
+    // without the version and the line break
+    return line.substr(STATUS_CODE_OFFSET,
+                       line.size() - STATUS_CODE_OFFSET - 2);
+}
+
+std::string_view format_status_line(const HttpStatusCode code) noexcept {
+    return STATUS_LINES[static_cast<size_t>(code)];
 }
 }  // namespace waxwing
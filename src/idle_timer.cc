@@ -0,0 +1,46 @@
+#include "idle_timer.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+namespace waxwing::internal {
+std::chrono::milliseconds idle_check_interval(
+    const std::chrono::milliseconds idle_timeout) noexcept {
+    using namespace std::chrono_literals;
+    return std::clamp<std::chrono::milliseconds>(idle_timeout / 4, 10ms, 1s);
+}
+
+void IdleTimer::start(const uint64_t id, Handle& handle) {
+    if (timeout_ == Clock::duration::zero()) {
+        return;
+    }
+    handle = entries_.insert(entries_.end(),
+                             Entry{id, Clock::now() + timeout_, &handle});
+}
+
+void IdleTimer::touch(Handle& handle) noexcept {
+    if (!handle.has_value()) {
+        return;
+    }
+    (*handle)->deadline = Clock::now() + timeout_;
+    entries_.splice(entries_.end(), entries_, *handle);
+}
+
+void IdleTimer::stop(Handle& handle) noexcept {
+    if (!handle.has_value()) {
+        return;
+    }
+    entries_.erase(*handle);
+    handle.reset();
+}
+
+std::optional<IdleTimer::Clock::duration> IdleTimer::next_expiry()
+    const noexcept {
+    if (entries_.empty()) {
+        return std::nullopt;
+    }
+    return std::max(entries_.front().deadline - Clock::now(),
+                    Clock::duration::zero());
+}
+}  // namespace waxwing::internal
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <optional>
+
+namespace waxwing::internal {
+/// How often the idle connections are looked for, when waiting can't be cut
+/// short by a new earliest deadline. Connections are closed at most this late
+/// after their deadline
+std::chrono::milliseconds idle_check_interval(
+    std::chrono::milliseconds idle_timeout) noexcept;
+
+/// Tracks connections which haven't had any traffic for too long. All of them
+/// share the same timeout, so keeping the entries in the order of their last
+/// activity keeps them ordered by deadline as well
+class IdleTimer final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Entry;
+    using Entries = std::list<Entry>;
+
+public:
+    /// Position of a tracked connection, empty once it's not tracked anymore
+    using Handle = std::optional<Entries::iterator>;
+
+private:
+    struct Entry {
+        uint64_t id;
+        Clock::time_point deadline;
+        Handle* owner;
+    };
+
+    Entries entries_;
+    Clock::duration timeout_;
+
+public:
+    /// Zero `timeout` disables tracking
+    explicit IdleTimer(Clock::duration timeout) noexcept : timeout_{timeout} {}
+
+    /// Start tracking the connection `id`. `handle` has to stay at the same
+    /// address for as long as it's tracked
+    void start(uint64_t id, Handle& handle);
+    /// Push the deadline back, as there was some traffic
+    void touch(Handle& handle) noexcept;
+    void stop(Handle& handle) noexcept;
+
+    /// Time left until the earliest deadline, empty if nothing is tracked
+    std::optional<Clock::duration> next_expiry() const noexcept;
+
+    /// Stop tracking every connection past its deadline, calling `f` with
+    /// its id
+    template <typename F>
+    void expire(F&& f) {
+        const Clock::time_point now = Clock::now();
+        while (!entries_.empty() && entries_.front().deadline <= now) {
+            const Entry entry = entries_.front();
+            entries_.pop_front();
+            entry.owner->reset();
+            f(entry.id);
+        }
+    }
+};
+}  // namespace waxwing::internal
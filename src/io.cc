@@ -1,12 +1,19 @@
 #include "waxwing/io.hh"
 
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <spdlog/spdlog.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <span>
 #include <string>
 #include <string_view>
 #include <system_error>
@@ -15,6 +22,12 @@
 #include "waxwing/result.hh"
 
 namespace waxwing::internal {
+namespace {
+std::string errno_message() {
+    return std::make_error_code(std::errc{errno}).message();
+}
+}  // namespace
+
 Connection::~Connection() { close(fd_); }
 
 Connection::Connection(Connection&& other) noexcept
@@ -26,33 +39,114 @@ Connection& Connection::operator=(Connection&& rhs) noexcept {
 }
 
 size_t Connection::recv(std::string& s, const size_t n) const {
-    std::vector<char> buffer(n);
+    // receive straight into the end of `s`
+    const size_t old_size = s.size();
+    s.resize(old_size + n);
 
-    const size_t bytes_read = ::recv(fd_, buffer.data(), n * sizeof(char), 0);
+    const IoResult received = try_recv(std::span{s}.subspan(old_size));
+    const size_t bytes_read = received ? *received : 0;
 
-    buffer.resize(bytes_read);
-    s.append(buffer.cbegin(), buffer.cend());
+    s.resize(old_size + bytes_read);
     return bytes_read;
 }
 
-size_t Connection::send(const std::span<char> s) const {
-    return ::send(fd_, s.data(), s.size(), 0);
+size_t Connection::send(const std::span<const char> s) const {
+    size_t sent = 0;
+    while (sent < s.size()) {
+        const IoResult result = try_send(s.subspan(sent));
+        if (!result) {
+            break;
+        }
+        sent += *result;
+    }
+    return sent;
+}
+
+IoResult Connection::try_recv(const std::span<char> buf,
+                              const bool nonblocking) const noexcept {
+    const int flags = nonblocking ? MSG_DONTWAIT : 0;
+    for (;;) {
+        const ssize_t received = ::recv(fd_, buf.data(), buf.size(), flags);
+        if (received >= 0) {
+            return static_cast<size_t>(received);
+        }
+        if (errno != EINTR) {
+            return Error{std::errc{errno}};
+        }
+    }
+}
+
+IoResult Connection::try_send(const std::span<const char> s) const noexcept {
+    for (;;) {
+        // peer closing the connection must not kill the process with SIGPIPE
+        const ssize_t sent = ::send(fd_, s.data(), s.size(), MSG_NOSIGNAL);
+        if (sent >= 0) {
+            return static_cast<size_t>(sent);
+        }
+        if (errno != EINTR) {
+            return Error{std::errc{errno}};
+        }
+    }
+}
+
+IoResult Connection::try_send(
+    const std::span<const iovec> buffers) const noexcept {
+    // `writev` can't suppress SIGPIPE
+    msghdr message{};
+    message.msg_iov = const_cast<iovec*>(buffers.data());
+    message.msg_iovlen = buffers.size();
+
+    for (;;) {
+        const ssize_t sent = ::sendmsg(fd_, &message, MSG_NOSIGNAL);
+        if (sent >= 0) {
+            return static_cast<size_t>(sent);
+        }
+        if (errno != EINTR) {
+            return Error{std::errc{errno}};
+        }
+    }
+}
+
+IoResult Connection::try_send_file(const int file_fd, const size_t offset,
+                                   const size_t length) const noexcept {
+    auto file_offset = static_cast<off_t>(offset);
+    for (;;) {
+        const ssize_t sent = ::sendfile(fd_, file_fd, &file_offset, length);
+        if (sent == 0 && length > 0) {
+            // the file was truncated after the response was built, there's
+            // no way to send as much as promised
+            return Error{std::errc::io_error};
+        }
+        if (sent >= 0) {
+            return static_cast<size_t>(sent);
+        }
+        if (errno != EINTR) {
+            return Error{std::errc{errno}};
+        }
+    }
 }
 
 bool Connection::is_valid() const noexcept { return fd_ >= 0; }
+int Connection::fd() const noexcept { return fd_; }
 
 Socket::~Socket() { close(fd_); }
 
 Result<Socket, std::string> Socket::create(const std::string_view address,
                                            const uint16_t port,
-                                           const int backlog) {
-    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                                           const int backlog,
+                                           const bool reuse_port) {
+    const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (fd < 0) {
-        return Error{std::make_error_code(std::errc{errno}).message()};
+        return Error{errno_message()};
     }
+    Socket socket{fd};
 
     const int option = 1;
     ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    if (reuse_port && ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &option,
+                                   sizeof(option)) < 0) {
+        return Error{errno_message()};
+    }
 
     sockaddr_in addr{.sin_family = AF_INET, .sin_port = ::htons(port)};
 
@@ -72,7 +166,7 @@ Result<Socket, std::string> Socket::create(const std::string_view address,
         return Error{std::make_error_code(std::errc{errno}).message()};
     }
 
-    return Socket{fd};
+    return socket;
 }
 
 Socket::Socket(Socket&& other) noexcept : fd_{std::exchange(other.fd_, -1)} {}
@@ -82,13 +176,102 @@ Socket& Socket::operator=(Socket&& rhs) noexcept {
     return *this;
 }
 
-Connection Socket::accept() const {
+Connection Socket::accept(const bool nonblocking) const {
     sockaddr_in clientaddr{};
     socklen_t clientaddr_len = sizeof(clientaddr);
 
-    const int result = ::accept(fd_, reinterpret_cast<sockaddr*>(&clientaddr),
-                                &clientaddr_len);
+    const int flags = SOCK_CLOEXEC | (nonblocking ? SOCK_NONBLOCK : 0);
+    const int result = ::accept4(
+        fd_, reinterpret_cast<sockaddr*>(&clientaddr), &clientaddr_len, flags);
 
     return Connection{result};
 }
+
+Result<void, std::string> Socket::set_nonblocking() const noexcept {
+    const int flags = ::fcntl(fd_, F_GETFL);
+    if (flags < 0 || ::fcntl(fd_, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return Error{errno_message()};
+    }
+    return {};
+}
+
+uint16_t Socket::port() const noexcept {
+    sockaddr_in addr{};
+    socklen_t addr_len = sizeof(addr);
+    if (::getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len) <
+        0) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+int Socket::fd() const noexcept { return fd_; }
+
+Reactor::~Reactor() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+Result<Reactor, std::string> Reactor::create() {
+    const int fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0) {
+        return Error{errno_message()};
+    }
+    return Reactor{fd};
+}
+
+Reactor::Reactor(Reactor&& other) noexcept
+    : fd_{std::exchange(other.fd_, -1)} {}
+
+Reactor& Reactor::operator=(Reactor&& rhs) noexcept {
+    std::swap(fd_, rhs.fd_);
+    return *this;
+}
+
+Result<void, std::string> Reactor::add(const int fd,
+                                       const uint64_t token) const noexcept {
+    // with edge triggering there's no need to toggle `EPOLLOUT` interest,
+    // it only fires once the socket becomes writable again
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = token;
+
+    if (::epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+        return Error{errno_message()};
+    }
+    return {};
+}
+
+void Reactor::remove(const int fd) const noexcept {
+    ::epoll_ctl(fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+Result<size_t, std::string> Reactor::wait(const std::span<Event> events,
+                                          const int timeout_ms) const noexcept {
+    constexpr size_t MAX_EVENTS = 256;
+    std::array<epoll_event, MAX_EVENTS> raw_events{};
+
+    const int max_events =
+        static_cast<int>(std::min(events.size(), raw_events.size()));
+    int ready = 0;
+    do {
+        ready = ::epoll_wait(fd_, raw_events.data(), max_events, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+
+    if (ready < 0) {
+        return Error{errno_message()};
+    }
+
+    for (int i = 0; i < ready; ++i) {
+        const uint32_t flags = raw_events[i].events;
+        events[i] = Event{
+            .token = raw_events[i].data.u64,
+            .readable = (flags & (EPOLLIN | EPOLLRDHUP)) != 0,
+            .writable = (flags & EPOLLOUT) != 0,
+            .failed = (flags & (EPOLLERR | EPOLLHUP)) != 0,
+        };
+    }
+    return static_cast<size_t>(ready);
+}
 }  // namespace waxwing::internal
@@ -0,0 +1,165 @@
+#include "output_buffer.hh"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+namespace waxwing::internal {
+namespace {
+template <typename... Fs>
+struct Overloaded : Fs... {
+    using Fs::operator()...;
+};
+
+template <typename Chunk>
+std::optional<std::string_view> chunk_data(const Chunk& chunk) noexcept {
+    return std::visit(
+        Overloaded{
+            [](const std::string& data) -> std::optional<std::string_view> {
+                return data;
+            },
+            [](const std::shared_ptr<const std::string>& data)
+                -> std::optional<std::string_view> { return *data; },
+            [](const std::string_view data)
+                -> std::optional<std::string_view> { return data; },
+            [](const FileRange&) -> std::optional<std::string_view> {
+                return std::nullopt;
+            },
+        },
+        chunk);
+}
+
+template <typename Chunk>
+size_t chunk_size(const Chunk& chunk) noexcept {
+    const FileRange* range = std::get_if<FileRange>(&chunk);
+    return range != nullptr ? range->length : chunk_data(chunk)->size();
+}
+}  // namespace
+
+void OutputBuffer::close_tail() noexcept {
+    if (tail_appendable_) {
+        closed_size_ += std::get<std::string>(chunks_.back()).size();
+        tail_appendable_ = false;
+    }
+}
+
+void OutputBuffer::append(const std::string_view data) {
+    if (data.empty()) {
+        return;
+    }
+    tail() += data;
+}
+
+std::string& OutputBuffer::tail() {
+    if (!tail_appendable_) {
+        chunks_.emplace_back(std::string{});
+        tail_appendable_ = true;
+    }
+    return std::get<std::string>(chunks_.back());
+}
+
+void OutputBuffer::append(std::string&& data) {
+    if (data.size() < SEPARATE_CHUNK_SIZE) {
+        append(std::string_view{data});
+        return;
+    }
+    close_tail();
+    closed_size_ += data.size();
+    chunks_.emplace_back(std::move(data));
+}
+
+void OutputBuffer::append(std::shared_ptr<const std::string> data) {
+    if (data == nullptr || data->size() < SEPARATE_CHUNK_SIZE) {
+        append(data == nullptr ? std::string_view{} : std::string_view{*data});
+        return;
+    }
+    close_tail();
+    closed_size_ += data->size();
+    chunks_.emplace_back(std::move(data));
+}
+
+void OutputBuffer::append_borrowed(const std::string_view data) {
+    if (data.size() < SEPARATE_CHUNK_SIZE) {
+        append(data);
+        return;
+    }
+    close_tail();
+    closed_size_ += data.size();
+    chunks_.emplace_back(std::in_place_type<std::string_view>, data);
+}
+
+void OutputBuffer::append(FileRange&& range) {
+    if (range.length == 0) {
+        return;
+    }
+    close_tail();
+    closed_size_ += range.length;
+    chunks_.emplace_back(std::move(range));
+}
+
+bool OutputBuffer::empty() const noexcept { return chunks_.empty(); }
+
+size_t OutputBuffer::size() const noexcept {
+    const size_t open_size =
+        tail_appendable_ ? std::get<std::string>(chunks_.back()).size() : 0;
+    return closed_size_ + open_size - offset_;
+}
+
+std::optional<FileRange> OutputBuffer::front_file() const noexcept {
+    if (chunks_.empty()) {
+        return std::nullopt;
+    }
+    const FileRange* range = std::get_if<FileRange>(&chunks_.front());
+    if (range == nullptr) {
+        return std::nullopt;
+    }
+    return FileRange{range->file, range->offset + offset_,
+                     range->length - offset_};
+}
+
+size_t OutputBuffer::gather(const std::span<iovec> iovecs) const noexcept {
+    const size_t limit = std::min(iovecs.size(), chunks_.size());
+    size_t count = 0;
+    for (; count < limit; ++count) {
+        const std::optional<std::string_view> data =
+            chunk_data(chunks_[count]);
+        if (!data.has_value()) {
+            break;
+        }
+
+        const size_t skip = count == 0 ? offset_ : 0;
+        // `iovec` is shared with writes, so it can't point to const data
+        iovecs[count] = iovec{
+            .iov_base = const_cast<char*>(data->data() + skip),
+            .iov_len = data->size() - skip,
+        };
+    }
+    return count;
+}
+
+void OutputBuffer::consume(size_t n) noexcept {
+    while (n > 0 && !chunks_.empty()) {
+        const size_t left = chunk_size(chunks_.front()) - offset_;
+        if (n < left) {
+            offset_ += n;
+            return;
+        }
+
+        n -= left;
+        offset_ = 0;
+        if (chunks_.size() == 1 && tail_appendable_) {
+            tail_appendable_ = false;
+        } else {
+            closed_size_ -= chunk_size(chunks_.front());
+        }
+        chunks_.pop_front();
+    }
+    if (chunks_.empty()) {
+        tail_appendable_ = false;
+    }
+}
+}  // namespace waxwing::internal
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "waxwing/file.hh"
+
+namespace waxwing::internal {
+/// Serialized responses waiting to be sent. Small pieces are copied one
+/// after another, while large ones keep their own buffers, so a big body is
+/// sent straight from the string it was built in with a gathered write.
+/// Shared and borrowed buffers are referred to the same way, so one payload
+/// can be written to many connections without a copy. File bodies are never
+/// read into memory, but sent with a separate call
+class OutputBuffer final {
+    using Chunk =
+        std::variant<std::string, std::shared_ptr<const std::string>,
+                     std::string_view, FileRange>;
+
+    std::deque<Chunk> chunks_;
+    // bytes of the first chunk that have already been sent
+    size_t offset_ = 0;
+    // whether small pieces may be appended to the last chunk
+    bool tail_appendable_ = false;
+    // bytes of the chunks before the one small pieces are appended to
+    size_t closed_size_ = 0;
+
+    /// Stop appending small pieces to the last chunk
+    void close_tail() noexcept;
+
+public:
+    /// Pieces at least this large are moved in instead of being copied
+    static constexpr size_t SEPARATE_CHUNK_SIZE = 4096;
+    /// Enough entries for a single gathered write to pass a header and a body
+    /// for each of a few dozen pipelined responses
+    static constexpr size_t MAX_IOVECS = 64;
+
+    void append(std::string_view data);
+    void append(std::string&& data);
+    void append(std::shared_ptr<const std::string> data);
+    /// Refer to `data` without copying it if it's large, so it has to stay
+    /// valid until it's sent
+    void append_borrowed(std::string_view data);
+    void append(FileRange&& range);
+    /// String the next small pieces are appended to, for serializing into
+    /// it directly. Valid until the buffer is modified otherwise
+    std::string& tail();
+
+    bool empty() const noexcept;
+    /// Unsent bytes, including the ones of files
+    size_t size() const noexcept;
+
+    /// Unsent part of the file at the beginning of the buffer, if it starts
+    /// with one
+    std::optional<FileRange> front_file() const noexcept;
+
+    /// Point `iovecs` at the unsent data in memory up to the next file,
+    /// returning the number of filled entries. They stay valid until the
+    /// buffer is modified
+    size_t gather(std::span<iovec> iovecs) const noexcept;
+    /// Drop first `n` unsent bytes
+    void consume(size_t n) noexcept;
+};
+}  // namespace waxwing::internal
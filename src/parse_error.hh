@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+#include "waxwing/http.hh"
+
+namespace waxwing::internal {
+/// Reason a request was rejected, along with the status to answer with
+struct ParseError {
+    HttpStatusCode status;
+    std::string message;
+};
+}  // namespace waxwing::internal
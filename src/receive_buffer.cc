@@ -0,0 +1,99 @@
+#include "receive_buffer.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace waxwing::internal {
+ReceiveBuffer::ReceiveBuffer(const size_t capacity)
+    : data_{std::make_unique_for_overwrite<char[]>(capacity)},
+      capacity_{capacity} {}
+
+ReceiveBuffer::ReceiveBuffer(ReceiveBuffer&& other) noexcept
+    : data_{std::move(other.data_)},
+      capacity_{std::exchange(other.capacity_, 0)},
+      begin_{std::exchange(other.begin_, 0)},
+      end_{std::exchange(other.end_, 0)} {}
+
+ReceiveBuffer& ReceiveBuffer::operator=(ReceiveBuffer&& rhs) noexcept {
+    data_ = std::move(rhs.data_);
+    capacity_ = std::exchange(rhs.capacity_, 0);
+    begin_ = std::exchange(rhs.begin_, 0);
+    end_ = std::exchange(rhs.end_, 0);
+    return *this;
+}
+
+bool ReceiveBuffer::has_storage() const noexcept { return data_ != nullptr; }
+size_t ReceiveBuffer::capacity() const noexcept { return capacity_; }
+
+std::string_view ReceiveBuffer::data() const noexcept {
+    return {data_.get() + begin_, end_ - begin_};
+}
+
+bool ReceiveBuffer::empty() const noexcept { return begin_ == end_; }
+
+void ReceiveBuffer::reserve(const size_t free_space) {
+    const size_t size = end_ - begin_;
+    if (capacity_ - size >= free_space) {
+        // enough space once the processed data is dropped
+        std::memmove(data_.get(), data_.get() + begin_, size);
+    } else {
+        const size_t capacity = std::max(capacity_ * 2, size + free_space);
+        auto data = std::make_unique_for_overwrite<char[]>(capacity);
+        if (size > 0) {
+            std::memcpy(data.get(), data_.get() + begin_, size);
+        }
+        data_ = std::move(data);
+        capacity_ = capacity;
+    }
+    begin_ = 0;
+    end_ = size;
+}
+
+std::span<char> ReceiveBuffer::prepare(const size_t min_size) {
+    if (capacity_ - end_ < min_size) {
+        reserve(min_size);
+    }
+    return {data_.get() + end_, capacity_ - end_};
+}
+
+void ReceiveBuffer::commit(const size_t n) noexcept { end_ += n; }
+
+void ReceiveBuffer::append(const std::string_view data) {
+    const std::span<char> space = prepare(data.size());
+    std::copy(data.begin(), data.end(), space.begin());
+    commit(data.size());
+}
+
+void ReceiveBuffer::consume(const size_t n) noexcept {
+    begin_ += n;
+    if (begin_ == end_) {
+        begin_ = 0;
+        end_ = 0;
+    }
+}
+
+ReceiveBufferPool& ReceiveBufferPool::local() noexcept {
+    thread_local ReceiveBufferPool pool;
+    return pool;
+}
+
+ReceiveBuffer ReceiveBufferPool::acquire() {
+    if (free_.empty()) {
+        return ReceiveBuffer{BUFFER_SIZE};
+    }
+    ReceiveBuffer buffer = std::move(free_.back());
+    free_.pop_back();
+    return buffer;
+}
+
+void ReceiveBufferPool::release(ReceiveBuffer buffer) noexcept {
+    if (!buffer.has_storage() || buffer.capacity() > MAX_POOLED_CAPACITY ||
+        free_.size() >= MAX_POOLED_BUFFERS) {
+        return;
+    }
+    buffer.consume(buffer.data().size());
+    // `free_` never grows past the reserved size, so this can't throw
+    free_.push_back(std::move(buffer));
+}
+}  // namespace waxwing::internal
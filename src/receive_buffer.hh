@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace waxwing::internal {
+/// Growable buffer that data is received into directly. The received but not
+/// yet processed data is kept at the beginning of the buffer, and the free
+/// space after it is handed out for the next receive
+class ReceiveBuffer final {
+    std::unique_ptr<char[]> data_;
+    size_t capacity_ = 0;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+
+    void reserve(size_t free_space);
+
+public:
+    ReceiveBuffer() = default;
+    explicit ReceiveBuffer(size_t capacity);
+
+    ReceiveBuffer(ReceiveBuffer&& other) noexcept;
+    ReceiveBuffer& operator=(ReceiveBuffer&& rhs) noexcept;
+
+    /// Whether there is an allocated storage at all
+    bool has_storage() const noexcept;
+    size_t capacity() const noexcept;
+
+    /// Received data that is not processed yet
+    std::string_view data() const noexcept;
+    bool empty() const noexcept;
+
+    /// Free space after the data, at least `min_size` bytes large
+    std::span<char> prepare(size_t min_size);
+    /// Mark `n` bytes of the prepared space as received
+    void commit(size_t n) noexcept;
+    void append(std::string_view data);
+
+    /// Drop `n` bytes from the beginning of the data
+    void consume(size_t n) noexcept;
+};
+
+/// Receive buffers that aren't used by any connection. Connections take a
+/// buffer only while they have unprocessed data, so idle ones don't pin any
+/// memory
+class ReceiveBufferPool final {
+    std::vector<ReceiveBuffer> free_;
+
+public:
+    static constexpr size_t BUFFER_SIZE = 16384;
+    /// Buffers which grew larger than this are freed instead of being kept
+    static constexpr size_t MAX_POOLED_CAPACITY = 4 * BUFFER_SIZE;
+    static constexpr size_t MAX_POOLED_BUFFERS = 256;
+
+    /// Pool of the calling thread. Every serving mode processes a connection
+    /// on a single thread, so no locking is needed
+    static ReceiveBufferPool& local() noexcept;
+
+    ReceiveBufferPool() { free_.reserve(MAX_POOLED_BUFFERS); }
+
+    ReceiveBuffer acquire();
+    void release(ReceiveBuffer buffer) noexcept;
+};
+}  // namespace waxwing::internal
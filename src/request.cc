@@ -1,12 +1,64 @@
 #include "waxwing/request.hh"
 
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "waxwing/str_util.hh"
+
 namespace waxwing {
-Request::Request(HttpMethod method, std::string&& target, Headers&& headers,
-                 std::string&& body)
+Request::Request(const HttpMethod method, const std::string_view target,
+                 const std::span<const HeaderField> headers,
+                 const std::string_view body,
+                 const std::span<const HeaderField> trailers) noexcept
     : method_{method},
-      target_{std::move(target)},
-      headers_{std::move(headers)},
-      body_{std::move(body)} {}
+      target_{target},
+      headers_{headers},
+      body_{body},
+      trailers_{trailers} {}
+
+Request Request::owned(const HttpMethod method, const std::string_view target,
+                       const std::span<const HeaderField> headers,
+                       const std::string_view body,
+                       const std::span<const HeaderField> trailers) {
+    auto storage = std::make_unique<Storage>();
+    size_t size = target.size() + body.size();
+    for (const HeaderField& field : headers) {
+        size += field.name.size() + field.value.size();
+    }
+    for (const HeaderField& field : trailers) {
+        size += field.name.size() + field.value.size();
+    }
+    // every part is appended without reallocating, so the views stay valid
+    storage->data.reserve(size);
+    storage->headers.reserve(headers.size());
+    storage->trailers.reserve(trailers.size());
+
+    const auto append = [&data = storage->data](const std::string_view part) {
+        const size_t offset = data.size();
+        data += part;
+        return std::string_view{data}.substr(offset, part.size());
+    };
+
+    const std::string_view owned_target = append(target);
+    for (const HeaderField& field : headers) {
+        const std::string_view name = append(field.name);
+        storage->headers.push_back(HeaderField{name, append(field.value)});
+    }
+    const std::string_view owned_body = append(body);
+    for (const HeaderField& field : trailers) {
+        const std::string_view name = append(field.name);
+        storage->trailers.push_back(HeaderField{name, append(field.value)});
+    }
+
+    Request request{method, owned_target, storage->headers, owned_body,
+                    storage->trailers};
+    request.storage_ = std::move(storage);
+    return request;
+}
 
 std::string_view Request::body() const noexcept { return body_; }
 std::string_view Request::target() const noexcept { return target_; }
@@ -14,10 +66,31 @@ HttpMethod Request::method() const noexcept { return method_; }
 
 std::optional<std::string_view> Request::header(
     const std::string_view key) const noexcept {
-    return headers_.get(key);
+    for (const HeaderField& field : headers_) {
+        if (str_util::case_insensitive_eq(field.name, key)) {
+            return field.value;
+        }
+    }
+    return std::nullopt;
+}
+
+std::span<const HeaderField> Request::headers() const noexcept {
+    return headers_;
+}
+
+std::span<const HeaderField> Request::trailers() const noexcept {
+    return trailers_;
+}
+
+Request Request::to_owned() const {
+    return owned(method_, target_, headers_, body_, trailers_);
 }
 
 Request RequestBuilder::build() && {
-    return {method_, std::move(target_), std::move(headers_), std::move(body_)};
+    std::vector<HeaderField> fields;
+    for (const auto& [name, value] : headers_) {
+        fields.push_back(HeaderField{name, value});
+    }
+    return Request::owned(method_, target_, fields, body_);
 }
 }  // namespace waxwing
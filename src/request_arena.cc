@@ -0,0 +1,49 @@
+#include "request_arena.hh"
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+#include "waxwing/http.hh"
+
+namespace waxwing {
+namespace {
+thread_local std::pmr::memory_resource* current_memory = nullptr;
+}  // namespace
+
+std::pmr::memory_resource* request_memory() noexcept {
+    return current_memory != nullptr ? current_memory
+                                     : std::pmr::get_default_resource();
+}
+
+namespace internal {
+
+RequestArena::RequestArena(const size_t size,
+                           std::pmr::memory_resource* const upstream)
+    : buffer_{std::make_unique_for_overwrite<std::byte[]>(size)},
+      resource_{buffer_.get(), size, upstream} {}
+
+RequestArena& RequestArena::local() noexcept {
+    thread_local RequestArena arena;
+    return arena;
+}
+
+RequestArena::Scope::Scope(RequestArena& arena) noexcept
+    : arena_{current_memory == nullptr ? &arena : nullptr} {
+    if (arena_ != nullptr) {
+        current_memory = &arena_->resource_;
+    }
+}
+
+RequestArena::Scope::~Scope() {
+    if (arena_ != nullptr) {
+        current_memory = nullptr;
+        // starts over from the initial buffer
+        if (arena_->resource_.used) {
+            arena_->resource_.release();
+            arena_->resource_.used = false;
+        }
+    }
+}
+}  // namespace internal
+}  // namespace waxwing
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+namespace waxwing::internal {
+/// Memory of a single request, handed out as the `request_memory` to the
+/// handlers that ask for it, and released at once when the request is done.
+/// Allocating is only a pointer bump, and as long as a request fits into
+/// the initial buffer the global allocator isn't involved at all, so worker
+/// threads don't contend for it
+class RequestArena final {
+    /// Remembers whether anything was allocated, so a request that didn't
+    /// use the arena doesn't have to release it
+    class Resource final : public std::pmr::monotonic_buffer_resource {
+    public:
+        using monotonic_buffer_resource::monotonic_buffer_resource;
+
+        bool used = false;
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            used = true;
+            return monotonic_buffer_resource::do_allocate(bytes, alignment);
+        }
+    };
+
+    std::unique_ptr<std::byte[]> buffer_;
+    Resource resource_;
+
+public:
+    /// Enough for the headers of a typical response several times over
+    static constexpr size_t DEFAULT_SIZE = 16 * 1024;
+
+    /// Larger requests take more memory from `upstream`, which is given
+    /// back when they're done
+    explicit RequestArena(size_t size = DEFAULT_SIZE,
+                          std::pmr::memory_resource* upstream =
+                              std::pmr::new_delete_resource());
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    /// Arena of the calling thread. Every serving mode handles a request on
+    /// a single thread, so no locking is needed
+    static RequestArena& local() noexcept;
+
+    /// Makes the arena the request memory of the calling thread while it
+    /// lives, and releases everything allocated from it afterwards. A nested
+    /// scope leaves the outer one in charge
+    class Scope final {
+        RequestArena* arena_;
+
+    public:
+        explicit Scope(RequestArena& arena) noexcept;
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+};
+}  // namespace waxwing::internal
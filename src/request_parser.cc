@@ -0,0 +1,482 @@
+#include "request_parser.hh"
+
+#include <fmt/core.h>
+
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "char_scan.hh"
+#include "chunked_decoder.hh"
+#include "waxwing/http.hh"
+#include "waxwing/result.hh"
+#include "waxwing/str_split.hh"
+#include "waxwing/str_util.hh"
+
+namespace waxwing::internal {
+namespace {
+constexpr size_t MAX_RETAINED_BODY_CAPACITY = 64 * 1024;
+
+bool is_whitespace(const char c) noexcept { return c == ' ' || c == '\t'; }
+bool is_digit(const char c) noexcept { return '0' <= c && c <= '9'; }
+
+/// Position of the first character from `from` that doesn't satisfy `pred`
+template <typename Pred>
+size_t scan(const std::string_view data, size_t from, Pred pred) noexcept {
+    while (from < data.size() && pred(data[from])) {
+        ++from;
+    }
+    return from;
+}
+
+Error<ParseError> bad_request(std::string message) {
+    return Error{
+        ParseError{HttpStatusCode::BadRequest_400, std::move(message)}};
+}
+
+std::optional<size_t> parse_content_length(const std::string_view raw) {
+    size_t content_length = 0;
+    const auto [end, error] =
+        std::from_chars(raw.begin(), raw.end(), content_length);
+    if (raw.empty() || error != std::errc{} || end != raw.end()) {
+        return std::nullopt;
+    }
+    return content_length;
+}
+}  // namespace
+
+Result<ParseStatus, ParseError> RequestParser::parse(
+    const std::string_view message) {
+    size_t pos = position_;
+
+    while (state_ != State::Body && pos < message.size()) {
+        switch (state_) {
+            case State::RequestLineStart:
+                // empty lines before a request are ignored for robustness,
+                // some clients send them after a body
+                pos = scan(message, pos,
+                           [](const char c) { return c == '\r' || c == '\n'; });
+                // the rest of the empty lines may come with the next part
+                if (pos == message.size()) {
+                    break;
+                }
+                token_start_ = pos;
+                state_ = State::Method;
+                break;
+
+            case State::Method: {
+                pos = char_scan::token(message, pos);
+                if (pos == message.size()) {
+                    break;
+                }
+                if (message[pos] != ' ' || pos == token_start_) {
+                    return bad_request("malformed request method");
+                }
+                const std::string_view raw_method =
+                    message.substr(token_start_, pos - token_start_);
+                const std::optional<HttpMethod> method =
+                    parse_method(raw_method);
+                if (!method.has_value()) {
+                    return Error{ParseError{
+                        HttpStatusCode::NotImplemented_501,
+                        fmt::format("unknown method `{}`", raw_method)}};
+                }
+                method_ = *method;
+                token_start_ = ++pos;
+                state_ = State::Target;
+                break;
+            }
+
+            case State::Target:
+                pos = char_scan::visible(message, pos);
+                if (pos == message.size()) {
+                    break;
+                }
+                if (message[pos] != ' ' || pos == token_start_) {
+                    return bad_request("malformed request target");
+                }
+                target_ = Span{token_start_, pos - token_start_};
+                token_start_ = ++pos;
+                state_ = State::Version;
+                break;
+
+            case State::Version: {
+                pos = char_scan::visible(message, pos);
+                if (pos == message.size()) {
+                    break;
+                }
+                Result<void, ParseError> finished =
+                    finish_request_line(message.substr(0, pos));
+                if (!finished) {
+                    return Error{std::move(finished.error())};
+                }
+                if (message[pos] == '\r') {
+                    state_ = State::RequestLineEnd;
+                    ++pos;
+                } else if (message[pos] == '\n') {
+                    state_ = State::HeaderStart;
+                    headers_start_ = ++pos;
+                } else {
+                    return bad_request("malformed HTTP version");
+                }
+                break;
+            }
+
+            case State::RequestLineEnd:
+                if (message[pos] != '\n') {
+                    return bad_request("expected a line feed");
+                }
+                state_ = State::HeaderStart;
+                headers_start_ = ++pos;
+                break;
+
+            case State::HeaderStart:
+                if (message[pos] == '\r') {
+                    state_ = State::HeadersEnd;
+                    ++pos;
+                } else if (message[pos] == '\n') {
+                    Result<void, ParseError> finished =
+                        finish_headers(message, pos);
+                    if (!finished) {
+                        return Error{std::move(finished.error())};
+                    }
+                    body_start_ = ++pos;
+                } else if (is_whitespace(message[pos])) {
+                    return bad_request("folded header lines are obsolete");
+                } else {
+                    token_start_ = pos;
+                    state_ = State::HeaderName;
+                }
+                break;
+
+            case State::HeaderName:
+                pos = char_scan::token(message, pos);
+                if (pos == message.size()) {
+                    break;
+                }
+                if (message[pos] != ':' || pos == token_start_) {
+                    return bad_request("malformed header name");
+                }
+                header_name_ = Span{token_start_, pos - token_start_};
+                ++pos;
+                state_ = State::HeaderValueStart;
+                break;
+
+            case State::HeaderValueStart:
+                pos = scan(message, pos, is_whitespace);
+                token_start_ = pos;
+                if (pos < message.size()) {
+                    state_ = State::HeaderValue;
+                }
+                break;
+
+            case State::HeaderValue: {
+                pos = char_scan::value(message, pos);
+                if (pos == message.size()) {
+                    break;
+                }
+
+                Result<void, ParseError> finished = finish_header(message, pos);
+                if (!finished) {
+                    return Error{std::move(finished.error())};
+                }
+                if (message[pos] == '\r') {
+                    state_ = State::HeaderLineEnd;
+                } else if (message[pos] == '\n') {
+                    state_ = State::HeaderStart;
+                } else {
+                    return bad_request("control character in a header value");
+                }
+                ++pos;
+                break;
+            }
+
+            case State::HeaderLineEnd:
+                if (message[pos] != '\n') {
+                    return bad_request("expected a line feed");
+                }
+                state_ = State::HeaderStart;
+                ++pos;
+                break;
+
+            case State::HeadersEnd: {
+                if (message[pos] != '\n') {
+                    return bad_request("expected a line feed");
+                }
+                Result<void, ParseError> finished =
+                    finish_headers(message, pos);
+                if (!finished) {
+                    return Error{std::move(finished.error())};
+                }
+                body_start_ = ++pos;
+                break;
+            }
+
+            case State::Body:
+                break;
+        }
+    }
+    position_ = pos;
+
+    if (state_ != State::Body) {
+        // the limits have to hold even before the head is complete, so an
+        // endless one is not buffered forever
+        Result<void, ParseError> checked = check_limits();
+        if (!checked) {
+            return Error{std::move(checked.error())};
+        }
+        return ParseStatus::NeedMore;
+    }
+
+    if (!body_allowed_) {
+        return ParseStatus::NeedMore;
+    }
+    if (chunked_) {
+        return parse_chunked(message);
+    }
+    if (message.size() - body_start_ < content_length_) {
+        position_ = message.size();
+        return ParseStatus::NeedMore;
+    }
+    position_ = body_start_ + content_length_;
+    return ParseStatus::Complete;
+}
+
+Result<ParseStatus, ParseError> RequestParser::parse_chunked(
+    const std::string_view message) {
+    while (position_ < message.size()) {
+        Result<ChunkedDecoder::Decoded, ParseError> decoded =
+            decoder_.decode(message.substr(position_));
+        if (!decoded) {
+            return Error{std::move(decoded.error())};
+        }
+        position_ += decoded->consumed;
+        body_data_ += decoded->data;
+        if (decoded->done) {
+            return ParseStatus::Complete;
+        }
+    }
+    return ParseStatus::NeedMore;
+}
+
+Result<void, ParseError> RequestParser::finish_request_line(
+    const std::string_view message) {
+    position_ = message.size();
+    Result<void, ParseError> checked = check_limits();
+    if (!checked) {
+        return checked;
+    }
+
+    const std::string_view version = message.substr(token_start_);
+    // the major and the minor version are a single digit each
+    if (version.size() != 8 || !version.starts_with("HTTP/") ||
+        !is_digit(version[5]) || version[6] != '.' || !is_digit(version[7])) {
+        return bad_request(fmt::format("malformed HTTP version `{}`", version));
+    }
+    if (!version.starts_with("HTTP/1.")) {
+        return Error{ParseError{HttpStatusCode::HTTPVersionNotSupported_505,
+                                fmt::format("unsupported version `{}`",
+                                            version)}};
+    }
+    http_1_0_ = version == "HTTP/1.0";
+    return {};
+}
+
+Result<void, ParseError> RequestParser::finish_header(
+    const std::string_view message, size_t value_end) {
+    // trailing whitespace is not a part of the value
+    while (value_end > token_start_ && is_whitespace(message[value_end - 1])) {
+        --value_end;
+    }
+    headers_.push_back(
+        Header{header_name_, Span{token_start_, value_end - token_start_}});
+
+    if (headers_.size() > config_.max_header_count) {
+        return Error{ParseError{HttpStatusCode::RequestHeaderFieldsTooLarge_431,
+                                "too many header fields"}};
+    }
+    return {};
+}
+
+Result<void, ParseError> RequestParser::finish_headers(
+    const std::string_view message, const size_t end) {
+    position_ = end;
+    Result<void, ParseError> checked = check_limits();
+    if (!checked) {
+        return checked;
+    }
+    state_ = State::Body;
+
+    std::optional<size_t> content_length;
+    for (const Header& header : headers_) {
+        const std::string_view name = header.name.in(message);
+        if (str_util::case_insensitive_eq(name, "transfer-encoding")) {
+            Result<void, ParseError> coding =
+                add_transfer_coding(header.value.in(message));
+            if (!coding) {
+                return coding;
+            }
+            continue;
+        }
+        if (!str_util::case_insensitive_eq(name, "content-length")) {
+            continue;
+        }
+
+        const std::optional<size_t> parsed =
+            parse_content_length(header.value.in(message));
+        // repeated lengths are fine as long as they agree
+        if (!parsed.has_value() ||
+            (content_length.has_value() && *content_length != *parsed)) {
+            return bad_request(fmt::format("invalid `Content-Length`: `{}`",
+                                           header.value.in(message)));
+        }
+        content_length = parsed;
+    }
+    if (chunked_ && content_length.has_value()) {
+        // the message could be framed either way, which is how requests are
+        // smuggled past proxies
+        return bad_request("both `Content-Length` and `Transfer-Encoding`");
+    }
+    content_length_ = content_length.value_or(0);
+    body_allowed_ = !chunked_ && content_length_ == 0;
+    return {};
+}
+
+Result<void, ParseError> RequestParser::add_transfer_coding(
+    const std::string_view value) {
+    if (http_1_0_) {
+        return bad_request("transfer codings aren't a part of HTTP/1.0");
+    }
+
+    auto codings = str_util::split(value, ',');
+    for (std::optional<std::string_view> coding = codings.next();
+         coding.has_value(); coding = codings.next()) {
+        const std::string_view trimmed = str_util::trim(*coding);
+        if (trimmed.empty()) {
+            continue;
+        }
+        // chunked has to be the last coding and applied only once
+        if (chunked_) {
+            return bad_request("chunked isn't the final transfer coding");
+        }
+        if (!str_util::case_insensitive_eq(trimmed, "chunked")) {
+            return Error{ParseError{
+                HttpStatusCode::NotImplemented_501,
+                fmt::format("unsupported transfer coding `{}`", trimmed)}};
+        }
+        chunked_ = true;
+    }
+    return {};
+}
+
+Result<void, ParseError> RequestParser::allow_body(const size_t max_size) {
+    if (body_allowed_) {
+        return {};
+    }
+    if (max_size != 0 && content_length_ > max_size) {
+        return Error{ParseError{HttpStatusCode::ContentTooLarge_413,
+                                fmt::format("body of {} bytes exceeds {} bytes",
+                                            content_length_, max_size)}};
+    }
+    decoder_.reset(max_size);
+    body_allowed_ = true;
+    return {};
+}
+
+Result<void, ParseError> RequestParser::check_limits() const {
+    switch (state_) {
+        case State::RequestLineStart:
+        case State::Method:
+        case State::Target:
+        case State::Version:
+        case State::RequestLineEnd:
+            if (position_ > config_.max_request_line_size) {
+                return Error{ParseError{HttpStatusCode::URITooLong_414,
+                                        "request line is too long"}};
+            }
+            return {};
+        case State::HeaderStart:
+        case State::HeaderName:
+        case State::HeaderValueStart:
+        case State::HeaderValue:
+        case State::HeaderLineEnd:
+        case State::HeadersEnd:
+            if (position_ - headers_start_ > config_.max_headers_size) {
+                return Error{
+                    ParseError{HttpStatusCode::RequestHeaderFieldsTooLarge_431,
+                               "header fields are too large"}};
+            }
+            return {};
+        case State::Body:
+            return {};
+    }
+    __builtin_unreachable();
+}
+
+void RequestParser::reset() noexcept {
+    state_ = State::RequestLineStart;
+    position_ = 0;
+    token_start_ = 0;
+    headers_start_ = 0;
+    target_ = {};
+    http_1_0_ = false;
+    headers_.clear();
+    body_start_ = 0;
+    content_length_ = 0;
+    body_allowed_ = false;
+    chunked_ = false;
+    // a large body isn't worth keeping around for the next one
+    if (body_data_.capacity() > MAX_RETAINED_BODY_CAPACITY) {
+        body_data_ = std::string{};
+    } else {
+        body_data_.clear();
+    }
+}
+
+bool RequestParser::head_complete() const noexcept {
+    return state_ == State::Body;
+}
+
+HttpMethod RequestParser::method() const noexcept { return method_; }
+RequestParser::Span RequestParser::target() const noexcept { return target_; }
+bool RequestParser::http_1_0() const noexcept { return http_1_0_; }
+
+const std::vector<RequestParser::Header>& RequestParser::headers()
+    const noexcept {
+    return headers_;
+}
+
+bool RequestParser::chunked() const noexcept { return chunked_; }
+
+size_t RequestParser::content_length() const noexcept {
+    return content_length_;
+}
+
+size_t RequestParser::body_start() const noexcept { return body_start_; }
+
+std::string_view RequestParser::body(
+    const std::string_view message) const noexcept {
+    if (chunked_) {
+        return body_data_;
+    }
+    return message.substr(body_start_, content_length_);
+}
+
+std::span<const HeaderField> RequestParser::trailers() const noexcept {
+    if (!chunked_) {
+        return {};
+    }
+    return decoder_.trailers();
+}
+
+size_t RequestParser::length() const noexcept {
+    if (chunked_) {
+        return position_;
+    }
+    return body_start_ + content_length_;
+}
+}  // namespace waxwing::internal
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chunked_decoder.hh"
+#include "parse_error.hh"
+#include "waxwing/config.hh"
+#include "waxwing/http.hh"
+#include "waxwing/request.hh"
+#include "waxwing/result.hh"
+
+namespace waxwing::internal {
+enum class ParseStatus {
+    NeedMore,
+    Complete,
+};
+
+/// Incremental HTTP/1.x request parser. It's fed the beginning of a message
+/// over and over as more of it arrives, and resumes where it stopped, so no
+/// byte is scanned twice however the message was split. Parsed parts are
+/// kept as positions in the message, which stay valid while the caller keeps
+/// the message around
+class RequestParser final {
+public:
+    /// Part of the message
+    struct Span {
+        size_t offset = 0;
+        size_t length = 0;
+
+        std::string_view in(const std::string_view message) const noexcept {
+            return message.substr(offset, length);
+        }
+    };
+
+    struct Header {
+        Span name;
+        Span value;
+    };
+
+private:
+    enum class State {
+        RequestLineStart,
+        Method,
+        Target,
+        Version,
+        RequestLineEnd,
+        HeaderStart,
+        HeaderName,
+        HeaderValueStart,
+        HeaderValue,
+        HeaderLineEnd,
+        HeadersEnd,
+        Body,
+    };
+
+    const ServerConfig& config_;
+
+    State state_ = State::RequestLineStart;
+    // bytes of the message scanned so far
+    size_t position_ = 0;
+    // start of the token being scanned
+    size_t token_start_ = 0;
+    size_t headers_start_ = 0;
+
+    HttpMethod method_ = HttpMethod::Get;
+    Span target_;
+    bool http_1_0_ = false;
+    std::vector<Header> headers_;
+    Span header_name_;
+    size_t body_start_ = 0;
+    size_t content_length_ = 0;
+    // bodies aren't parsed before the caller decides on their limit
+    bool body_allowed_ = false;
+    bool chunked_ = false;
+    ChunkedDecoder decoder_;
+    // decoded chunked body, which can't refer to the message
+    std::string body_data_;
+
+    Result<void, ParseError> finish_request_line(std::string_view message);
+    Result<void, ParseError> finish_header(std::string_view message,
+                                           size_t value_end);
+    Result<void, ParseError> finish_headers(std::string_view message,
+                                            size_t end);
+    Result<void, ParseError> add_transfer_coding(std::string_view value);
+    Result<void, ParseError> check_limits() const;
+    Result<ParseStatus, ParseError> parse_chunked(std::string_view message);
+
+public:
+    explicit RequestParser(const ServerConfig& config) noexcept
+        : config_{config}, decoder_{config} {}
+
+    /// Continue parsing `message`, which has to start with the same bytes
+    /// as on the previous call
+    Result<ParseStatus, ParseError> parse(std::string_view message);
+    /// Forget the parsed message, to parse the next one
+    void reset() noexcept;
+
+    /// Let the parsing go on with the body, of at most `max_size` bytes.
+    /// Parsing stops after the head of a request with a body until this is
+    /// called, so the caller gets to pick the limit or refuse the body first.
+    /// Has no effect once the body is allowed
+    Result<void, ParseError> allow_body(size_t max_size);
+
+    /// Whether everything but the body has been parsed, the accessors below
+    /// except for `body`, `trailers` and `length` are valid from then on
+    bool head_complete() const noexcept;
+
+    // valid once the parsing is complete
+    HttpMethod method() const noexcept;
+    Span target() const noexcept;
+    bool http_1_0() const noexcept;
+    const std::vector<Header>& headers() const noexcept;
+    /// Whether the body has the chunked transfer coding, so its length
+    /// isn't known in advance
+    bool chunked() const noexcept;
+    /// Declared length of a body without a transfer coding
+    size_t content_length() const noexcept;
+    /// Position of the body in the message
+    size_t body_start() const noexcept;
+    /// Body of the message, decoded if it's chunked
+    std::string_view body(std::string_view message) const noexcept;
+    /// Trailer fields of a chunked body
+    std::span<const HeaderField> trailers() const noexcept;
+    /// Length of the whole message
+    size_t length() const noexcept;
+};
+}  // namespace waxwing::internal
@@ -2,15 +2,90 @@
 
 #include <sys/socket.h>
 
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "serializer.hh"
+#include "waxwing/str_util.hh"
+
 namespace waxwing {
 HttpStatusCode Response::status() const noexcept { return status_code_; }
 Headers& Response::headers() & noexcept { return headers_; }
 std::optional<std::string_view> Response::body() const noexcept {
     return body_;
 }
+std::optional<std::string> Response::take_body() noexcept {
+    return std::exchange(body_, std::nullopt);
+}
+std::vector<BodySegment> Response::take_segments() noexcept {
+    return std::exchange(segments_, {});
+}
+std::optional<FileRange> Response::take_file_body() noexcept {
+    return std::exchange(file_body_, std::nullopt);
+}
+std::optional<ProducedBody> Response::take_produced_body() noexcept {
+    return std::exchange(produced_body_, std::nullopt);
+}
+
+PreparedResponse::PreparedResponse(Response&& resp)
+    : status_{resp.status()} {
+    if (resp.take_file_body().has_value() ||
+        resp.take_produced_body().has_value()) {
+        throw std::invalid_argument{
+            "only bodies held in memory can be prepared"};
+    }
+
+    std::string body = resp.take_body().value_or(std::string{});
+    for (BodySegment& segment : resp.take_segments()) {
+        if (const SharedBody* shared = std::get_if<SharedBody>(&segment)) {
+            if (*shared != nullptr) {
+                body += **shared;
+            }
+        } else if (const std::string* owned =
+                       std::get_if<std::string>(&segment)) {
+            body += *owned;
+        } else {
+            body += std::get<std::string_view>(segment);
+        }
+    }
+
+    // whether the connection is kept is decided for every request, so the
+    // header is left out and added when it's needed
+    Headers headers;
+    closes_ = false;
+    for (const auto& [key, value] : resp.headers()) {
+        if (str_util::case_insensitive_eq(key, "connection")) {
+            closes_ = internal::has_connection_option(value, "close");
+        } else {
+            headers.insert(key, value);
+        }
+    }
+    adds_date_ = !headers.contains("date");
+
+    internal::HeadFields fields{.date = false};
+    if (internal::may_have_body(status_)) {
+        fields.content_length = body.size();
+    }
+    std::string head;
+    internal::serialize_head(head, status_, headers, fields);
+    head_ = std::make_shared<const std::string>(std::move(head));
+    tail_ = std::make_shared<const std::string>("\r\n" + body);
+}
+
+HttpStatusCode PreparedResponse::status() const noexcept { return status_; }
+const SharedBody& PreparedResponse::head() const noexcept { return head_; }
+const SharedBody& PreparedResponse::tail() const noexcept { return tail_; }
+bool PreparedResponse::closes() const noexcept { return closes_; }
+bool PreparedResponse::adds_date() const noexcept { return adds_date_; }
 
 Response ResponseBuilder::build() && {
-    return {status_code_, std::move(headers_), std::move(body_)};
+    return {status_code_, std::move(headers_), std::move(body_),
+            std::move(segments_), std::move(file_body_),
+            std::move(produced_body_)};
 }
 
 }  // namespace waxwing
@@ -3,12 +3,60 @@
 #include <fmt/core.h>
 
 #include <algorithm>
-#include <cassert>
+#include <array>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace waxwing::internal {
 namespace {
+constexpr std::array ALL_METHODS = {
+    HttpMethod::Get,     HttpMethod::Head,    HttpMethod::Post,
+    HttpMethod::Put,     HttpMethod::Delete,  HttpMethod::Connect,
+    HttpMethod::Options, HttpMethod::Trace,   HttpMethod::Patch,
+};
+
+static_assert(ALL_METHODS.size() == METHOD_COUNT);
+
+// in the order of `ALL_METHODS`, the same as `format_method` gives
+constexpr std::array<std::string_view, METHOD_COUNT> METHOD_NAMES = {
+    "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE",
+    "PATCH",
+};
+
+/// `Allow` value of a set of methods
+struct AllowValue {
+    std::array<char, 64> chars{};
+    size_t size = 0;
+};
+
+/// `Allow` values of every set of methods, formatted by the compiler, so
+/// answering a method that isn't allowed doesn't format anything
+constexpr auto ALLOW_VALUES = [] {
+    std::array<AllowValue, size_t{1} << METHOD_COUNT> values{};
+    for (size_t methods = 0; methods < values.size(); ++methods) {
+        AllowValue& value = values[methods];
+        for (size_t i = 0; i < METHOD_COUNT; ++i) {
+            if ((methods & method_bit(ALL_METHODS[i])) == 0) {
+                continue;
+            }
+            if (value.size != 0) {
+                value.chars[value.size++] = ',';
+                value.chars[value.size++] = ' ';
+            }
+            for (const char c : METHOD_NAMES[i]) {
+                value.chars[value.size++] = c;
+            }
+        }
+    }
+    return values;
+}();
+
 void print_node_tree_segment(const uint8_t layer, const bool last) noexcept {
     if (layer > 0 && !last) {
         std::cout << "|";
@@ -23,29 +71,178 @@ void print_node_tree_segment(const uint8_t layer, const bool last) noexcept {
 }
 }  // namespace
 
+std::string_view format_allowed_methods(const MethodMask methods) noexcept {
+    const AllowValue& value = ALLOW_VALUES[methods];
+    return {value.chars.data(), value.size};
+}
+
+// ===== ParameterBuffer =====
+bool ParameterBuffer::push(const std::string_view value) noexcept {
+    if (size_ == values_.size()) {
+        return false;
+    }
+    values_[size_++] = value;
+    return true;
+}
+
+void ParameterBuffer::pop() noexcept { --size_; }
+
+PathParameters ParameterBuffer::view() const noexcept {
+    return {values_.data(), size_};
+}
+
 // ===== RouteResult =====
-RequestHandler RoutingResult::handler() const noexcept { return handler_; }
+const RequestHandler& RoutingResult::handler() const noexcept {
+    return route_->handler;
+}
+
+const StreamingHandler& RoutingResult::streaming_handler() const noexcept {
+    return route_->streaming_handler;
+}
+
+const PreparedResponse* RoutingResult::prepared() const noexcept {
+    return route_->prepared.get();
+}
+
+auto RoutingResult::function() const noexcept -> decltype(Route::function) {
+    return route_->function;
+}
 
 PathParameters RoutingResult::parameters() const noexcept {
-    return parameters_;
+    return parameters_.view();
+}
+
+const RouteConfig& RoutingResult::config() const noexcept {
+    return route_->config;
+}
+bool RoutingResult::found() const noexcept { return found_; }
+MethodMask RoutingResult::allowed_methods() const noexcept {
+    return allowed_methods_;
+}
+std::string_view RoutingResult::allow() const noexcept {
+    return format_allowed_methods(allowed_methods_);
 }
 
 // ===== Router =====
 void Router::set_not_found_handler(const RequestHandler handler) noexcept {
-    not_found_handler_ = handler;
+    not_found_ = Route{handler};
+}
+
+void Router::set_not_found_response(PreparedResponse response) {
+    not_found_ = Route{
+        .prepared =
+            std::make_shared<const PreparedResponse>(std::move(response))};
+}
+
+void Router::set_static_routes(const StaticLookup lookup) noexcept {
+    static_routes_ = lookup;
 }
 
 void Router::add_route(const HttpMethod method, const std::string_view target,
-                       const RequestHandler& handler) noexcept {
-    tree_.insert(method, target, handler);
+                       const RequestHandler& handler,
+                       const RouteConfig& config) noexcept {
+    frozen_.reset();
+    tree_.insert(method, target, handler, config);
+}
+
+void Router::add_streaming_route(const HttpMethod method,
+                                 const std::string_view target,
+                                 const StreamingHandler& handler,
+                                 const RouteConfig& config) noexcept {
+    frozen_.reset();
+    tree_.insert(method, target, Route{{}, handler, config});
+}
+
+void Router::add_prepared_route(const HttpMethod method,
+                                const std::string_view target,
+                                PreparedResponse response,
+                                const RouteConfig& config) {
+    frozen_.reset();
+    tree_.insert(
+        method, target,
+        Route{{}, {}, config,
+              std::make_shared<const PreparedResponse>(std::move(response))});
+}
+
+void Router::add_prefix_route(const HttpMethod method, std::string_view prefix,
+                              const RequestHandler& handler,
+                              const RouteConfig& config) {
+    // leading slash is insignificant, the trailing one makes sure only whole
+    // components are matched
+    if (prefix.starts_with('/')) {
+        prefix = prefix.substr(1);
+    }
+    std::string normalized{prefix};
+    if (!normalized.empty() && !normalized.ends_with('/')) {
+        normalized += '/';
+    }
+
+    auto iter = std::find_if(prefix_routes_.begin(), prefix_routes_.end(),
+                             [&](const PrefixRoute& route) {
+                                 return route.method == method &&
+                                        route.prefix == normalized;
+                             });
+    if (iter != prefix_routes_.end()) {
+        iter->route = Route{handler, {}, config};
+        return;
+    }
+
+    auto position = std::find_if(
+        prefix_routes_.begin(), prefix_routes_.end(),
+        [&normalized](const PrefixRoute& route) {
+            return route.prefix.size() < normalized.size();
+        });
+    prefix_routes_.insert(
+        position,
+        PrefixRoute{method, std::move(normalized), Route{handler, {}, config}});
 }
 
 void Router::print_tree() const noexcept { tree_.print(); }
 
+bool Router::freeze() {
+    frozen_ = FrozenRouteTable::compile(tree_);
+    return frozen_.has_value();
+}
+
 RoutingResult Router::route(const HttpMethod method,
-                            const std::string_view target) const noexcept {
-    return tree_.get(method, target)
-        .value_or(RoutingResult{not_found_handler_, {}});
+                            std::string_view target) const noexcept {
+    MethodMask allowed = 0;
+    if (static_routes_ != nullptr) {
+        std::optional<RoutingResult> result =
+            static_routes_(method, target, allowed);
+        if (result.has_value()) {
+            return std::move(*result);
+        }
+    }
+
+    std::optional<RoutingResult> result =
+        frozen_.has_value() ? frozen_->get(method, target, allowed)
+                            : tree_.get(method, target, allowed);
+    if (result.has_value()) {
+        return std::move(*result);
+    }
+
+    std::string_view relative = target;
+    if (relative.starts_with('/')) {
+        relative = relative.substr(1);
+    }
+    for (const PrefixRoute& prefix_route : prefix_routes_) {
+        if (!relative.starts_with(prefix_route.prefix)) {
+            continue;
+        }
+        if (prefix_route.method != method) {
+            allowed |= method_bit(prefix_route.method);
+            continue;
+        }
+        ParameterBuffer params;
+        params.push(relative.substr(prefix_route.prefix.size()));
+        return RoutingResult{prefix_route.route, params};
+    }
+
+    if (allowed != 0) {
+        return RoutingResult{method_not_allowed_, {}, false, allowed};
+    }
+    return RoutingResult{not_found_, {}, false};
 }
 
 // ===== RouteTree::Node =====
@@ -97,8 +294,10 @@ void RouteTree::Node::print(const uint8_t layer,
         std::cout << key_;
     }
     std::cout << ' ';
-    for (const auto& [method, _] : handlers_) {
-        std::cout << format_method(method) << ' ';
+    for (const HttpMethod method : ALL_METHODS) {
+        if ((allowed_ & method_bit(method)) != 0) {
+            std::cout << format_method(method) << ' ';
+        }
     }
     std::cout << '\n';
 
@@ -165,136 +364,424 @@ RouteTree::Node& RouteTree::Node::insert_or_get_child(Node&& child) {
 }
 
 void RouteTree::Node::insert_or_replace_handler(const HttpMethod method,
-                                                const RequestHandler handler) {
-    auto iter = std::find_if(
-        handlers_.begin(), handlers_.end(),
-        [method](const std::pair<HttpMethod, RequestHandler>& hanlder) {
-            return hanlder.first == method;
-        });
-
-    if (iter != handlers_.end()) {
-        iter->second = handler;
-    } else {
-        handlers_.emplace_back(method, handler);
-    }
+                                                Route route) {
+    routes_[static_cast<size_t>(method)] =
+        std::make_unique<const Route>(std::move(route));
+    allowed_ |= method_bit(method);
 }
 
-std::optional<RequestHandler> RouteTree::Node::find_handler(
+const Route* RouteTree::Node::find_handler(
     const HttpMethod method) const noexcept {
-    auto iter = std::find_if(
-        handlers_.cbegin(), handlers_.cend(),
-        [method](const std::pair<HttpMethod, RequestHandler>& hanlder) {
-            return hanlder.first == method;
-        });
-
-    if (iter == handlers_.end()) {
-        return std::nullopt;
-    }
-
-    return iter->second;
+    return routes_[static_cast<size_t>(method)].get();
 }
 
-std::vector<std::reference_wrapper<const RouteTree::Node>>
-RouteTree::Node::find_matching_children(
-    const std::string_view component) const noexcept {
-    std::vector<std::reference_wrapper<const RouteTree::Node>> result;
+MethodMask RouteTree::Node::allowed() const noexcept { return allowed_; }
 
-    for (const auto& child : children_) {
-        if (child.matches(component)) {
-            result.push_back(std::ref(child));
-        }
-    }
-
-    return result;
+const std::vector<RouteTree::Node>& RouteTree::Node::children()
+    const noexcept {
+    return children_;
 }
 
 // ===== RouteTree =====
 void RouteTree::print() const noexcept { root_.print(); }
 
 void RouteTree::insert(Node& cur_node, const HttpMethod method,
-                       std::string_view target, const RequestHandler handler) {
+                       std::string_view target, Route route) {
     const size_t slash_pos = target.find('/');
     const std::string_view component = target.substr(0, slash_pos);
 
     if (slash_pos == std::string_view::npos) {
         cur_node.insert_or_get_child(Node{component})
-            .insert_or_replace_handler(method, handler);
+            .insert_or_replace_handler(method, std::move(route));
     } else {
         target = target.substr(slash_pos + 1);
         insert(cur_node.insert_or_get_child(Node{component}), method, target,
-               handler);
+               std::move(route));
     }
 }
 
 void RouteTree::insert(const HttpMethod method, std::string_view target,
-                       const RequestHandler handler) noexcept {
+                       const RequestHandler handler,
+                       const RouteConfig config) noexcept {
+    insert(method, target, Route{handler, {}, config});
+}
+
+void RouteTree::insert(const HttpMethod method, std::string_view target,
+                       Route route) noexcept {
     // leading slash is insignificant
     if (target.starts_with('/')) {
         target = target.substr(1);
     }
 
-    insert(root_, method, target, handler);
+    insert(root_, method, target, std::move(route));
 }
 
-std::optional<RoutingResult> RouteTree::get(
-    Node const& cur_node, std::vector<std::string_view>& params,
-    const HttpMethod method, std::string_view target) noexcept {
+const Route* RouteTree::get(Node const& cur_node, ParameterBuffer& params,
+                            const HttpMethod method, std::string_view target,
+                            MethodMask& allowed) noexcept {
     const size_t slash_pos = target.find('/');
     const bool is_last_component = slash_pos == std::string_view::npos;
     const std::string_view cur_component = target.substr(0, slash_pos);
+    target = target.substr(is_last_component ? target.size() : slash_pos + 1);
 
-    if (is_last_component) {
-        for (const Node& child :
-             cur_node.find_matching_children(cur_component)) {
-            std::optional<RequestHandler> result = child.find_handler(method);
-            if (result.has_value()) {
-                if (child.is_parameter()) {
-                    params.push_back(cur_component);
-                }
-                return RoutingResult{*result, std::move(params)};
-            }
+    // sorting guarantees that literals come first
+    for (const Node& child : cur_node.children()) {
+        if (!child.matches(cur_component)) {
+            continue;
+        }
+        if (child.is_parameter() && !params.push(cur_component)) {
+            return nullptr;
         }
 
-        return std::nullopt;
+        const Route* route = nullptr;
+        if (is_last_component) {
+            route = child.find_handler(method);
+            allowed |= child.allowed();
+        } else {
+            route = get(child, params, method, target, allowed);
+        }
+        if (route != nullptr) {
+            return route;
+        }
+        if (child.is_parameter()) {
+            params.pop();
+        }
     }
+    return nullptr;
+}
 
-    auto matching_children = cur_node.find_matching_children(cur_component);
+std::optional<RoutingResult> RouteTree::get(
+    const HttpMethod method, const std::string_view target) const noexcept {
+    MethodMask allowed = 0;
+    return get(method, target, allowed);
+}
+
+std::optional<RoutingResult> RouteTree::get(
+    const HttpMethod method, std::string_view target,
+    MethodMask& allowed) const noexcept {
+    // leading slash is insignificant
+    if (target.starts_with('/')) {
+        target = target.substr(1);
+    }
 
-    assert(std::is_sorted(matching_children.begin(), matching_children.end(),
-                          [](Node const& lhs, Node const& rhs) {
-                              return std::less<Node>{}(lhs, rhs);
-                          }));
+    ParameterBuffer params;
+    const Route* route = get(root_, params, method, target, allowed);
+    if (route == nullptr) {
+        return std::nullopt;
+    }
+    return RoutingResult{*route, params};
+}
 
-    bool pushed_parameter = false;
-    target = target.substr(slash_pos + 1);  // remove current path component
-    for (const Node& child : matching_children) {
-        // sorting guarantees that literals come first
-        if (child.is_parameter() && !pushed_parameter) {
-            params.push_back(cur_component);
-            pushed_parameter = true;
+// ===== FrozenRouteTable =====
+std::optional<FrozenRouteTable> FrozenRouteTable::compile(
+    const RouteTree& tree) {
+    using Node = RouteTree::Node;
+    // nodes of a state, ordered the way the tree tries them, so the first one
+    // with a route wins
+    using NodeSet = std::vector<const Node*>;
+
+    FrozenRouteTable table;
+
+    // every node with routes becomes an endpoint, which knows the
+    // components of its targets that are parameters
+    std::unordered_map<const Node*, uint32_t>& endpoints =
+        table.node_endpoints_;
+    std::vector<uint32_t> depths;
+    // nodes at every depth, and most children of a node that may match the
+    // same component: all the parameters, but only a single literal
+    std::vector<size_t> widths;
+    std::vector<size_t> fanouts;
+    const auto add_endpoints = [&](const auto& self, const Node& node,
+                                   const uint32_t depth) -> void {
+        if (widths.size() <= depth) {
+            widths.push_back(0);
+            fanouts.push_back(0);
         }
+        widths[depth] += node.children().size();
+        const auto parameters = static_cast<size_t>(std::count_if(
+            node.children().begin(), node.children().end(),
+            [](const Node& child) { return child.is_parameter(); }));
+        fanouts[depth] = std::max(
+            fanouts[depth],
+            parameters + (parameters < node.children().size() ? 1 : 0));
+        for (const Node& child : node.children()) {
+            if (child.is_parameter()) {
+                depths.push_back(depth);
+            }
+            if (child.allowed() != 0) {
+                Endpoint endpoint;
+                for (size_t method = 0; method < METHOD_COUNT; ++method) {
+                    endpoint.routes[method] =
+                        child.find_handler(static_cast<HttpMethod>(method));
+                }
+                endpoint.parameters_begin =
+                    static_cast<uint32_t>(table.parameter_depths_.size());
+                table.parameter_depths_.insert(
+                    table.parameter_depths_.end(), depths.begin(),
+                    depths.end());
+                endpoint.parameters_end =
+                    static_cast<uint32_t>(table.parameter_depths_.size());
+                endpoints.emplace(
+                    &child, static_cast<uint32_t>(table.endpoints_.size()));
+                table.endpoints_.push_back(endpoint);
+            }
+            self(self, child, depth + 1);
+            if (child.is_parameter()) {
+                depths.pop_back();
+            }
+        }
+    };
+    add_endpoints(add_endpoints, tree.root_, 0);
+    table.width_ = 1;
+    for (size_t depth = 0, reached = 1; depth < widths.size(); ++depth) {
+        reached = std::min(widths[depth], reached * fanouts[depth]);
+        table.width_ = std::max(table.width_, reached);
+    }
 
-        std::optional<RoutingResult> result =
-            get(child, params, method, target);
-        if (result.has_value()) {
-            return result;
+    // the queue holds the nodes of every state, at the same index
+    std::map<NodeSet, uint32_t> ids;
+    std::vector<NodeSet> queue;
+    const auto state_of = [&](NodeSet nodes) -> uint32_t {
+        if (nodes.empty()) {
+            return NONE;
+        }
+        const auto [iter, inserted] =
+            ids.try_emplace(nodes, static_cast<uint32_t>(queue.size()));
+        if (inserted) {
+            queue.push_back(std::move(nodes));
+        }
+        return iter->second;
+    };
+    state_of({&tree.root_});
+
+    std::unordered_map<std::string_view, uint32_t> key_offsets;
+    for (size_t i = 0; i < queue.size(); ++i) {
+        if (queue.size() > MAX_STATES) {
+            // the tree nodes are matched in lockstep instead
+            if (table.width_ > MAX_LOCKSTEP_WIDTH) {
+                return std::nullopt;
+            }
+            table.states_ = {};
+            table.literals_ = {};
+            table.first_bytes_ = {};
+            table.keys_ = {};
+            table.accepts_ = {};
+            table.root_ = &tree.root_;
+            return table;
+        }
+        // copied, the queue grows while the state is compiled
+        const NodeSet nodes = queue[i];
+        const auto step = [&nodes](const auto& matches) {
+            NodeSet next;
+            for (const Node* node : nodes) {
+                for (const Node& child : node->children()) {
+                    if (matches(child)) {
+                        next.push_back(&child);
+                    }
+                }
+            }
+            return next;
+        };
+
+        std::vector<std::string_view> keys;
+        for (const Node* node : nodes) {
+            for (const Node& child : node->children()) {
+                if (!child.is_parameter() && !child.key().empty()) {
+                    keys.push_back(child.key());
+                }
+            }
+        }
+        // string views compare bytes as unsigned, like the lookups do
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        State state;
+        state.literals_begin = static_cast<uint32_t>(table.literals_.size());
+        for (const std::string_view key : keys) {
+            const auto [offset, inserted] = key_offsets.try_emplace(
+                key, static_cast<uint32_t>(table.keys_.size()));
+            if (inserted) {
+                table.keys_ += key;
+            }
+            const uint32_t target = state_of(
+                step([key](const Node& child) { return child.matches(key); }));
+            table.literals_.push_back(Literal{
+                offset->second, static_cast<uint32_t>(key.size()), target});
+            table.first_bytes_.push_back(key.front());
+        }
+        state.literals_end = static_cast<uint32_t>(table.literals_.size());
+        state.empty = state_of(
+            step([](const Node& child) { return child.matches({}); }));
+        state.other = state_of(
+            step([](const Node& child) { return child.is_parameter(); }));
+
+        Accept accept;
+        accept.endpoints.fill(NONE);
+        for (const Node* node : nodes) {
+            accept.allowed |= node->allowed();
+            for (size_t method = 0; method < METHOD_COUNT; ++method) {
+                if (accept.endpoints[method] == NONE &&
+                    node->find_handler(static_cast<HttpMethod>(method)) !=
+                        nullptr) {
+                    accept.endpoints[method] = endpoints.at(node);
+                }
+            }
+        }
+        if (accept.allowed != 0) {
+            state.accept = static_cast<uint32_t>(table.accepts_.size());
+            table.accepts_.push_back(accept);
         }
+        table.states_.push_back(state);
+    }
+    // only the lockstep lookups need to know the endpoints of the nodes
+    table.node_endpoints_ = {};
+    return table;
+}
+
+std::string_view FrozenRouteTable::key(const Literal& literal) const noexcept {
+    return std::string_view{keys_}.substr(literal.key_offset,
+                                          literal.key_size);
+}
+
+uint32_t FrozenRouteTable::next(
+    const State& state, const std::string_view component) const noexcept {
+    if (component.empty()) {
+        return state.empty;
     }
 
-    if (pushed_parameter) {
-        params.pop_back();
+    // literals are sorted by their keys, the first bytes narrow down the
+    // keys searched without touching the others
+    const auto [first_lower, first_upper] = std::equal_range(
+        first_bytes_.begin() + state.literals_begin,
+        first_bytes_.begin() + state.literals_end,
+        component.front(), [](char lhs, char rhs) {
+            return static_cast<unsigned char>(lhs) <
+                   static_cast<unsigned char>(rhs);
+        });
+    const auto begin = literals_.begin() + (first_lower - first_bytes_.begin());
+    const auto end = literals_.begin() + (first_upper - first_bytes_.begin());
+    const auto iter = std::lower_bound(
+        begin, end, component,
+        [this](const Literal& literal, const std::string_view value) {
+            return key(literal) < value;
+        });
+    if (iter != end && key(*iter) == component) {
+        return iter->target;
     }
-    return std::nullopt;
+    return state.other;
 }
 
-std::optional<RoutingResult> RouteTree::get(
-    HttpMethod method, std::string_view target) const noexcept {
+std::optional<RoutingResult> FrozenRouteTable::get(
+    const HttpMethod method, std::string_view target,
+    MethodMask& allowed) const noexcept {
     // leading slash is insignificant
     if (target.starts_with('/')) {
         target = target.substr(1);
     }
+    if (root_ != nullptr) {
+        return get_lockstep(method, target, allowed);
+    }
+
+    uint32_t state = 0;
+    for (size_t begin = 0;;) {
+        const size_t slash_pos = target.find('/', begin);
+        state = next(states_[state], target.substr(begin, slash_pos - begin));
+        if (state == NONE) {
+            return std::nullopt;
+        }
+        if (slash_pos == std::string_view::npos) {
+            break;
+        }
+        begin = slash_pos + 1;
+    }
+
+    if (states_[state].accept == NONE) {
+        return std::nullopt;
+    }
+    const Accept& accept = accepts_[states_[state].accept];
+    allowed |= accept.allowed;
+    const uint32_t endpoint_index =
+        accept.endpoints[static_cast<size_t>(method)];
+    if (endpoint_index == NONE) {
+        return std::nullopt;
+    }
+    return resolve(endpoint_index, method, target);
+}
+
+std::optional<RoutingResult> FrozenRouteTable::get_lockstep(
+    const HttpMethod method, const std::string_view target,
+    MethodMask& allowed) const noexcept {
+    using Node = RouteTree::Node;
+
+    // nodes reached by the components so far, ordered the way the tree tries
+    // them. Every node is reached by a single path, so they never repeat, and
+    // there are never more than `width_` of them
+    std::array<std::array<const Node*, MAX_LOCKSTEP_WIDTH>, 2> levels;
+    size_t current = 0;
+    levels[current][0] = root_;
+    size_t reached = 1;
+    for (size_t begin = 0;;) {
+        const size_t slash_pos = target.find('/', begin);
+        const std::string_view component =
+            target.substr(begin, slash_pos - begin);
+        size_t next_reached = 0;
+        for (size_t i = 0; i < reached; ++i) {
+            for (const Node& child : levels[current][i]->children()) {
+                if (child.matches(component)) {
+                    levels[current ^ 1][next_reached++] = &child;
+                }
+            }
+        }
+        if (next_reached == 0) {
+            return std::nullopt;
+        }
+        current ^= 1;
+        reached = next_reached;
+        if (slash_pos == std::string_view::npos) {
+            break;
+        }
+        begin = slash_pos + 1;
+    }
 
-    std::vector<std::string_view> params;
-    return get(root_, params, method, target);
+    const Node* winner = nullptr;
+    for (size_t i = 0; i < reached; ++i) {
+        const Node* node = levels[current][i];
+        allowed |= node->allowed();
+        if (winner == nullptr && node->find_handler(method) != nullptr) {
+            winner = node;
+        }
+    }
+    if (winner == nullptr) {
+        return std::nullopt;
+    }
+    return resolve(node_endpoints_.at(winner), method, target);
 }
+
+std::optional<RoutingResult> FrozenRouteTable::resolve(
+    const uint32_t endpoint_index, const HttpMethod method,
+    const std::string_view target) const noexcept {
+    // only now it's known which components are parameters
+    const Endpoint& endpoint = endpoints_[endpoint_index];
+    ParameterBuffer params;
+    uint32_t depth = 0;
+    size_t begin = 0;
+    for (uint32_t i = endpoint.parameters_begin; i < endpoint.parameters_end;
+         ++i) {
+        for (; depth < parameter_depths_[i]; ++depth) {
+            begin = target.find('/', begin) + 1;
+        }
+        const size_t end = target.find('/', begin);
+        if (!params.push(target.substr(begin, end - begin))) {
+            return std::nullopt;
+        }
+    }
+    return RoutingResult{*endpoint.routes[static_cast<size_t>(method)],
+                         params};
+}
+
+bool FrozenRouteTable::determinized() const noexcept {
+    return root_ == nullptr;
+}
+
+size_t FrozenRouteTable::states() const noexcept { return states_.size(); }
 }  // namespace waxwing::internal
@@ -0,0 +1,170 @@
+#include "serializer.hh"
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "waxwing/http.hh"
+#include "waxwing/str_split.hh"
+#include "waxwing/str_util.hh"
+
+namespace waxwing::internal {
+namespace {
+/// Room for the fields written from `HeadFields`, which are only a few
+constexpr size_t HEAD_FIELDS_SIZE = 128;
+
+constexpr std::array<std::string_view, 7> WEEKDAYS{
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
+};
+constexpr std::array<std::string_view, 12> MONTHS{
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+/// `Date` header line of one second, in the IMF-fixdate format
+class CachedDate final {
+    // "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+    std::array<char, 64> line_{};
+    size_t size_ = 0;
+    std::time_t second_ = -1;
+
+    void append(const std::string_view data) noexcept {
+        data.copy(line_.data() + size_, data.size());
+        size_ += data.size();
+    }
+
+    /// Zero padded to `width` digits
+    void append_number(int value, const size_t width) noexcept {
+        for (size_t i = width; i > 0; --i) {
+            line_[size_ + i - 1] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+        size_ += width;
+    }
+
+    void format(const std::time_t second) noexcept {
+        std::tm time{};
+        gmtime_r(&second, &time);
+
+        size_ = 0;
+        append("Date: ");
+        append(WEEKDAYS[static_cast<size_t>(time.tm_wday)]);
+        append(", ");
+        append_number(time.tm_mday, 2);
+        append(" ");
+        append(MONTHS[static_cast<size_t>(time.tm_mon)]);
+        append(" ");
+        append_number(time.tm_year + 1900, 4);
+        append(" ");
+        append_number(time.tm_hour, 2);
+        append(":");
+        append_number(time.tm_min, 2);
+        append(":");
+        append_number(time.tm_sec, 2);
+        append(" GMT\r\n");
+        second_ = second;
+    }
+
+public:
+    std::string_view get() noexcept {
+        const std::time_t now = std::chrono::system_clock::to_time_t(
+            std::chrono::system_clock::now());
+        if (now != second_) {
+            format(now);
+        }
+        return {line_.data(), size_};
+    }
+};
+
+void append_field(std::string& buf, const std::string_view key,
+                  const std::string_view value) {
+    buf += key;
+    buf += ": ";
+    buf += value;
+    buf += "\r\n";
+}
+
+/// Whether the handler's field `key` gives way to one the server writes
+bool is_replaced(const std::string_view key, const HeadFields& fields) {
+    switch (key.size()) {
+        case 10:
+            return !fields.connection.empty() &&
+                   str_util::case_insensitive_eq(key, "connection");
+        case 14:
+            // a length next to the chunked coding would let the receivers
+            // disagree on where the body ends
+            return (fields.content_length.has_value() || fields.chunked) &&
+                   str_util::case_insensitive_eq(key, "content-length");
+        case 17:
+            return fields.chunked &&
+                   str_util::case_insensitive_eq(key, "transfer-encoding");
+        default:
+            return false;
+    }
+}
+}  // namespace
+
+bool may_have_body(const HttpStatusCode status) noexcept {
+    const auto code = static_cast<int>(status);
+    return code >= 200 && status != HttpStatusCode::NoContent_204 &&
+           status != HttpStatusCode::NotModified_304;
+}
+
+bool has_connection_option(const std::string_view value,
+                           const std::string_view option) {
+    auto option_split = str_util::split(value, ',');
+    for (std::optional<std::string_view> token = option_split.next();
+         token.has_value(); token = option_split.next()) {
+        if (str_util::case_insensitive_eq(str_util::trim(*token), option)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view date_header() noexcept {
+    thread_local CachedDate date;
+    return date.get();
+}
+
+void serialize_head(std::string& buf, const HttpStatusCode status,
+                    const Headers& headers, const HeadFields& fields) {
+    const std::string_view status_line = format_status_line(status);
+    size_t size = buf.size() + status_line.size() + HEAD_FIELDS_SIZE;
+    for (const auto& [key, value] : headers) {
+        size += key.size() + value.size() + 4;
+    }
+    buf.reserve(size);
+
+    buf += status_line;
+    for (const auto& [key, value] : headers) {
+        if (!is_replaced(key, fields)) {
+            append_field(buf, str_util::trim(key), str_util::trim(value));
+        }
+    }
+
+    if (fields.content_length.has_value()) {
+        std::array<char, 20> digits{};
+        const std::to_chars_result result = std::to_chars(
+            digits.data(), digits.data() + digits.size(),
+            *fields.content_length);
+        append_field(buf, "Content-Length",
+                     {digits.data(), static_cast<size_t>(result.ptr -
+                                                         digits.data())});
+    }
+    if (fields.chunked) {
+        append_field(buf, "Transfer-Encoding", "chunked");
+    }
+    if (!fields.connection.empty()) {
+        append_field(buf, "Connection", fields.connection);
+    }
+    if (fields.date && !headers.contains("date")) {
+        buf += date_header();
+    }
+}
+}  // namespace waxwing::internal
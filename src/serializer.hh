@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "waxwing/http.hh"
+
+namespace waxwing::internal {
+/// Header fields the server writes itself, straight into the head instead of
+/// going through `Headers`. Fields of the same names set by the handler are
+/// replaced
+struct HeadFields {
+    std::optional<size_t> content_length;
+    bool chunked = false;
+    /// Value of the `Connection` header, none if empty
+    std::string_view connection;
+    /// Whether to add the current `Date`, unless the handler set one
+    bool date = true;
+};
+
+/// Whether a response with `status` may carry a body, and so a length
+bool may_have_body(HttpStatusCode status) noexcept;
+
+/// Whether the comma separated `Connection` header value lists `option`
+bool has_connection_option(std::string_view value, std::string_view option);
+
+/// The whole `Date` header line for the current second. It's formatted at
+/// most once a second by each thread, and valid until the next call on the
+/// same thread
+std::string_view date_header() noexcept;
+
+/// Append the status line and the header fields to `buf`, without the empty
+/// line that ends the head. The head is sized up front, so it's built with a
+/// single allocation
+void serialize_head(std::string& buf, HttpStatusCode status,
+                    const Headers& headers, const HeadFields& fields);
+}  // namespace waxwing::internal
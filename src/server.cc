@@ -1,228 +1,168 @@
 #include "waxwing/server.hh"
 
-#include <fmt/core.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <system_error>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "connection_park.hh"
+#include "epoll_server.hh"
+#include "output_buffer.hh"
+#include "session.hh"
+#include "static_files.hh"
 #include "thread_pool.hh"
+#include "uring_server.hh"
+#include "waxwing/file.hh"
 #include "waxwing/http.hh"
 #include "waxwing/io.hh"
 #include "waxwing/request.hh"
 #include "waxwing/response.hh"
 #include "waxwing/router.hh"
-#include "waxwing/str_split.hh"
-#include "waxwing/str_util.hh"
 
 namespace waxwing {
 using internal::Connection;
+using internal::ConnectionPark;
+using internal::OutputBuffer;
+using internal::ParkedConnection;
+using internal::Reactor;
 using internal::Router;
+using internal::Session;
 using internal::Socket;
 using internal::concurrency::ThreadPool;
 
 namespace {
-std::pair<std::string_view, std::string_view> parse_header(
-    const std::string_view line) {
-    const size_t colon_pos = line.find(':');
-
-    return {str_util::trim(line.substr(0, colon_pos)),
-            str_util::trim(
-                line.substr(colon_pos + 1, line.size() - colon_pos - 1))};
-}
-
-void concat_header(std::string& buf, const std::string_view key,
-                   const std::string_view value) {
-    buf += str_util::trim(key);
-    buf += ": ";
-    buf += str_util::trim(value);
-    buf += "\r\n";
-}
-
-void concat_headers(std::string& buf, const Headers& headers) {
-    for (const auto& [key, value] : headers) {
-        concat_header(buf, key, value);
-    }
-}
-
-std::string read_body(const Connection& conn, std::string_view initial,
-                      const size_t length) {
-    constexpr size_t CHUNK_SIZE = 1024;
-
-    std::string body{initial};
-    size_t bytes_read = initial.size();
-    do {
-        bytes_read += conn.recv(body, CHUNK_SIZE);
-    } while (bytes_read < length);
-
-    return body;
-}
-
-std::optional<std::pair<HttpMethod, std::string>> parse_request_line(
-    std::string_view line) {
-    auto token_split = str_util::split(line, ' ');
-
-    std::optional<HttpMethod> method =
-        and_then(token_split.next(),
-                 [](const std::string_view s) { return parse_method(s); });
-    std::optional<std::string> target = map(
-        token_split.next(), [](std::string_view s) { return std::string{s}; });
-    const std::optional<std::string_view> http_version = token_split.next();
-
-    if (!method || !target || !http_version) {
-        return std::nullopt;
+/// Blocking write of the whole `output`, returns `false` on failure
+bool send_all(const Connection& connection, OutputBuffer& output) {
+    std::array<iovec, OutputBuffer::MAX_IOVECS> iovecs{};
+    while (!output.empty()) {
+        const std::optional<FileRange> file = output.front_file();
+        const internal::IoResult sent =
+            file.has_value()
+                ? connection.try_send_file(file->file->fd(), file->offset,
+                                           file->length)
+                : connection.try_send(
+                      std::span{iovecs.data(), output.gather(iovecs)});
+        if (!sent) {
+            return false;
+        }
+        output.consume(*sent);
     }
-    return {{method.value(), std::move(*target)}};
+    return true;
 }
 
-Result<size_t, std::string> parse_content_length(std::string_view raw) {
-    size_t content_length = 0;
-
-    const std::errc error_code =
-        std::from_chars(raw.cbegin(), raw.cend(), content_length).ec;
-    if (error_code != std::errc{}) {
-        return Error{fmt::format("couldn't parse `Content-Length`: {}",
-                                 std::make_error_code(error_code).message())};
-    } else {
-        return content_length;
-    }
+bool would_block(const std::errc error) noexcept {
+    return error == std::errc::resource_unavailable_try_again ||
+           error == std::errc::operation_would_block;
 }
 
-Result<Request, std::string> read_request(const Connection& conn) {
-    constexpr size_t HEADERS_BUFFER_SIZE = 2048;  // 2 Kb
-
-    std::string buf;
-    conn.recv(buf, HEADERS_BUFFER_SIZE);
-
-    str_util::Split line_split = str_util::split(buf, "\r\n");
-
-    std::optional<std::pair<HttpMethod, std::string>> request_line_opt =
-        and_then(line_split.next(), [](const std::string_view line) {
-            return parse_request_line(line);
-        });
-    if (!request_line_opt) {
-        return Error{"Error parsing request line"};
-    }
-
-    auto [method, target] = std::move(*request_line_opt);
-
-    RequestBuilder builder{method, std::move(target)};
-    Headers headers;
-
-    for (std::optional<std::string_view> line = line_split.next();
-         line.has_value(); line = line_split.next()) {
-        if (line->empty()) {
-            break;
-        }
-
-        auto [key, value] = parse_header(*line);
-        headers.get(key) = value;
-    };
-
-    // requests with DELETE, POST, PATCH or PUT method generally have a body
-    // https://developer.mozilla.org/en-US/docs/Web/HTTP/Methods
-    const bool has_body =
-        method == HttpMethod::Delete || method == HttpMethod::Patch ||
-        method == HttpMethod::Post || method == HttpMethod::Put ||
-        headers.contains("content-length") || headers.contains("content-type");
-    if (has_body) {
-        auto raw_content_length_opt = headers.get("content-length");
-        if (raw_content_length_opt.has_value()) {
-            Result<size_t, std::string> content_length =
-                parse_content_length(*raw_content_length_opt);
-            if (!content_length) {
-                return Error{content_length.error()};
+/// Serve the requests of `parked` that have arrived, parking it again once
+/// it waits for more of them
+void resume_connection(ConnectionPark& park,
+                       std::unique_ptr<ParkedConnection> parked) noexcept {
+    const Connection& connection = parked->connection;
+    Session& session = parked->session;
+    while (!session.should_close()) {
+        // a worker never waits for a client, the connection is parked instead
+        const internal::IoResult received =
+            connection.try_recv(session.input_buffer(), true);
+        session.commit_input(received ? *received : 0);
+        if (!received) {
+            if (would_block(received.error())) {
+                park.park(std::move(parked));
             }
+            return;
+        }
+        if (*received == 0) {
+            return;
+        }
 
-            builder.body(
-                read_body(conn, line_split.remaining(), *content_length));
-        } else {
-            builder.body(line_split.remaining());
+        // responses to every request that came with this read are sent
+        // together in a single write, produced bodies in several of them
+        bool sent = true;
+        while (sent && session.has_output()) {
+            OutputBuffer output = session.take_output();
+            sent = send_all(connection, output);
+        }
+        if (!sent) {
+            return;
         }
     }
-
-    builder.headers(std::move(headers));
-    return std::move(builder).build();
 }
 
-void send_response(const Connection& conn, Response& resp) noexcept {
-    std::string buf;
-
-    buf += "HTTP/1.1 ";
-    buf += format_status_code(resp.status());
-    buf += "\r\n";
-
-    Headers& headers = resp.headers();
-
-    const std::optional<std::string_view> body_opt = resp.body();
-    if (body_opt.has_value()) {
-        const std::string content_length = std::to_string(body_opt->size());
-        headers.insert_or_assign("Content-Length", content_length);
+void serve_shard(const Router& router, const ServerConfig& config,
+                 const Socket& socket) noexcept {
+    const Result<void, std::string> result =
+        internal::serve_epoll(router, socket, config);
+    if (!result) {
+        spdlog::error("{}", result.error());
     }
-
-    // push all of the headers into buf
-    concat_headers(buf, headers);
-
-    // empty line is required even if the body is empty
-    buf += "\r\n";
-
-    if (body_opt.has_value()) {
-        buf += *body_opt;
-    }
-
-    conn.send(buf);
 }
+}  // namespace
 
-void handle_connection(const Router& router, Connection connection) noexcept {
-    auto req_res = read_request(connection);
-    if (!req_res) {
-        spdlog::error("{}", req_res.error());
-        return;
-    }
+void Server::route(const HttpMethod method, const internal::RouteTarget target,
+                   const std::function<Response()>& handler,
+                   const RouteConfig& config) noexcept {
+    route(
+        method, target,
+        [handler](const Request&, const PathParameters) { return handler(); },
+        config);
+}
 
-    const Request& req = req_res.value();
-    const internal::RoutingResult route =
-        router.route(req.method(), req.target());
+void Server::route(const HttpMethod method, const internal::RouteTarget target,
+                   const std::function<Response(Request const&)>& handler,
+                   const RouteConfig& config) noexcept {
+    route(
+        method, target,
+        [handler](const Request& req, const PathParameters) {
+            return handler(req);
+        },
+        config);
+}
 
-    Response resp = route.handler()(req, route.parameters());
-    spdlog::info("{} {} -> {}", format_method(req.method()), req.target(),
-                 format_status_code(resp.status()));
-    send_response(connection, resp);
+void Server::route(const HttpMethod method, const internal::RouteTarget target,
+                   const std::function<Response(const PathParameters)>& handler,
+                   const RouteConfig& config) noexcept {
+    route(
+        method, target,
+        [handler](const Request&, const PathParameters params) {
+            return handler(params);
+        },
+        config);
 }
-}  // namespace
 
 void Server::route(const HttpMethod method, const internal::RouteTarget target,
-                   const std::function<Response()>& handler) noexcept {
-    route(method, target, [handler](const Request&, const PathParameters) {
-        return handler();
-    });
+                   const internal::RequestHandler& handler,
+                   const RouteConfig& config) noexcept {
+    router_.add_route(method, target, handler, config);
 }
 
-void Server::route(
-    const HttpMethod method, const internal::RouteTarget target,
-    const std::function<Response(Request const&)>& handler) noexcept {
-    route(method, target, [handler](const Request& req, const PathParameters) {
-        return handler(req);
-    });
+void Server::route(const HttpMethod method, const internal::RouteTarget target,
+                   Response response, const RouteConfig& config) {
+    router_.add_prepared_route(method, target,
+                               PreparedResponse{std::move(response)}, config);
 }
 
-void Server::route(
-    const HttpMethod method, const internal::RouteTarget target,
-    const std::function<Response(const PathParameters)>& handler) noexcept {
-    route(method, target,
-          [handler](const Request&, const PathParameters params) {
-              return handler(params);
-          });
+void Server::route_streaming(const HttpMethod method,
+                             const internal::RouteTarget target,
+                             const internal::StreamingHandler& handler,
+                             const RouteConfig& config) noexcept {
+    router_.add_streaming_route(method, target, handler, config);
 }
 
-void Server::route(const HttpMethod method, const internal::RouteTarget target,
-                   const internal::RequestHandler& handler) noexcept {
-    router_.add_route(method, target, handler);
+void Server::serve_static(const std::string_view prefix, std::string root) {
+    router_.add_prefix_route(HttpMethod::Get, prefix,
+                             internal::static_files_handler(std::move(root)));
 }
 
 void Server::print_route_tree() const noexcept { router_.print_tree(); }
@@ -231,27 +171,121 @@ void Server::set_not_found_handler(internal::RequestHandler handler) {
     router_.set_not_found_handler(handler);
 }
 
+void Server::set_not_found_response(Response response) {
+    router_.set_not_found_response(PreparedResponse{std::move(response)});
+}
+
+void Server::configure(const ServerConfig& config) noexcept {
+    config_ = config;
+}
+
 Result<void, std::string> Server::bind(const std::string_view address,
-                                       const uint16_t port,
-                                       const int backlog) noexcept {
-    auto sock_res = Socket::create(address, port, backlog);
+                                       const uint16_t port, const int backlog,
+                                       const bool share_port) noexcept {
+    // unless the port is shared, a server already listening on it is
+    // reported here
+    auto sock_res = Socket::create(address, port, backlog, share_port);
     if (!sock_res) {
         return Error{std::move(sock_res.error())};
     }
     socket_ = std::move(sock_res.value());
+    address_ = address;
+    backlog_ = backlog;
+    share_port_ = share_port;
 
     return {};
 }
 
-void Server::serve() const noexcept {
-    ThreadPool thread_pool{std::thread::hardware_concurrency() - 1};
+uint16_t Server::port() const noexcept { return socket_.port(); }
+
+void Server::serve(const ServeMode mode) noexcept {
+    if (!router_.freeze()) {
+        spdlog::error("routes are too ambiguous to be looked up without "
+                      "allocating");
+        return;
+    }
+
+    if (mode == ServeMode::Sharded) {
+        // every thread gets its own socket, the calling thread serves the
+        // bound one. The others are bound to the port it actually got, which
+        // may have been picked by the kernel
+        if (!share_port_) {
+            spdlog::error("sharded serving requires a socket bound with "
+                          "`share_port`");
+            return;
+        }
+        const uint16_t port = socket_.port();
+
+        const unsigned shards_count =
+            std::max(std::thread::hardware_concurrency(), 1U);
+        std::vector<Socket> sockets;
+        for (unsigned i = 1; i < shards_count; ++i) {
+            Result<Socket, std::string> socket =
+                Socket::create(address_, port, backlog_, true);
+            if (!socket) {
+                spdlog::error("creating shard socket failed: {}",
+                              socket.error());
+                break;
+            }
+            sockets.push_back(std::move(socket.value()));
+        }
+
+        // declared after the sockets, so they're joined before the sockets
+        // are closed
+        std::vector<std::jthread> shards;
+        for (const Socket& socket : sockets) {
+            shards.emplace_back([this, &socket] {
+                serve_shard(router_, config_, socket);
+            });
+        }
+        serve_shard(router_, config_, socket_);
+        return;
+    }
+
+    if (mode == ServeMode::IoUring || mode == ServeMode::Epoll) {
+        const Result<void, std::string> result =
+            mode == ServeMode::IoUring
+                ? internal::serve_uring(router_, socket_, config_)
+                : internal::serve_epoll(router_, socket_, config_);
+        if (!result) {
+            spdlog::error("{}", result.error());
+        }
+        return;
+    }
+
+    // leave one core for the accepting thread, but have at least one worker
+    ThreadPool thread_pool{
+        std::max(std::thread::hardware_concurrency(), 2U) - 1};
+
+    Result<Reactor, std::string> reactor = Reactor::create();
+    if (!reactor) {
+        spdlog::error("epoll setup failed: {}", reactor.error());
+        return;
+    }
+    ConnectionPark park{
+        std::move(*reactor),
+        [&thread_pool, &park](std::unique_ptr<ParkedConnection> parked) {
+            thread_pool.async([&park, parked = std::move(parked)]() mutable {
+                resume_connection(park, std::move(parked));
+            });
+        },
+        config_.idle_timeout};
+    const std::jthread parking{[&park] {
+        const Result<void, std::string> result = park.run();
+        if (!result) {
+            spdlog::error("{}", result.error());
+        }
+    }};
 
     for (;;) {
         Connection connection = socket_.accept();
         if (connection.is_valid()) {
-            thread_pool.async([this, conn = std::move(connection)]() mutable {
-                handle_connection(router_, std::move(conn));
-            });
+            thread_pool.async(
+                [this, &park, conn = std::move(connection)]() mutable {
+                    resume_connection(
+                        park, std::make_unique<ParkedConnection>(
+                                  router_, config_, std::move(conn)));
+                });
         }
     }
 }
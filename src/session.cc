@@ -0,0 +1,615 @@
+#include "session.hh"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "chunked_decoder.hh"
+#include "receive_buffer.hh"
+#include "request_arena.hh"
+#include "request_parser.hh"
+#include "serializer.hh"
+#include "waxwing/file.hh"
+#include "waxwing/http.hh"
+#include "waxwing/request.hh"
+#include "waxwing/response.hh"
+#include "waxwing/result.hh"
+#include "waxwing/router.hh"
+#include "waxwing/str_util.hh"
+
+namespace waxwing::internal {
+namespace {
+/// Bytes a producer is asked for each time the output is taken, so a body
+/// is sent in batches instead of a call per piece
+constexpr size_t PRODUCTION_BATCH_SIZE = 64 * 1024;
+
+/// Output that's not taken yet past which requests wait, so a client that
+/// doesn't read the responses can't make them pile up
+constexpr size_t OUTPUT_LIMIT = 4 * PRODUCTION_BATCH_SIZE;
+
+/// HTTP/1.1 connections are persistent unless the client opts out, while
+/// HTTP/1.0 ones have to opt in
+bool wants_keep_alive(const Request& req, const bool http_1_0) {
+    const std::optional<std::string_view> connection =
+        req.header("connection");
+    if (!connection.has_value()) {
+        return !http_1_0;
+    }
+    if (has_connection_option(*connection, "close")) {
+        return false;
+    }
+    return !http_1_0 || has_connection_option(*connection, "keep-alive");
+}
+
+/// Run the part of a handler given by `call`, logging what it throws.
+/// Returns whether it succeeded
+template <typename F>
+bool run_handler(const Request& req, F&& call) {
+    try {
+        std::forward<F>(call)();
+        return true;
+    } catch (const std::exception& e) {
+        spdlog::error("handler for {} {} threw: {}",
+                      format_method(req.method()), req.target(), e.what());
+        return false;
+    }
+}
+
+/// Serialized right away, so it's allocated from the request memory
+Response internal_server_error() {
+    return ResponseBuilder{HttpStatusCode::InternalServerError_500,
+                           request_memory()}
+        .build();
+}
+
+size_t segment_size(const BodySegment& segment) noexcept {
+    if (const SharedBody* shared = std::get_if<SharedBody>(&segment)) {
+        return *shared == nullptr ? 0 : (*shared)->size();
+    }
+    if (const std::string* owned = std::get_if<std::string>(&segment)) {
+        return owned->size();
+    }
+    return std::get<std::string_view>(segment).size();
+}
+
+void append_segment(OutputBuffer& out, BodySegment&& segment) {
+    if (SharedBody* shared = std::get_if<SharedBody>(&segment)) {
+        out.append(std::move(*shared));
+    } else if (std::string* owned = std::get_if<std::string>(&segment)) {
+        out.append(std::move(*owned));
+    } else {
+        out.append_borrowed(std::get<std::string_view>(segment));
+    }
+}
+
+/// Serialize the head of `resp` and the body it holds, with `connection` as
+/// the value of the `Connection` header unless it's empty. A `produced` body
+/// only determines the framing, it's appended later. Without `send_body`
+/// the head is framed for the body all the same, as HEAD requests want
+void serialize_response(OutputBuffer& out, Response& resp,
+                        const std::string_view connection,
+                        const Session::Production* produced = nullptr,
+                        const bool send_body = true) {
+    HeadFields fields{.connection = connection};
+
+    // persistent connections need the length even when there's no body, or
+    // the client would be waiting for the connection to close
+    std::optional<FileRange> file_body = resp.take_file_body();
+    std::optional<std::string> body = resp.take_body();
+    std::vector<BodySegment> segments = resp.take_segments();
+    if (produced != nullptr) {
+        // without either the body ends when the connection is closed
+        fields.chunked = produced->chunked;
+        fields.content_length = produced->remaining;
+    } else if (may_have_body(resp.status())) {
+        size_t length = 0;
+        if (file_body.has_value()) {
+            length = file_body->length;
+        } else if (!segments.empty()) {
+            for (const BodySegment& segment : segments) {
+                length += segment_size(segment);
+            }
+        } else if (body.has_value()) {
+            length = body->size();
+        }
+        fields.content_length = length;
+    }
+
+    // the head is written right after the previous output, never copied
+    std::string& head = out.tail();
+    serialize_head(head, resp.status(), resp.headers(), fields);
+    // empty line is required even if the body is empty
+    head += "\r\n";
+
+    // large bodies are not copied, but sent from their own buffer
+    if (!send_body) {
+        return;
+    }
+    if (file_body.has_value()) {
+        out.append(std::move(*file_body));
+    } else if (!segments.empty()) {
+        for (BodySegment& segment : segments) {
+            append_segment(out, std::move(segment));
+        }
+    } else if (body.has_value()) {
+        out.append(std::move(*body));
+    }
+}
+}  // namespace
+
+Session::~Session() { release_input(); }
+
+void Session::feed(const std::string_view data) {
+    if (closing_) {
+        return;
+    }
+
+    // parse straight from the received data when nothing is buffered, so
+    // requests that arrive in one piece are never copied
+    if (input_.empty()) {
+        const size_t consumed = process(data);
+        if (!closing_ && consumed < data.size()) {
+            if (!input_.has_storage()) {
+                input_ = ReceiveBufferPool::local().acquire();
+            }
+            input_.append(data.substr(consumed));
+        }
+        return;
+    }
+
+    input_.append(data);
+    input_.consume(process(input_.data()));
+    release_input();
+}
+
+std::span<char> Session::input_buffer() {
+    // receiving less than this at a time would only waste system calls
+    constexpr size_t MIN_RECEIVE_SIZE = 4096;
+
+    if (!input_.has_storage()) {
+        input_ = ReceiveBufferPool::local().acquire();
+    }
+    return input_.prepare(MIN_RECEIVE_SIZE);
+}
+
+void Session::commit_input(const size_t n) {
+    input_.commit(n);
+    if (!closing_) {
+        input_.consume(process(input_.data()));
+    }
+    release_input();
+}
+
+bool Session::held_back() const noexcept {
+    return production_.has_value() || output_.size() >= OUTPUT_LIMIT;
+}
+
+bool Session::wants_input() const noexcept {
+    return !held_back() ||
+           input_.data().size() <
+               config_.max_request_line_size + config_.max_headers_size;
+}
+
+void Session::resume() {
+    if (!closing_ && !held_back() && !input_.empty()) {
+        input_.consume(process(input_.data()));
+        release_input();
+    }
+}
+
+void Session::release_input() noexcept {
+    if (input_.has_storage() && (input_.empty() || closing_)) {
+        ReceiveBufferPool::local().release(std::exchange(input_, {}));
+    }
+}
+
+size_t Session::process(const std::string_view data) {
+    size_t consumed = 0;
+    // routing of the request being parsed, kept only during this call since
+    // the parameters refer to `data`
+    std::optional<RoutingResult> route;
+    // responses have to go out in order, so the next request waits for the
+    // body being produced, and for the output to be taken
+    while (!closing_ && !held_back()) {
+        if (stream_.has_value()) {
+            consumed += stream(data.substr(consumed));
+            if (stream_.has_value()) {
+                break;
+            }
+            continue;
+        }
+
+        const std::string_view message = data.substr(consumed);
+        const Result<ParseStatus, ParseError> status = parser_.parse(message);
+        if (!status) {
+            reject(status.error());
+            return data.size();
+        }
+        const bool complete = *status == ParseStatus::Complete;
+        // requests are routed as soon as their head arrives, so the body of
+        // one that would be refused is never received
+        if (!complete && (admitted_ || !parser_.head_complete())) {
+            break;
+        }
+
+        // the request refers straight to the received data, which stays
+        // untouched until the response is serialized
+        header_fields_.clear();
+        for (const RequestParser::Header& header : parser_.headers()) {
+            header_fields_.push_back(HeaderField{header.name.in(message),
+                                                 header.value.in(message)});
+        }
+        const Request req{parser_.method(), parser_.target().in(message),
+                          header_fields_,
+                          complete ? parser_.body(message) : std::string_view{},
+                          complete ? parser_.trailers()
+                                   : std::span<const HeaderField>{}};
+        if (!route.has_value()) {
+            route.emplace(router_.route(req.method(), req.target()));
+        }
+
+        if (!admitted_) {
+            const bool received =
+                complete ||
+                (!parser_.chunked() &&
+                 message.size() - parser_.body_start() >=
+                     parser_.content_length());
+            if (!admit(req, *route, received)) {
+                return data.size();
+            }
+            admitted_ = true;
+
+            if (route->streaming_handler()) {
+                // the body is consumed from the input as it arrives, instead
+                // of being buffered in there
+                start_stream(req, *route,
+                             wants_keep_alive(req, parser_.http_1_0()),
+                             parser_.http_1_0());
+                consumed += parser_.body_start();
+                admitted_ = false;
+                route.reset();
+                parser_.reset();
+                continue;
+            }
+        }
+        if (!complete) {
+            // the body may have arrived along with the head
+            continue;
+        }
+
+        handle(req, *route, wants_keep_alive(req, parser_.http_1_0()),
+               parser_.http_1_0());
+        admitted_ = false;
+        route.reset();
+        consumed += parser_.length();
+        parser_.reset();
+    }
+    return consumed;
+}
+
+size_t Session::body_limit(const RoutingResult& route) const noexcept {
+    return route.config().max_body_size.value_or(config_.max_body_size);
+}
+
+bool Session::admit(const Request& req, const RoutingResult& route,
+                    const bool received) {
+    if (!route.found() && !received) {
+        // the rest of the request is never read, so the connection can't
+        // be reused
+        handle(req, route, false, parser_.http_1_0());
+        return false;
+    }
+
+    const Result<void, ParseError> allowed =
+        parser_.allow_body(body_limit(route));
+    if (!allowed) {
+        reject(allowed.error());
+        return false;
+    }
+
+    // clients asking for it hold the body back until they are told to go on
+    const std::optional<std::string_view> expect = req.header("expect");
+    if (!received && !parser_.http_1_0() && expect.has_value() &&
+        str_util::case_insensitive_eq(*expect, "100-continue")) {
+        output_.append(std::string_view{"HTTP/1.1 100 Continue\r\n\r\n"});
+    }
+    return true;
+}
+
+void Session::reject(const ParseError& error) {
+    spdlog::warn("rejecting request: {}", error.message);
+
+    const RequestArena::Scope arena{RequestArena::local()};
+    Response resp = ResponseBuilder{error.status, request_memory()}.build();
+    serialize_response(output_, resp, "close");
+    closing_ = true;
+}
+
+void Session::handle(const Request& req, const RoutingResult& route,
+                     const bool keep_alive, const bool http_1_0) {
+    if (const PreparedResponse* prepared = route.prepared()) {
+        respond(req, *prepared, keep_alive, http_1_0);
+        return;
+    }
+
+    // whatever the handler takes from the request memory is released once
+    // the response is serialized
+    const RequestArena::Scope arena{RequestArena::local()};
+
+    std::optional<Response> resp;
+    if (!run_handler(req, [&] {
+            if (const auto function = route.function()) {
+                resp.emplace(function(req, route.parameters()));
+            } else {
+                resp.emplace(route.handler()(req, route.parameters()));
+            }
+        })) {
+        resp.emplace(internal_server_error());
+    }
+    // a method that isn't allowed is answered with the ones that are
+    if (!route.found() && route.allowed_methods() != 0) {
+        resp->headers().insert("Allow", route.allow());
+    }
+    respond(req, *resp, keep_alive, http_1_0);
+}
+
+void Session::start_stream(const Request& req, const RoutingResult& route,
+                           const bool keep_alive, const bool http_1_0) {
+    std::unique_ptr<BodyConsumer> consumer;
+    if (!run_handler(req, [&] {
+            consumer = route.streaming_handler()(req, route.parameters());
+        }) ||
+        consumer == nullptr) {
+        // the body is never read, so the connection can't be reused
+        const RequestArena::Scope arena{RequestArena::local()};
+        Response resp = internal_server_error();
+        respond(req, resp, false, http_1_0);
+        return;
+    }
+
+    std::optional<ChunkedDecoder> decoder;
+    if (parser_.chunked()) {
+        decoder.emplace(config_);
+        decoder->reset(body_limit(route));
+    }
+    stream_.emplace(Stream{req.to_owned(), std::move(consumer),
+                           std::move(decoder), parser_.content_length(),
+                           keep_alive, http_1_0});
+}
+
+size_t Session::stream(const std::string_view data) {
+    Stream& current = *stream_;
+    size_t consumed = 0;
+    bool done = false;
+    if (current.decoder.has_value()) {
+        while (!done && consumed < data.size()) {
+            Result<ChunkedDecoder::Decoded, ParseError> decoded =
+                current.decoder->decode(data.substr(consumed));
+            if (!decoded) {
+                reject(decoded.error());
+                stream_.reset();
+                return data.size();
+            }
+            consumed += decoded->consumed;
+            done = decoded->done;
+            if (!decoded->data.empty() && !deliver(current, decoded->data)) {
+                return data.size();
+            }
+        }
+    } else {
+        consumed = std::min(current.remaining, data.size());
+        if (consumed > 0 && !deliver(current, data.substr(0, consumed))) {
+            return data.size();
+        }
+        current.remaining -= consumed;
+        done = current.remaining == 0;
+    }
+    if (!done) {
+        return consumed;
+    }
+
+    // the consumer goes away within the scope too, in case it kept any of
+    // the memory
+    const RequestArena::Scope arena{RequestArena::local()};
+    std::optional<Response> resp;
+    if (!run_handler(current.head, [&] {
+            if (current.decoder.has_value() &&
+                !current.decoder->trailers().empty()) {
+                current.consumer->consume_trailers(current.decoder->trailers());
+            }
+            resp.emplace(current.consumer->finish());
+        })) {
+        resp.emplace(internal_server_error());
+    }
+    respond(current.head, *resp, current.keep_alive, current.http_1_0);
+    stream_.reset();
+    return consumed;
+}
+
+bool Session::deliver(Stream& current, const std::string_view chunk) {
+    if (run_handler(current.head, [&] {
+            current.consumer->consume(std::span{chunk.data(), chunk.size()});
+        })) {
+        return true;
+    }
+
+    // the rest of the body is never read, so the connection can't be reused
+    const RequestArena::Scope arena{RequestArena::local()};
+    Response resp = internal_server_error();
+    respond(current.head, resp, false, current.http_1_0);
+    stream_.reset();
+    return false;
+}
+
+void Session::respond(const Request& req, Response& resp,
+                      const bool keep_alive, const bool http_1_0) {
+    std::optional<ProducedBody> produced = resp.take_produced_body();
+    if (!may_have_body(resp.status())) {
+        produced.reset();
+    }
+    // the next response on the connection would be read as the body
+    const bool send_body = req.method() != HttpMethod::Head;
+    // HTTP/1.0 clients don't know the chunked coding, so a body of unknown
+    // length can only end with the connection
+    const bool delimited_by_close = send_body && produced.has_value() &&
+                                    !produced->length.has_value() && http_1_0;
+
+    const std::optional<std::string_view> connection =
+        resp.headers().get("connection");
+    const bool handler_closes =
+        connection.has_value() && has_connection_option(*connection, "close");
+    conclude(req, resp.status(), keep_alive && !delimited_by_close,
+             handler_closes);
+    const std::string_view option = connection_option(http_1_0);
+    if (!produced.has_value()) {
+        serialize_response(output_, resp, option, nullptr, send_body);
+        return;
+    }
+    Production production{std::move(produced->producer), produced->length,
+                          !produced->length.has_value() && !http_1_0};
+    if (!send_body) {
+        // the producer is never asked for the body
+        serialize_response(output_, resp, option, &production, false);
+        return;
+    }
+    production_.emplace(std::move(production));
+    serialize_response(output_, resp, option, &*production_);
+}
+
+void Session::respond(const Request& req, const PreparedResponse& resp,
+                      const bool keep_alive, const bool http_1_0) {
+    conclude(req, resp.status(), keep_alive, resp.closes());
+    output_.append(resp.head());
+    std::string& patched = output_.tail();
+    if (resp.adds_date()) {
+        patched += date_header();
+    }
+    const std::string_view option = connection_option(http_1_0);
+    if (!option.empty()) {
+        patched += "Connection: ";
+        patched += option;
+        patched += "\r\n";
+    }
+    if (req.method() == HttpMethod::Head) {
+        // the tail starts with the empty line that ends the head
+        patched += "\r\n";
+        return;
+    }
+    output_.append(resp.tail());
+}
+
+void Session::conclude(const Request& req, const HttpStatusCode status,
+                       const bool keep_alive, const bool response_closes) {
+    ++requests_served_;
+    const bool limit_reached =
+        config_.max_requests_per_connection != 0 &&
+        requests_served_ >= config_.max_requests_per_connection;
+    closing_ = !keep_alive || limit_reached || response_closes;
+
+    spdlog::info("{} {} -> {}", format_method(req.method()), req.target(),
+                 format_status_code(status));
+}
+
+std::string_view Session::connection_option(
+    const bool http_1_0) const noexcept {
+    if (closing_) {
+        return "close";
+    }
+    // persistence is the default only since HTTP/1.1
+    return http_1_0 ? "keep-alive" : "";
+}
+
+void Session::produce() {
+    // the producer is asked for more only once the previous output has been
+    // taken to be sent, which is what bounds the memory a slow client costs
+    size_t produced = 0;
+    while (production_.has_value() && produced < PRODUCTION_BATCH_SIZE) {
+        Production& current = *production_;
+        std::optional<std::string> piece;
+        try {
+            piece = current.producer();
+        } catch (const std::exception& e) {
+            // the head is out already, so the client can only tell by the
+            // connection closing before the body is complete
+            spdlog::error("body producer threw: {}", e.what());
+            abort_production();
+            return;
+        }
+
+        // nothing would ever wake a producer that has nothing yet, so an
+        // empty piece can only mean the end
+        if (!piece.has_value() || piece->empty()) {
+            if (current.remaining.value_or(0) != 0) {
+                spdlog::error("produced body is {} bytes short",
+                              *current.remaining);
+                abort_production();
+                return;
+            }
+            if (current.chunked) {
+                output_.append(std::string_view{"0\r\n\r\n"});
+            }
+            production_.reset();
+
+            // requests pipelined behind this one are handled only now
+            resume();
+            continue;
+        }
+
+        const size_t size = piece->size();
+        if (current.remaining.has_value()) {
+            if (size > *current.remaining) {
+                spdlog::error("produced body exceeds its declared length");
+                abort_production();
+                return;
+            }
+            *current.remaining -= size;
+        }
+        if (current.chunked) {
+            std::array<char, 20> size_line{};
+            char* const end = std::to_chars(size_line.data(),
+                                            size_line.data() + 16, size, 16)
+                                  .ptr;
+            end[0] = '\r';
+            end[1] = '\n';
+            output_.append(std::string_view{size_line.data(), end + 2});
+            output_.append(std::move(*piece));
+            output_.append(std::string_view{"\r\n"});
+        } else {
+            output_.append(std::move(*piece));
+        }
+        produced += size;
+    }
+}
+
+void Session::abort_production() noexcept {
+    production_.reset();
+    closing_ = true;
+    release_input();
+}
+
+bool Session::has_output() const noexcept {
+    return !output_.empty() || production_.has_value();
+}
+
+OutputBuffer Session::take_output() {
+    produce();
+    OutputBuffer output = std::exchange(output_, {});
+    // requests that waited for the output to be taken
+    resume();
+    return output;
+}
+
+bool Session::should_close() const noexcept { return closing_; }
+}  // namespace waxwing::internal
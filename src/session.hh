@@ -0,0 +1,142 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "chunked_decoder.hh"
+#include "output_buffer.hh"
+#include "receive_buffer.hh"
+#include "request_parser.hh"
+#include "waxwing/config.hh"
+#include "waxwing/request.hh"
+#include "waxwing/router.hh"
+
+namespace waxwing::internal {
+/// Protocol state of a single client connection. It knows nothing about the
+/// way bytes travel to and from the socket, so every serving mode shares it:
+/// received data is fed in and serialized responses are taken out
+class Session final {
+public:
+    /// Response body being produced while it's sent
+    struct Production {
+        BodyProducer producer;
+        // bytes left of a body with a known length
+        std::optional<size_t> remaining;
+        bool chunked;
+    };
+
+private:
+    const Router& router_;
+    const ServerConfig& config_;
+    // taken from the pool only while there is unprocessed input
+    ReceiveBuffer input_;
+    // parser state of the request at the beginning of the input
+    RequestParser parser_;
+    // header fields of the request being handled, kept to reuse the storage
+    std::vector<HeaderField> header_fields_;
+    OutputBuffer output_;
+    size_t requests_served_ = 0;
+
+    /// Request of a streaming route whose body is being received
+    struct Stream {
+        // copied, since the head is consumed from the input right away
+        Request head;
+        std::unique_ptr<BodyConsumer> consumer;
+        // set for chunked bodies, otherwise the length is known
+        std::optional<ChunkedDecoder> decoder;
+        size_t remaining;
+        bool keep_alive;
+        bool http_1_0;
+    };
+    std::optional<Stream> stream_;
+    std::optional<Production> production_;
+
+    // the head of the request being received was routed and its body is
+    // worth waiting for
+    bool admitted_ = false;
+    bool closing_ = false;
+
+    /// Whether requests wait for a produced body, or for the output to be
+    /// taken
+    bool held_back() const noexcept;
+    /// Handle the requests that were held back, once they don't have to be
+    void resume();
+    /// Handle every complete request from the beginning of `data`, returning
+    /// the number of consumed bytes
+    size_t process(std::string_view data);
+    /// Decide whether the body of `req` is worth receiving, once its head is
+    /// parsed. Requests without a route or with a too large body are
+    /// answered right away and the connection is closed, unless the body
+    /// is already `received`
+    bool admit(const Request& req, const RoutingResult& route, bool received);
+    /// Largest body `route` accepts, zero means no limit
+    size_t body_limit(const RoutingResult& route) const noexcept;
+    /// `keep_alive` is what the client asked for, the connection may still be
+    /// closed after the response
+    void handle(const Request& req, const RoutingResult& route,
+                bool keep_alive, bool http_1_0);
+    /// Create the consumer of the body of `req`, for a streaming `route`
+    void start_stream(const Request& req, const RoutingResult& route,
+                      bool keep_alive, bool http_1_0);
+    /// Hand the body at the beginning of `data` over to the consumer,
+    /// returning the number of consumed bytes
+    size_t stream(std::string_view data);
+    /// Hand `chunk` over to the consumer, answering with 500 if it throws.
+    /// Returns whether it succeeded
+    bool deliver(Stream& current, std::string_view chunk);
+    /// Queue `resp` to `req` and decide whether the connection stays open
+    void respond(const Request& req, Response& resp, bool keep_alive,
+                 bool http_1_0);
+    void respond(const Request& req, const PreparedResponse& resp,
+                 bool keep_alive, bool http_1_0);
+    /// Count the request, log it and decide whether the connection stays
+    /// open, unless the client or the response don't want it to
+    void conclude(const Request& req, HttpStatusCode status, bool keep_alive,
+                  bool response_closes);
+    /// Value of the `Connection` header of the concluded response, none if
+    /// it's empty
+    std::string_view connection_option(bool http_1_0) const noexcept;
+    /// Append the next batch of the produced body to the output
+    void produce();
+    /// Give up on a body that failed to be produced, closing the connection
+    void abort_production() noexcept;
+    /// Answer a request that couldn't be parsed and close the connection
+    void reject(const ParseError& error);
+    /// Give the input buffer back to the pool unless it holds unprocessed data
+    void release_input() noexcept;
+
+public:
+    Session(const Router& router, const ServerConfig& config) noexcept
+        : router_{router}, config_{config}, parser_{config} {}
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    /// Process data received elsewhere
+    void feed(std::string_view data);
+
+    /// Space to receive data into directly, without copying it afterwards.
+    /// Has to be followed by `commit_input`, even if nothing was received
+    std::span<char> input_buffer();
+    /// Process `n` bytes received into the `input_buffer`
+    void commit_input(size_t n);
+    /// Whether more data should be received. Requests wait while a produced
+    /// body is being sent, or while too much output isn't taken, so until
+    /// then no more than a request head's worth of them is buffered, and the
+    /// connection should stop receiving
+    bool wants_input() const noexcept;
+
+    bool has_output() const noexcept;
+    /// Output to send. A produced body is generated in batches, each time
+    /// the output is taken, so it has to be taken again once it's sent for
+    /// as long as `has_output` says so
+    OutputBuffer take_output();
+
+    /// Whether the connection should be closed once the output is sent
+    bool should_close() const noexcept;
+};
+}  // namespace waxwing::internal
@@ -0,0 +1,319 @@
+#include "static_files.hh"
+
+#include <fmt/core.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "waxwing/file.hh"
+#include "waxwing/http.hh"
+#include "waxwing/request.hh"
+#include "waxwing/response.hh"
+#include "waxwing/result.hh"
+#include "waxwing/str_split.hh"
+#include "waxwing/str_util.hh"
+
+namespace waxwing::internal {
+namespace {
+/// Parse a whole decimal number, returns an empty optional if anything but
+/// digits is present
+std::optional<size_t> parse_number(const std::string_view s) {
+    size_t value = 0;
+    const auto [end, error] = std::from_chars(s.begin(), s.end(), value);
+    if (s.empty() || error != std::errc{} || end != s.end()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::optional<char> hex_digit(const char c) {
+    if ('0' <= c && c <= '9') {
+        return static_cast<char>(c - '0');
+    }
+    if ('a' <= c && c <= 'f') {
+        return static_cast<char>(c - 'a' + 10);
+    }
+    if ('A' <= c && c <= 'F') {
+        return static_cast<char>(c - 'A' + 10);
+    }
+    return std::nullopt;
+}
+
+/// Decode the percent encoded path component. Returns an empty optional if
+/// it's malformed
+std::optional<std::string> percent_decode(const std::string_view component) {
+    std::string result;
+    result.reserve(component.size());
+    for (size_t i = 0; i < component.size(); ++i) {
+        if (component[i] != '%') {
+            result += component[i];
+            continue;
+        }
+        if (i + 2 >= component.size()) {
+            return std::nullopt;
+        }
+        const std::optional<char> high = hex_digit(component[i + 1]);
+        const std::optional<char> low = hex_digit(component[i + 2]);
+        if (!high || !low) {
+            return std::nullopt;
+        }
+        result += static_cast<char>(*high << 4 | *low);
+        i += 2;
+    }
+    return result;
+}
+
+bool same_time(const timespec& lhs, const timespec& rhs) noexcept {
+    return lhs.tv_sec == rhs.tv_sec && lhs.tv_nsec == rhs.tv_nsec;
+}
+
+Response not_found() {
+    return ResponseBuilder{HttpStatusCode::NotFound_404}.build();
+}
+}  // namespace
+
+// ===== FileCache =====
+std::shared_ptr<const File> FileCache::lookup(const std::string& path) {
+    auto iter = index_.find(path);
+    if (iter == index_.end()) {
+        return nullptr;
+    }
+    const Entries::iterator entry = iter->second;
+
+    const Clock::time_point now = Clock::now();
+    if (now - entry->checked_at >= ttl_) {
+        struct stat info {};
+        const bool unchanged =
+            ::stat(path.c_str(), &info) == 0 && info.st_dev == entry->device &&
+            info.st_ino == entry->inode &&
+            static_cast<size_t>(info.st_size) == entry->size &&
+            same_time(info.st_mtim, entry->modified);
+        if (!unchanged) {
+            erase(entry);
+            return nullptr;
+        }
+        entry->checked_at = now;
+    }
+
+    entries_.splice(entries_.begin(), entries_, entry);
+    return entry->file;
+}
+
+void FileCache::erase(const Entries::iterator entry) noexcept {
+    index_.erase(entry->path);
+    entries_.erase(entry);
+}
+
+Result<std::shared_ptr<const File>, std::string> FileCache::open(
+    const std::string& path) {
+    {
+        std::lock_guard lock{mutex_};
+        if (std::shared_ptr<const File> file = lookup(path)) {
+            return file;
+        }
+    }
+
+    // opening may block on the disk, so other threads are not held up
+    Result<File, std::string> opened = File::open(path);
+    if (!opened) {
+        return Error{std::move(opened.error())};
+    }
+    struct stat info {};
+    if (::fstat(opened->fd(), &info) < 0) {
+        return Error{std::make_error_code(std::errc{errno}).message()};
+    }
+    auto file = std::make_shared<const File>(std::move(opened.value()));
+    if (capacity_ == 0) {
+        return file;
+    }
+
+    std::lock_guard lock{mutex_};
+    // another thread might have opened it in the meantime
+    auto iter = index_.find(path);
+    if (iter != index_.end()) {
+        erase(iter->second);
+    }
+    if (entries_.size() >= capacity_) {
+        erase(std::prev(entries_.end()));
+    }
+
+    entries_.push_front(Entry{path, file, info.st_dev, info.st_ino,
+                              static_cast<size_t>(info.st_size), info.st_mtim,
+                              Clock::now()});
+    index_.emplace(entries_.front().path, entries_.begin());
+    return file;
+}
+
+// ===== free functions =====
+Result<std::optional<ByteRange>, std::string> parse_range(
+    std::string_view value, const size_t size) {
+    constexpr std::string_view UNIT = "bytes=";
+
+    value = str_util::trim(value);
+    if (!value.starts_with(UNIT) ||
+        value.find(',') != std::string_view::npos) {
+        return std::optional<ByteRange>{};
+    }
+    value = value.substr(UNIT.size());
+
+    const size_t dash_pos = value.find('-');
+    if (dash_pos == std::string_view::npos) {
+        return std::optional<ByteRange>{};
+    }
+    const std::string_view first = str_util::trim(value.substr(0, dash_pos));
+    const std::string_view last = str_util::trim(value.substr(dash_pos + 1));
+
+    // suffix range, the last `n` bytes
+    if (first.empty()) {
+        const std::optional<size_t> suffix = parse_number(last);
+        if (!suffix) {
+            return std::optional<ByteRange>{};
+        }
+        if (*suffix == 0 || size == 0) {
+            return Error{std::string{"empty suffix range"}};
+        }
+        return std::optional<ByteRange>{
+            ByteRange{size - std::min(*suffix, size), size - 1}};
+    }
+
+    const std::optional<size_t> first_byte = parse_number(first);
+    const std::optional<size_t> last_byte =
+        last.empty() ? std::optional<size_t>{SIZE_MAX} : parse_number(last);
+    if (!first_byte || !last_byte || *last_byte < *first_byte) {
+        return std::optional<ByteRange>{};
+    }
+    if (*first_byte >= size) {
+        return Error{std::string{"range starts past the end"}};
+    }
+    return std::optional<ByteRange>{
+        ByteRange{*first_byte, std::min(*last_byte, size - 1)}};
+}
+
+std::optional<std::string> resolve_path(std::string_view root,
+                                        std::string_view path) {
+    path = path.substr(0, path.find_first_of("?#"));
+
+    std::string result{root};
+    while (result.ends_with('/')) {
+        result.pop_back();
+    }
+
+    auto component_split = str_util::split(path, '/');
+    for (std::optional<std::string_view> component = component_split.next();
+         component.has_value(); component = component_split.next()) {
+        if (component->empty() || *component == ".") {
+            continue;
+        }
+        const std::optional<std::string> decoded = percent_decode(*component);
+        // decoded separators could smuggle in components the checks above
+        // don't see
+        if (!decoded || *decoded == "." || *decoded == ".." ||
+            decoded->find_first_of(std::string_view{"/\0", 2}) !=
+                std::string::npos) {
+            return std::nullopt;
+        }
+        result += '/';
+        result += *decoded;
+    }
+
+    if (path.empty() || path.ends_with('/')) {
+        result += "/index.html";
+    }
+    return result;
+}
+
+std::string_view content_type_of(const std::string_view path) noexcept {
+    constexpr std::array<std::pair<std::string_view, std::string_view>, 16>
+        TYPES{{
+            {"html", content_type::html},
+            {"htm", content_type::html},
+            {"txt", content_type::plaintext},
+            {"js", content_type::javascript},
+            {"mjs", content_type::javascript},
+            {"css", content_type::css},
+            {"json", content_type::json},
+            {"csv", content_type::csv},
+            {"mp3", content_type::mp3},
+            {"mp4", content_type::mp4},
+            {"ico", content_type::ico},
+            {"jpg", content_type::jpeg},
+            {"jpeg", content_type::jpeg},
+            {"png", content_type::png},
+            {"gif", content_type::gif},
+            {"svg", content_type::svg},
+        }};
+
+    const std::string_view name = path.substr(path.rfind('/') + 1);
+    const size_t dot_pos = name.rfind('.');
+    if (dot_pos != std::string_view::npos) {
+        const std::string_view extension = name.substr(dot_pos + 1);
+        for (const auto& [known, type] : TYPES) {
+            if (str_util::case_insensitive_eq(extension, known)) {
+                return type;
+            }
+        }
+    }
+    return content_type::octet_stream;
+}
+
+RequestHandler static_files_handler(std::string root) {
+    // handlers get copied around, but all of the copies share the cache
+    auto cache = std::make_shared<FileCache>();
+
+    return [root = std::move(root), cache](const Request& req,
+                                           const PathParameters params) {
+        const std::optional<std::string> path =
+            params.empty() ? std::nullopt : resolve_path(root, params[0]);
+        if (!path.has_value()) {
+            return not_found();
+        }
+        Result<std::shared_ptr<const File>, std::string> file =
+            cache->open(*path);
+        if (!file) {
+            return not_found();
+        }
+        const size_t size = (*file)->size();
+
+        std::optional<ByteRange> range;
+        if (const std::optional<std::string_view> header = req.header("range");
+            header.has_value()) {
+            Result<std::optional<ByteRange>, std::string> parsed =
+                parse_range(*header, size);
+            if (!parsed) {
+                return ResponseBuilder{HttpStatusCode::RangeNotSatisfiable_416}
+                    .header("Content-Range", fmt::format("bytes */{}", size))
+                    .build();
+            }
+            range = *parsed;
+        }
+
+        ResponseBuilder builder{range.has_value()
+                                    ? HttpStatusCode::PartialContent_206
+                                    : HttpStatusCode::Ok_200};
+        builder.content_type(content_type_of(*path))
+            .header("Accept-Ranges", "bytes");
+        if (range.has_value()) {
+            builder.header("Content-Range",
+                           fmt::format("bytes {}-{}/{}", range->first,
+                                       range->last, size));
+            builder.file(FileRange{std::move(file.value()), range->first,
+                                   range->length()});
+        } else {
+            builder.file(FileRange{std::move(file.value()), 0, size});
+        }
+        return std::move(builder).build();
+    };
+}
+}  // namespace waxwing::internal
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "waxwing/file.hh"
+#include "waxwing/result.hh"
+#include "waxwing/router.hh"
+
+namespace waxwing::internal {
+/// Least recently used open files, so serving a popular file doesn't open it
+/// for every request. Entries are checked against the file system once they
+/// get older than `ttl`, and replaced if the file has changed
+class FileCache final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Entry {
+        std::string path;
+        std::shared_ptr<const File> file;
+        // identity of the opened file, changes when it's replaced or modified
+        dev_t device;
+        ino_t inode;
+        size_t size;
+        timespec modified;
+        Clock::time_point checked_at;
+    };
+    using Entries = std::list<Entry>;
+
+    std::mutex mutex_;
+    // most recently used first
+    Entries entries_;
+    std::unordered_map<std::string_view, Entries::iterator> index_;
+    size_t capacity_;
+    Clock::duration ttl_;
+
+    /// Cached entry for `path` that is still valid, moved to the front.
+    /// Expects the mutex to be locked
+    std::shared_ptr<const File> lookup(const std::string& path);
+    void erase(Entries::iterator entry) noexcept;
+
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 256;
+    static constexpr Clock::duration DEFAULT_TTL = std::chrono::seconds{1};
+
+    explicit FileCache(size_t capacity = DEFAULT_CAPACITY,
+                       Clock::duration ttl = DEFAULT_TTL) noexcept
+        : capacity_{capacity}, ttl_{ttl} {}
+
+    Result<std::shared_ptr<const File>, std::string> open(
+        const std::string& path);
+};
+
+/// Byte range of a file, both ends inclusive like in the `Range` header
+struct ByteRange {
+    size_t first;
+    size_t last;
+
+    size_t length() const noexcept { return last - first + 1; }
+};
+
+/// Parse the value of a `Range` header for a file of `size` bytes. Returns
+/// an empty optional if the whole file should be sent, as the header is
+/// malformed or asks for more ranges than one. Returns an error if the range
+/// can't be satisfied
+Result<std::optional<ByteRange>, std::string> parse_range(
+    std::string_view value, size_t size);
+
+/// Path of the file under `root` that `path` refers to. Returns an empty
+/// optional if it would escape `root`
+std::optional<std::string> resolve_path(std::string_view root,
+                                        std::string_view path);
+
+std::string_view content_type_of(std::string_view path) noexcept;
+
+/// Handler for a prefix route, serving the file the path parameter refers to
+RequestHandler static_files_handler(std::string root);
+}  // namespace waxwing::internal
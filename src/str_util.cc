@@ -27,7 +27,7 @@ std::string_view trim(std::string_view s) { return rtrim(ltrim(s)); }
 bool case_insensitive_eq(std::string_view lhs, std::string_view rhs) {
     return std::equal(lhs.cbegin(), lhs.cend(), rhs.cbegin(), rhs.cend(),
                       [](const char a, const char b) {
-                          return std::tolower(a) == std::tolower(b);
+                          return to_lower_ascii(a) == to_lower_ascii(b);
                       });
 }
 }  // namespace waxwing::str_util
@@ -0,0 +1,378 @@
+#include "uring.hh"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "waxwing/result.hh"
+
+namespace waxwing::internal::uring {
+namespace {
+std::string errno_message(const int error) {
+    return std::make_error_code(std::errc{error}).message();
+}
+
+int sys_setup(const unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_enter(const int fd, const unsigned to_submit,
+              const unsigned min_complete, const unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+                                      min_complete, flags, nullptr, 0));
+}
+
+int sys_register(const int fd, const unsigned opcode, const void* arg,
+                 const unsigned nr_args) {
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+T* at_offset(void* base, const size_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+}  // namespace
+
+// ===== Ring =====
+Ring::~Ring() {
+    if (sqes_ != nullptr) {
+        ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ptr_ != nullptr && cq_ptr_ != rings_ptr_) {
+        ::munmap(cq_ptr_, cq_size_);
+    }
+    if (rings_ptr_ != nullptr) {
+        ::munmap(rings_ptr_, rings_size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+Ring::Ring(Ring&& other) noexcept { swap(other); }
+
+Ring& Ring::operator=(Ring&& rhs) noexcept {
+    swap(rhs);
+    return *this;
+}
+
+void Ring::swap(Ring& other) noexcept {
+    std::swap(fd_, other.fd_);
+    std::swap(rings_ptr_, other.rings_ptr_);
+    std::swap(rings_size_, other.rings_size_);
+    std::swap(cq_ptr_, other.cq_ptr_);
+    std::swap(cq_size_, other.cq_size_);
+    std::swap(sqes_, other.sqes_);
+    std::swap(sqes_size_, other.sqes_size_);
+    std::swap(sq_head_, other.sq_head_);
+    std::swap(sq_tail_, other.sq_tail_);
+    std::swap(sq_mask_, other.sq_mask_);
+    std::swap(sq_entries_, other.sq_entries_);
+    std::swap(cq_head_, other.cq_head_);
+    std::swap(cq_tail_, other.cq_tail_);
+    std::swap(cq_mask_, other.cq_mask_);
+    std::swap(cqes_, other.cqes_);
+    std::swap(sqe_tail_, other.sqe_tail_);
+    std::swap(reaped_, other.reaped_);
+    std::swap(reaped_head_, other.reaped_head_);
+}
+
+Result<Ring, std::string> Ring::create(const unsigned entries) {
+    // completions of multishot operations easily outnumber submissions
+    constexpr unsigned CQ_ENTRIES_FACTOR = 4;
+
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER |
+                   IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = entries * CQ_ENTRIES_FACTOR;
+
+    int fd = sys_setup(entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        // older kernels do not know about task running optimizations
+        params = io_uring_params{};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * CQ_ENTRIES_FACTOR;
+        fd = sys_setup(entries, &params);
+    }
+    if (fd < 0) {
+        return Error{errno_message(errno)};
+    }
+
+    Ring ring;
+    ring.fd_ = fd;
+
+    const size_t sq_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const size_t cq_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+    ring.rings_size_ = single_mmap ? std::max(sq_size, cq_size) : sq_size;
+    ring.rings_ptr_ =
+        ::mmap(nullptr, ring.rings_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring.rings_ptr_ == MAP_FAILED) {
+        ring.rings_ptr_ = nullptr;
+        return Error{errno_message(errno)};
+    }
+
+    if (single_mmap) {
+        ring.cq_ptr_ = ring.rings_ptr_;
+        ring.cq_size_ = ring.rings_size_;
+    } else {
+        ring.cq_size_ = cq_size;
+        ring.cq_ptr_ =
+            ::mmap(nullptr, ring.cq_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring.cq_ptr_ == MAP_FAILED) {
+            ring.cq_ptr_ = nullptr;
+            return Error{errno_message(errno)};
+        }
+    }
+
+    ring.sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, ring.sqes_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return Error{errno_message(errno)};
+    }
+    ring.sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    ring.sq_head_ = at_offset<unsigned>(ring.rings_ptr_, params.sq_off.head);
+    ring.sq_tail_ = at_offset<unsigned>(ring.rings_ptr_, params.sq_off.tail);
+    ring.sq_mask_ =
+        *at_offset<unsigned>(ring.rings_ptr_, params.sq_off.ring_mask);
+    ring.sq_entries_ = params.sq_entries;
+
+    ring.cq_head_ = at_offset<unsigned>(ring.cq_ptr_, params.cq_off.head);
+    ring.cq_tail_ = at_offset<unsigned>(ring.cq_ptr_, params.cq_off.tail);
+    ring.cq_mask_ = *at_offset<unsigned>(ring.cq_ptr_, params.cq_off.ring_mask);
+    ring.cqes_ = at_offset<io_uring_cqe>(ring.cq_ptr_, params.cq_off.cqes);
+
+    // submission entries are always used in order, so the indirection array
+    // is filled with an identity mapping once
+    unsigned* sq_array =
+        at_offset<unsigned>(ring.rings_ptr_, params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; ++i) {
+        sq_array[i] = i;
+    }
+    ring.sqe_tail_ = *ring.sq_tail_;
+
+    return ring;
+}
+
+int Ring::fd() const noexcept { return fd_; }
+
+io_uring_sqe& Ring::next_sqe() {
+    const std::atomic_ref<unsigned> head_ref{*sq_head_};
+    while (sqe_tail_ - head_ref.load(std::memory_order_acquire) >=
+           sq_entries_) {
+        // the queue is full, hand the entries over to the kernel
+        const Result<Submitted, std::string> result = submit_and_wait(0);
+        if (!result) {
+            throw std::runtime_error(result.error());
+        }
+        // the kernel takes no more until there's room for the completions,
+        // retrying without any would never end
+        if (*result == Submitted::Busy && reap() == 0) {
+            throw std::runtime_error(
+                "submission queue is full and the kernel is busy");
+        }
+    }
+
+    io_uring_sqe& sqe = sqes_[sqe_tail_ & sq_mask_];
+    ++sqe_tail_;
+    std::memset(&sqe, 0, sizeof(sqe));
+    return sqe;
+}
+
+Result<Submitted, std::string> Ring::enter(const unsigned to_submit,
+                                      const unsigned wait_nr) {
+    const unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    for (;;) {
+        if (sys_enter(fd_, to_submit, wait_nr, flags) >= 0) {
+            return Submitted::Yes;
+        }
+
+        switch (errno) {
+            case EINTR:
+                continue;
+            case EAGAIN:
+            case EBUSY:
+                // completion queue is overflown, caller has to reap it first
+                return Submitted::Busy;
+            default:
+                return Error{errno_message(errno)};
+        }
+    }
+}
+
+unsigned Ring::reap() {
+    std::atomic_ref<unsigned> head_ref{*cq_head_};
+    unsigned head = head_ref.load(std::memory_order_relaxed);
+    const unsigned tail =
+        std::atomic_ref<unsigned>{*cq_tail_}.load(std::memory_order_acquire);
+
+    unsigned count = 0;
+    for (; head != tail; ++head, ++count) {
+        reaped_.push_back(cqes_[head & cq_mask_]);
+    }
+    head_ref.store(head, std::memory_order_release);
+    return count;
+}
+
+Result<Submitted, std::string> Ring::submit_and_wait(const unsigned wait_nr) {
+    // entries the kernel refused stay published, so everything past its
+    // head is submitted
+    std::atomic_ref<unsigned> tail_ref{*sq_tail_};
+    tail_ref.store(sqe_tail_, std::memory_order_release);
+    const unsigned to_submit =
+        sqe_tail_ -
+        std::atomic_ref<unsigned>{*sq_head_}.load(std::memory_order_acquire);
+
+    if (to_submit == 0 && wait_nr == 0) {
+        return Submitted::Yes;
+    }
+    return enter(to_submit, wait_nr);
+}
+
+Result<void, std::string> Ring::register_sparse_files(const unsigned count) {
+    io_uring_rsrc_register reg{};
+    reg.nr = count;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+
+    if (sys_register(fd_, IORING_REGISTER_FILES2, &reg, sizeof(reg)) < 0) {
+        return Error{errno_message(errno)};
+    }
+    return {};
+}
+
+Result<void, std::string> Ring::register_buffer_ring(io_uring_buf_ring* ring,
+                                                     const unsigned entries,
+                                                     const uint16_t group) {
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = entries;
+    reg.bgid = group;
+
+    if (sys_register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return Error{errno_message(errno)};
+    }
+    return {};
+}
+
+// ===== BufferRing =====
+BufferRing::~BufferRing() {
+    if (buffers_ring_ == nullptr) {
+        return;
+    }
+
+    io_uring_buf_reg reg{};
+    reg.bgid = group_;
+    sys_register(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    ::munmap(buffers_ring_, ring_size_);
+}
+
+BufferRing::BufferRing(BufferRing&& other) noexcept { swap(other); }
+
+BufferRing& BufferRing::operator=(BufferRing&& rhs) noexcept {
+    swap(rhs);
+    return *this;
+}
+
+void BufferRing::swap(BufferRing& other) noexcept {
+    std::swap(ring_fd_, other.ring_fd_);
+    std::swap(buffers_ring_, other.buffers_ring_);
+    std::swap(ring_size_, other.ring_size_);
+    std::swap(storage_, other.storage_);
+    std::swap(entries_, other.entries_);
+    std::swap(buffer_size_, other.buffer_size_);
+    std::swap(group_, other.group_);
+    std::swap(pending_, other.pending_);
+}
+
+Result<BufferRing, std::string> BufferRing::create(Ring& ring,
+                                                   const uint16_t group,
+                                                   const unsigned entries,
+                                                   const unsigned buffer_size) {
+    BufferRing result;
+    result.ring_size_ = entries * sizeof(io_uring_buf);
+
+    // ring memory has to be page aligned, which `mmap` guarantees
+    void* ptr = ::mmap(nullptr, result.ring_size_, PROT_READ | PROT_WRITE,
+                       MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return Error{errno_message(errno)};
+    }
+    auto* buffers_ring = static_cast<io_uring_buf_ring*>(ptr);
+
+    const Result<void, std::string> registration =
+        ring.register_buffer_ring(buffers_ring, entries, group);
+    if (!registration) {
+        ::munmap(ptr, result.ring_size_);
+        return Error{registration.error()};
+    }
+
+    result.ring_fd_ = ring.fd();
+    result.buffers_ring_ = buffers_ring;
+    result.storage_ = std::make_unique<char[]>(entries * buffer_size);
+    result.entries_ = entries;
+    result.buffer_size_ = buffer_size;
+    result.group_ = group;
+
+    for (unsigned i = 0; i < entries; ++i) {
+        result.push(static_cast<uint16_t>(i));
+    }
+    result.publish();
+
+    return result;
+}
+
+uint16_t BufferRing::group() const noexcept { return group_; }
+
+std::string_view BufferRing::get(const uint16_t id,
+                                 const size_t len) const noexcept {
+    return {storage_.get() + static_cast<size_t>(id) * buffer_size_, len};
+}
+
+void BufferRing::push(const uint16_t id) noexcept {
+    const uint16_t tail =
+        std::atomic_ref<uint16_t>{buffers_ring_->tail}.load(
+            std::memory_order_relaxed);
+    // buffers pushed before publishing are placed right after the tail
+    const unsigned index = (tail + pending_) & (entries_ - 1);
+    ++pending_;
+
+    // `bufs` member can't be used, in C++ the empty struct preceding the
+    // flexible array takes space and shifts it away from the ring start
+    io_uring_buf& buf = reinterpret_cast<io_uring_buf*>(buffers_ring_)[index];
+    buf.addr = reinterpret_cast<uint64_t>(storage_.get() +
+                                          static_cast<size_t>(id) *
+                                              buffer_size_);
+    buf.len = buffer_size_;
+    buf.bid = id;
+}
+
+void BufferRing::publish() noexcept {
+    std::atomic_ref<uint16_t> tail_ref{buffers_ring_->tail};
+    tail_ref.store(tail_ref.load(std::memory_order_relaxed) + pending_,
+                   std::memory_order_release);
+    pending_ = 0;
+}
+
+void BufferRing::recycle(const uint16_t id) noexcept {
+    push(id);
+    publish();
+}
+}  // namespace waxwing::internal::uring
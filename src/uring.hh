@@ -0,0 +1,164 @@
+#pragma once
+
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "waxwing/result.hh"
+
+namespace waxwing::internal::uring {
+/// Whether the kernel took the submitted entries
+enum class Submitted {
+    Yes,
+    /// Refused until the completion queue is reaped
+    Busy,
+};
+
+/// Thin wrapper over the raw io_uring syscall interface, owning the
+/// submission and completion queues of a single ring
+class Ring final {
+    int fd_ = -1;
+
+    void* rings_ptr_ = nullptr;
+    size_t rings_size_ = 0;
+    void* cq_ptr_ = nullptr;
+    size_t cq_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    // tail of the submission queue that was not yet published to the kernel
+    unsigned sqe_tail_ = 0;
+
+    // completions taken off the queue while waiting for room in a full
+    // submission queue, handled before the ones still in the queue
+    std::vector<io_uring_cqe> reaped_;
+    size_t reaped_head_ = 0;
+
+    Ring() = default;
+
+    void swap(Ring& other) noexcept;
+    Result<Submitted, std::string> enter(unsigned to_submit, unsigned wait_nr);
+    /// Move the completions in the queue to `reaped_`, returns their count
+    unsigned reap();
+
+public:
+    ~Ring();
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    Ring(Ring&& other) noexcept;
+    Ring& operator=(Ring&& rhs) noexcept;
+
+    static Result<Ring, std::string> create(unsigned entries);
+
+    int fd() const noexcept;
+
+    /// Get a zeroed submission queue entry, submitting the queued ones first
+    /// if the queue is full. If the kernel is too busy to take them, the
+    /// completions are reaped to be handled later, and if there are none,
+    /// throws
+    io_uring_sqe& next_sqe();
+
+    /// Submit all of the queued entries and wait for at least `wait_nr`
+    /// completions. Doesn't wait if the kernel is busy, the entries are
+    /// submitted again with the next call
+    Result<Submitted, std::string> submit_and_wait(unsigned wait_nr);
+
+    /// Consume every available completion, calling `f` on each of them.
+    /// Entries are released before the call, so `f` is free to queue new
+    /// submissions
+    template <typename F>
+        requires(std::invocable<F, const io_uring_cqe&>)
+    unsigned for_each_completion(F&& f) {
+        std::atomic_ref<unsigned> head_ref{*cq_head_};
+        // `f` may reap the queue, so the head is read again after every call
+        const unsigned tail = std::atomic_ref<unsigned>{*cq_tail_}.load(
+            std::memory_order_acquire);
+
+        unsigned count = 0;
+        for (;; ++count) {
+            io_uring_cqe cqe{};
+            if (reaped_head_ < reaped_.size()) {
+                cqe = reaped_[reaped_head_++];
+            } else {
+                reaped_.clear();
+                reaped_head_ = 0;
+                const unsigned head = head_ref.load(std::memory_order_relaxed);
+                if (static_cast<int>(tail - head) <= 0) {
+                    break;
+                }
+                cqe = cqes_[head & cq_mask_];
+                head_ref.store(head + 1, std::memory_order_release);
+            }
+            f(cqe);
+        }
+        return count;
+    }
+
+    /// Register a sparse table of `count` direct descriptors
+    Result<void, std::string> register_sparse_files(unsigned count);
+    Result<void, std::string> register_buffer_ring(io_uring_buf_ring* ring,
+                                                   unsigned entries,
+                                                   uint16_t group);
+};
+
+/// Group of equally sized buffers provided to the kernel, which picks one of
+/// them for every completion of a `IOSQE_BUFFER_SELECT` operation
+class BufferRing final {
+    int ring_fd_ = -1;
+    io_uring_buf_ring* buffers_ring_ = nullptr;
+    size_t ring_size_ = 0;
+    std::unique_ptr<char[]> storage_;
+    unsigned entries_ = 0;
+    unsigned buffer_size_ = 0;
+    uint16_t group_ = 0;
+    // buffers written after the tail which are not visible to the kernel yet
+    uint16_t pending_ = 0;
+
+    BufferRing() = default;
+
+    void swap(BufferRing& other) noexcept;
+    void push(uint16_t id) noexcept;
+    void publish() noexcept;
+
+public:
+    ~BufferRing();
+
+    BufferRing(const BufferRing&) = delete;
+    BufferRing& operator=(const BufferRing&) = delete;
+
+    BufferRing(BufferRing&& other) noexcept;
+    BufferRing& operator=(BufferRing&& rhs) noexcept;
+
+    /// `entries` must be a power of two
+    static Result<BufferRing, std::string> create(Ring& ring, uint16_t group,
+                                                  unsigned entries,
+                                                  unsigned buffer_size);
+
+    uint16_t group() const noexcept;
+
+    /// View `len` bytes the kernel placed into the buffer with id `id`
+    std::string_view get(uint16_t id, size_t len) const noexcept;
+
+    /// Give the buffer back to the kernel
+    void recycle(uint16_t id) noexcept;
+};
+}  // namespace waxwing::internal::uring
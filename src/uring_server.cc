@@ -0,0 +1,591 @@
+#include "uring_server.hh"
+
+#include <fmt/core.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <spdlog/spdlog.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "idle_timer.hh"
+#include "output_buffer.hh"
+#include "session.hh"
+#include "uring.hh"
+#include "waxwing/config.hh"
+#include "waxwing/file.hh"
+#include "waxwing/io.hh"
+#include "waxwing/result.hh"
+#include "waxwing/router.hh"
+
+namespace waxwing::internal {
+namespace {
+using uring::BufferRing;
+using uring::Ring;
+
+constexpr unsigned RING_ENTRIES = 1024;
+constexpr unsigned MAX_DIRECT_DESCRIPTORS = 1 << 16;
+constexpr unsigned RECV_BUFFERS = 1024;
+constexpr unsigned RECV_BUFFER_SIZE = 4096;
+constexpr uint16_t RECV_BUFFER_GROUP = 0;
+constexpr int PIPE_SIZE = 1 << 20;
+
+enum class Op : uint8_t {
+    Accept,
+    Recv,
+    Send,
+    Cancel,
+    Close,
+    Timeout,
+    Fill,
+};
+
+constexpr uint64_t OP_BITS = 8;
+
+uint64_t encode(const Op op, const uint32_t id = 0) noexcept {
+    return (static_cast<uint64_t>(id) << OP_BITS) | static_cast<uint64_t>(op);
+}
+
+Op decode_op(const uint64_t user_data) noexcept {
+    return static_cast<Op>(user_data & ((1 << OP_BITS) - 1));
+}
+
+uint32_t decode_id(const uint64_t user_data) noexcept {
+    return static_cast<uint32_t>(user_data >> OP_BITS);
+}
+
+bool is_transient_accept_error(const int error) noexcept {
+    switch (error) {
+        case ECONNABORTED:
+        case EINTR:
+        case EMFILE:
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct UringConnection {
+    UringConnection(const Router& router, const ServerConfig& config,
+                    const unsigned slot)
+        : session{router, config}, slot{slot} {}
+    ~UringConnection() {
+        for (const int fd : pipe) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    UringConnection(const UringConnection&) = delete;
+    UringConnection& operator=(const UringConnection&) = delete;
+
+    Session session;
+    IdleTimer::Handle idle;
+    // index of the direct descriptor in the registered files table
+    unsigned slot;
+
+    OutputBuffer sending;
+    // have to stay untouched until the send completes
+    std::array<iovec, OutputBuffer::MAX_IOVECS> iovecs{};
+    msghdr message{};
+
+    // files are spliced into the socket through a pipe, created on demand
+    std::array<int, 2> pipe{-1, -1};
+    size_t pipe_size = 0;
+    // bytes requested from the file by the fill in flight. Splicing may read
+    // less, e.g. when the range isn't aligned to pages
+    size_t filling = 0;
+    // bytes that are in the pipe, but not in the socket yet
+    size_t piped = 0;
+
+    bool receiving = false;
+    // the receive is being cancelled, since the session doesn't want more
+    // input for now
+    bool pausing = false;
+    bool send_in_flight = false;
+    // waiting in `UringServer::received_` to have its responses sent
+    bool received = false;
+    bool cancel_submitted = false;
+    bool close_submitted = false;
+    // peer won't send anything else, but still waits for the responses
+    bool eof = false;
+    // an operation failed, nothing else can be done with the connection
+    bool broken = false;
+};
+
+class UringServer final {
+    const Router& router_;
+    const ServerConfig& config_;
+    const int listen_fd_;
+    Ring ring_;
+    BufferRing buffers_;
+    IdleTimer idle_timer_;
+    // has to outlive the timeout operation it's passed to
+    __kernel_timespec idle_check_interval_{};
+
+    std::vector<std::unique_ptr<UringConnection>> connections_;
+    std::vector<uint32_t> free_ids_;
+    // connections which received data during the current batch of
+    // completions
+    std::vector<uint32_t> received_;
+    std::optional<std::string> fatal_error_;
+
+    uint32_t add_connection(unsigned slot);
+
+    void arm_accept();
+    void arm_idle_check();
+    void arm_recv(uint32_t id, UringConnection& conn);
+    /// Rearm or cancel the receive, depending on whether the session wants
+    /// more input
+    void pace_recv(uint32_t id, UringConnection& conn);
+    void flush(uint32_t id, UringConnection& conn);
+    void send_file(uint32_t id, UringConnection& conn, const FileRange& file);
+    void maybe_close(uint32_t id, UringConnection& conn);
+    void after_recv(uint32_t id, UringConnection& conn);
+
+    void on_accept(const io_uring_cqe& cqe);
+    void on_recv(uint32_t id, const io_uring_cqe& cqe);
+    void on_send(uint32_t id, const io_uring_cqe& cqe);
+    void on_fill(uint32_t id, const io_uring_cqe& cqe);
+    void on_close(uint32_t id);
+    void on_idle_check();
+
+public:
+    UringServer(const Router& router, const ServerConfig& config,
+                int listen_fd, Ring&& ring, BufferRing&& buffers)
+        : router_{router},
+          config_{config},
+          listen_fd_{listen_fd},
+          ring_{std::move(ring)},
+          buffers_{std::move(buffers)},
+          idle_timer_{config.idle_timeout} {}
+
+    Result<void, std::string> run();
+};
+
+uint32_t UringServer::add_connection(const unsigned slot) {
+    auto conn = std::make_unique<UringConnection>(router_, config_, slot);
+    if (!free_ids_.empty()) {
+        const uint32_t id = free_ids_.back();
+        free_ids_.pop_back();
+        connections_[id] = std::move(conn);
+        return id;
+    }
+
+    connections_.push_back(std::move(conn));
+    return static_cast<uint32_t>(connections_.size() - 1);
+}
+
+void UringServer::arm_accept() {
+    io_uring_sqe& sqe = ring_.next_sqe();
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.fd = listen_fd_;
+    sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+    // let the kernel pick a free slot in the registered files table
+    sqe.file_index = IORING_FILE_INDEX_ALLOC;
+    sqe.user_data = encode(Op::Accept);
+}
+
+void UringServer::arm_idle_check() {
+    const std::chrono::milliseconds interval =
+        idle_check_interval(config_.idle_timeout);
+    const auto seconds =
+        std::chrono::duration_cast<std::chrono::seconds>(interval);
+    idle_check_interval_.tv_sec = seconds.count();
+    idle_check_interval_.tv_nsec =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(interval - seconds)
+            .count();
+
+    io_uring_sqe& sqe = ring_.next_sqe();
+    sqe.opcode = IORING_OP_TIMEOUT;
+    sqe.addr = reinterpret_cast<uint64_t>(&idle_check_interval_);
+    sqe.len = 1;
+    sqe.user_data = encode(Op::Timeout);
+}
+
+void UringServer::arm_recv(const uint32_t id, UringConnection& conn) {
+    io_uring_sqe& sqe = ring_.next_sqe();
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = static_cast<int>(conn.slot);
+    sqe.flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.buf_group = buffers_.group();
+    sqe.user_data = encode(Op::Recv, id);
+    conn.receiving = true;
+}
+
+void UringServer::pace_recv(const uint32_t id, UringConnection& conn) {
+    if (conn.broken || conn.eof || conn.session.should_close()) {
+        return;
+    }
+
+    const bool wanted = conn.session.wants_input();
+    if (!conn.receiving && wanted) {
+        arm_recv(id, conn);
+    } else if (conn.receiving && !wanted && !conn.pausing) {
+        // completions already on their way are still processed, but the
+        // provided buffers bound how many of them there are
+        io_uring_sqe& sqe = ring_.next_sqe();
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.addr = encode(Op::Recv, id);
+        sqe.user_data = encode(Op::Cancel, id);
+        conn.pausing = true;
+    }
+}
+
+void UringServer::flush(const uint32_t id, UringConnection& conn) {
+    if (conn.send_in_flight || conn.broken) {
+        return;
+    }
+
+    if (conn.sending.empty()) {
+        if (!conn.session.has_output()) {
+            return;
+        }
+        conn.sending = conn.session.take_output();
+    }
+
+    if (const std::optional<FileRange> file = conn.sending.front_file()) {
+        send_file(id, conn, *file);
+        return;
+    }
+
+    conn.message = msghdr{};
+    conn.message.msg_iov = conn.iovecs.data();
+    conn.message.msg_iovlen = conn.sending.gather(conn.iovecs);
+
+    io_uring_sqe& sqe = ring_.next_sqe();
+    sqe.opcode = IORING_OP_SENDMSG;
+    sqe.fd = static_cast<int>(conn.slot);
+    sqe.flags = IOSQE_FIXED_FILE;
+    sqe.addr = reinterpret_cast<uint64_t>(&conn.message);
+    sqe.len = 1;
+    sqe.msg_flags = MSG_NOSIGNAL;
+    sqe.user_data = encode(Op::Send, id);
+    conn.send_in_flight = true;
+}
+
+void UringServer::send_file(const uint32_t id, UringConnection& conn,
+                             const FileRange& file) {
+    if (conn.pipe[0] < 0) {
+        if (::pipe2(conn.pipe.data(), O_CLOEXEC) < 0) {
+            spdlog::warn("creating pipe failed: {}",
+                         std::make_error_code(std::errc{errno}).message());
+            conn.broken = true;
+            return;
+        }
+        // larger pipe means fewer round trips, but the limit may be lower
+        const int pipe_size = ::fcntl(conn.pipe[1], F_SETPIPE_SZ, PIPE_SIZE);
+        conn.pipe_size = static_cast<size_t>(
+            pipe_size > 0 ? pipe_size : ::fcntl(conn.pipe[1], F_GETPIPE_SZ));
+    }
+
+    // no offsets for the pipe and the socket
+    constexpr auto NO_OFFSET = static_cast<uint64_t>(-1);
+
+    // the pipe is refilled from the file only once it's drained, whatever
+    // the previous splice left there goes first
+    if (conn.filling > 0) {
+        return;
+    }
+    if (conn.piped == 0) {
+        conn.filling = std::min(file.length, conn.pipe_size);
+
+        io_uring_sqe& fill = ring_.next_sqe();
+        fill.opcode = IORING_OP_SPLICE;
+        fill.fd = conn.pipe[1];
+        fill.off = NO_OFFSET;
+        fill.splice_fd_in = file.file->fd();
+        fill.splice_off_in = file.offset;
+        fill.len = static_cast<uint32_t>(conn.filling);
+        // the send only starts once the pipe has been filled
+        fill.flags = IOSQE_IO_LINK;
+        fill.user_data = encode(Op::Fill, id);
+    }
+
+    io_uring_sqe& sqe = ring_.next_sqe();
+    sqe.opcode = IORING_OP_SPLICE;
+    sqe.fd = static_cast<int>(conn.slot);
+    sqe.off = NO_OFFSET;
+    sqe.splice_fd_in = conn.pipe[0];
+    sqe.splice_off_in = NO_OFFSET;
+    sqe.len = static_cast<uint32_t>(conn.piped > 0 ? conn.piped : conn.filling);
+    sqe.flags = IOSQE_FIXED_FILE;
+    sqe.user_data = encode(Op::Send, id);
+    conn.send_in_flight = true;
+}
+
+void UringServer::maybe_close(const uint32_t id, UringConnection& conn) {
+    const bool output_done = !conn.send_in_flight &&
+                             conn.sending.empty() &&
+                             !conn.session.has_output();
+    const bool finished =
+        conn.broken ||
+        ((conn.eof || conn.session.should_close()) && output_done);
+    if (!finished || conn.close_submitted) {
+        return;
+    }
+
+    if (conn.receiving || conn.send_in_flight) {
+        // the descriptor can only be released after the pending operations
+        // have terminated, their final completions will get us back here.
+        // Sends are only pending here when the connection has timed out
+        if (!conn.cancel_submitted) {
+            for (const Op op : {Op::Recv, Op::Send, Op::Fill}) {
+                io_uring_sqe& sqe = ring_.next_sqe();
+                sqe.opcode = IORING_OP_ASYNC_CANCEL;
+                sqe.addr = encode(op, id);
+                sqe.user_data = encode(Op::Cancel, id);
+            }
+            conn.cancel_submitted = true;
+        }
+        return;
+    }
+
+    io_uring_sqe& sqe = ring_.next_sqe();
+    sqe.opcode = IORING_OP_CLOSE;
+    sqe.file_index = conn.slot + 1;
+    sqe.user_data = encode(Op::Close, id);
+    conn.close_submitted = true;
+}
+
+void UringServer::on_accept(const io_uring_cqe& cqe) {
+    if (cqe.res < 0) {
+        const std::string message =
+            std::make_error_code(std::errc{-cqe.res}).message();
+        if (!is_transient_accept_error(-cqe.res)) {
+            fatal_error_ = fmt::format("accept failed: {}", message);
+            return;
+        }
+        spdlog::warn("accept failed: {}", message);
+    }
+
+    if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+        arm_accept();
+    }
+    if (cqe.res < 0) {
+        return;
+    }
+
+    const auto slot = static_cast<unsigned>(cqe.res);
+    const uint32_t id = add_connection(slot);
+    UringConnection& conn = *connections_[id];
+    idle_timer_.start(id, conn.idle);
+    arm_recv(id, conn);
+}
+
+void UringServer::on_recv(const uint32_t id, const io_uring_cqe& cqe) {
+    UringConnection& conn = *connections_[id];
+    if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+        conn.receiving = false;
+    }
+    const bool paused = cqe.res == -ECANCELED && conn.pausing;
+    if (!conn.receiving) {
+        conn.pausing = false;
+    }
+
+    if ((cqe.flags & IORING_CQE_F_BUFFER) != 0) {
+        const auto buffer_id =
+            static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe.res > 0 && !conn.broken && !conn.eof) {
+            idle_timer_.touch(conn.idle);
+            conn.session.feed(
+                buffers_.get(buffer_id, static_cast<size_t>(cqe.res)));
+        }
+        buffers_.recycle(buffer_id);
+    }
+
+    if (cqe.res == 0) {
+        conn.eof = true;
+    } else if (cqe.res < 0 && cqe.res != -ENOBUFS && !paused) {
+        conn.broken = true;
+    }
+
+    // responses are sent once the whole batch of completions is processed,
+    // so requests pipelined across several receives go out in one send
+    if (!conn.received) {
+        conn.received = true;
+        received_.push_back(id);
+    }
+}
+
+void UringServer::after_recv(const uint32_t id, UringConnection& conn) {
+    conn.received = false;
+    flush(id, conn);
+
+    // out of provided buffers or the kernel decided to stop the multishot
+    // operation, either way it has to be rearmed to get more data, unless
+    // the session doesn't want any
+    pace_recv(id, conn);
+
+    maybe_close(id, conn);
+}
+
+void UringServer::on_send(const uint32_t id, const io_uring_cqe& cqe) {
+    UringConnection& conn = *connections_[id];
+    conn.send_in_flight = false;
+
+    if (cqe.res == -ECANCELED && !conn.cancel_submitted) {
+        // the pipe was filled only partially, which severs the link, so
+        // whatever got into the pipe is sent separately
+        flush(id, conn);
+    } else if (cqe.res < 0) {
+        conn.broken = true;
+    } else {
+        // spliced from the pipe, rather than sent from memory
+        if (conn.piped > 0) {
+            conn.piped -= static_cast<size_t>(cqe.res);
+        }
+        conn.sending.consume(static_cast<size_t>(cqe.res));
+        idle_timer_.touch(conn.idle);
+        flush(id, conn);
+        // receiving resumes once the produced body is out
+        pace_recv(id, conn);
+    }
+
+    maybe_close(id, conn);
+}
+
+void UringServer::on_fill(const uint32_t id, const io_uring_cqe& cqe) {
+    UringConnection& conn = *connections_[id];
+    conn.filling = 0;
+    // nothing read means the file was truncated after the response was
+    // built, it can't be sent as promised anymore
+    if (cqe.res <= 0) {
+        conn.broken = true;
+        maybe_close(id, conn);
+        return;
+    }
+    conn.piped = static_cast<size_t>(cqe.res);
+    flush(id, conn);
+}
+
+void UringServer::on_close(const uint32_t id) {
+    idle_timer_.stop(connections_[id]->idle);
+    connections_[id].reset();
+    free_ids_.push_back(id);
+}
+
+void UringServer::on_idle_check() {
+    idle_timer_.expire([this](const uint64_t raw_id) {
+        const auto id = static_cast<uint32_t>(raw_id);
+        UringConnection& conn = *connections_[id];
+        conn.broken = true;
+        maybe_close(id, conn);
+    });
+    arm_idle_check();
+}
+
+Result<void, std::string> UringServer::run() {
+    arm_accept();
+    if (config_.idle_timeout != std::chrono::milliseconds::zero()) {
+        arm_idle_check();
+    }
+
+    while (!fatal_error_.has_value()) {
+        // when the kernel is busy the completions are reaped right away,
+        // which makes room for it to take the entries again
+        Result<uring::Submitted, std::string> submitted =
+            ring_.submit_and_wait(1);
+        if (!submitted) {
+            return Error{std::move(submitted.error())};
+        }
+
+        ring_.for_each_completion([this](const io_uring_cqe& cqe) {
+            const uint32_t id = decode_id(cqe.user_data);
+            switch (decode_op(cqe.user_data)) {
+                case Op::Accept:
+                    on_accept(cqe);
+                    break;
+                case Op::Recv:
+                    on_recv(id, cqe);
+                    break;
+                case Op::Send:
+                    on_send(id, cqe);
+                    break;
+                case Op::Cancel:
+                    break;
+                case Op::Close:
+                    on_close(id);
+                    break;
+                case Op::Timeout:
+                    on_idle_check();
+                    break;
+                case Op::Fill:
+                    on_fill(id, cqe);
+                    break;
+            }
+        });
+
+        for (const uint32_t id : received_) {
+            after_recv(id, *connections_[id]);
+        }
+        received_.clear();
+    }
+
+    return Error{std::move(*fatal_error_)};
+}
+
+/// The registered files table can't be larger than the file descriptors limit
+unsigned direct_descriptors_count() noexcept {
+    constexpr unsigned FALLBACK_DESCRIPTORS = 1024;
+
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        return FALLBACK_DESCRIPTORS;
+    }
+    return static_cast<unsigned>(
+        std::min<rlim_t>(limit.rlim_cur, MAX_DIRECT_DESCRIPTORS));
+}
+}  // namespace
+
+Result<void, std::string> serve_uring(const Router& router,
+                                      const Socket& socket,
+                                      const ServerConfig& config) noexcept {
+    try {
+        Result<Ring, std::string> ring = Ring::create(RING_ENTRIES);
+        if (!ring) {
+            return Error{fmt::format("io_uring setup failed: {}",
+                                     ring.error())};
+        }
+
+        Result<void, std::string> files =
+            ring->register_sparse_files(direct_descriptors_count());
+        if (!files) {
+            return Error{fmt::format("registering files failed: {}",
+                                     files.error())};
+        }
+
+        Result<BufferRing, std::string> buffers = BufferRing::create(
+            *ring, RECV_BUFFER_GROUP, RECV_BUFFERS, RECV_BUFFER_SIZE);
+        if (!buffers) {
+            return Error{fmt::format("registering buffer ring failed: {}",
+                                     buffers.error())};
+        }
+
+        UringServer server{router, config, socket.fd(),
+                           std::move(ring.value()),
+                           std::move(buffers.value())};
+        return server.run();
+    } catch (const std::exception& e) {
+        return Error{std::string{e.what()}};
+    }
+}
+}  // namespace waxwing::internal
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "waxwing/config.hh"
+#include "waxwing/io.hh"
+#include "waxwing/result.hh"
+#include "waxwing/router.hh"
+
+namespace waxwing::internal {
+/// Serve connections accepted on `socket` from the calling thread, driving all
+/// of them through a single io_uring instance. Returns only on failure
+Result<void, std::string> serve_uring(const Router& router,
+                                      const Socket& socket,
+                                      const ServerConfig& config) noexcept;
+}  // namespace waxwing::internal
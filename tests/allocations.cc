@@ -0,0 +1,214 @@
+#include "waxwing/router.hh"
+
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "request_arena.hh"
+#include "serializer.hh"
+#include "waxwing/http.hh"
+#include "waxwing/request.hh"
+#include "waxwing/response.hh"
+
+namespace {
+// every allocation of the test binary is counted, to check that routing and
+// responses from the request memory don't make any. It's a binary of its
+// own, so the replaced allocation functions don't affect any other test
+thread_local size_t allocation_count = 0;
+
+void* allocate(const std::size_t size) noexcept {
+    ++allocation_count;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* allocate(const std::size_t size,
+               const std::align_val_t alignment) noexcept {
+    ++allocation_count;
+    const auto align = static_cast<std::size_t>(alignment);
+    // the size has to be a multiple of the alignment
+    return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+template <typename... Alignment>
+void* allocate_or_throw(const std::size_t size,
+                        const Alignment... alignment) {
+    if (void* const p = allocate(size, alignment...)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+}  // namespace
+
+// every form is replaced, so none of them reaches an allocator the others
+// don't match, whichever runtime is loaded
+void* operator new(const std::size_t size) { return allocate_or_throw(size); }
+void* operator new[](const std::size_t size) {
+    return allocate_or_throw(size);
+}
+void* operator new(const std::size_t size, const std::align_val_t alignment) {
+    return allocate_or_throw(size, alignment);
+}
+void* operator new[](const std::size_t size,
+                     const std::align_val_t alignment) {
+    return allocate_or_throw(size, alignment);
+}
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+void* operator new(const std::size_t size, const std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+}
+void* operator new[](const std::size_t size, const std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+}
+
+void operator delete(void* const p) noexcept { std::free(p); }
+void operator delete[](void* const p) noexcept { std::free(p); }
+void operator delete(void* const p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* const p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* const p, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* const p, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* const p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* const p, std::size_t,
+                       std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* const p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* const p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete(void* const p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* const p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+namespace waxwing {
+TEST(Router, RoutesWithoutAllocating) {
+    auto ok = [](const Request&, const PathParameters) {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.build();
+    };
+
+    internal::Router router;
+    router.add_route(HttpMethod::Get, "/", ok);
+    router.add_route(HttpMethod::Get, "/users/me", ok);
+    router.add_route(HttpMethod::Get, "/users/:id", ok);
+    router.add_route(HttpMethod::Get, "/users/:id/posts/*post", ok);
+    router.add_route(HttpMethod::Post, "/users/:id/posts", ok);
+    router.add_route(HttpMethod::Get,
+                     "/:a/:b/:c/:d/:e/:f/:g/:h/:i/:j/:k/:l/:m/:n/:o/:p", ok);
+    router.add_prefix_route(HttpMethod::Get, "/assets", ok);
+
+    std::vector<std::pair<HttpMethod, std::string_view>> targets{
+        {HttpMethod::Get, "/"},
+        {HttpMethod::Get, "/users/me"},
+        {HttpMethod::Get, "/users/42"},
+        {HttpMethod::Get, "/users/42/posts/"},
+        {HttpMethod::Get, "/users/42/posts/first"},
+        {HttpMethod::Get, "/a/b/c/d/e/f/g/h/i/j/k/l/m/n/o/p"},
+        {HttpMethod::Get, "/a/b/c/d/e/f/g/h/i/j/k/l/m/n/o/p/q/r/s"},
+        {HttpMethod::Get, "/assets/js/app.js"},
+        {HttpMethod::Get, "/users/42/posts"},
+        {HttpMethod::Delete, "/users/42"},
+        {HttpMethod::Get, "/unknown/path"},
+    };
+
+    auto check_routing = [&](const size_t expected_found) {
+        size_t found = 0;
+        size_t parameters = 0;
+        const size_t before = allocation_count;
+        for (const auto& [method, target] : targets) {
+            const internal::RoutingResult result =
+                router.route(method, target);
+            found += result.found() ? 1 : 0;
+            parameters += result.parameters().size();
+        }
+        EXPECT_EQ(allocation_count, before);
+        EXPECT_EQ(found, expected_found);
+        EXPECT_EQ(parameters, 0 + 0 + 1 + 2 + 2 + 16 + 1);
+    };
+
+    check_routing(7);
+    ASSERT_TRUE(router.freeze());
+    check_routing(7);
+
+    // every node of these needs a state of its own, so there are more than
+    // `MAX_STATES` of them, and the nodes are tracked in lockstep instead
+    std::deque<std::string> literal_targets;
+    for (size_t i = 0; i < 17 * 17 * 17 * 17; ++i) {
+        router.add_route(HttpMethod::Get,
+                         literal_targets.emplace_back(fmt::format(
+                             "/a{}/b{}/c{}/d{}", i % 17, i / 17 % 17,
+                             i / 289 % 17, i / 4913)),
+                         ok);
+    }
+    targets.emplace_back(HttpMethod::Get, "/a3/b7/c1/d9");
+    targets.emplace_back(HttpMethod::Get, "/a3/b7/c1/d17");
+    ASSERT_TRUE(router.freeze());
+    check_routing(8);
+}
+
+TEST(RequestArena, ServesOptInResponsesWithoutAllocating) {
+    internal::Router router;
+    router.add_route(HttpMethod::Get, "/hello",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200,
+                                                request_memory()}
+                             .header("X-Served-By",
+                                     std::string_view{"a handler with a "
+                                                      "header value too long "
+                                                      "for a short string"})
+                             .header("Cache-Control", "no-store")
+                             .build();
+                     });
+    router.freeze();
+    const Request req = RequestBuilder{HttpMethod::Get, "/hello"}.build();
+
+    // the head goes where the session would serialize it, which is already
+    // large enough
+    std::string head;
+    head.reserve(1024);
+    auto serve = [&] {
+        // the same scope the session opens around the handler
+        const internal::RequestArena::Scope arena{
+            internal::RequestArena::local()};
+        const internal::RoutingResult route =
+            router.route(req.method(), req.target());
+        Response resp = route.handler()(req, route.parameters());
+        head.clear();
+        internal::serialize_head(head, resp.status(), resp.headers(),
+                                 {.content_length = 0});
+    };
+
+    // the arena of the thread and the date are set up by the first request
+    serve();
+    const size_t before = allocation_count;
+    serve();
+    EXPECT_EQ(allocation_count, before);
+    EXPECT_NE(head.find("X-Served-By: a handler with"), std::string::npos);
+}
+}  // namespace waxwing
@@ -0,0 +1,104 @@
+#include "char_scan.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace waxwing {
+namespace char_scan = internal::char_scan;
+
+namespace {
+using Scanner = size_t (*)(const char*, size_t, size_t) noexcept;
+
+struct Implementation {
+    std::string_view name;
+    Scanner token;
+    Scanner visible;
+    Scanner value;
+};
+
+/// Vectorized implementations the CPU running the tests supports
+std::vector<Implementation> vectorized() {
+    std::vector<Implementation> result;
+#if defined(__x86_64__)
+    if (char_scan::has_sse42()) {
+        result.push_back({"sse4.2", char_scan::token_sse42,
+                          char_scan::visible_sse42, char_scan::value_sse42});
+    }
+    if (char_scan::has_avx2()) {
+        result.push_back({"avx2", char_scan::token_avx2,
+                          char_scan::visible_avx2, char_scan::value_avx2});
+    }
+#endif
+    return result;
+}
+}  // namespace
+
+TEST(CharScan, Scalar) {
+    const std::string_view header = "Content-Length: 42\r\n";
+    EXPECT_EQ(char_scan::token_scalar(header.data(), header.size(), 0), 14);
+    EXPECT_EQ(char_scan::visible_scalar(header.data(), header.size(), 0), 15);
+    EXPECT_EQ(char_scan::value_scalar(header.data(), header.size(), 16), 18);
+    EXPECT_EQ(char_scan::value_scalar(header.data(), header.size(), 20), 20);
+
+    const std::string_view value = "a\tb\x80\x7f";
+    EXPECT_EQ(char_scan::value_scalar(value.data(), value.size(), 0), 4);
+}
+
+TEST(CharScan, VectorizedMatchScalar) {
+    std::mt19937 random{42};
+    // mostly valid characters, so the scans run for a while
+    const std::string_view common =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_ ";
+
+    for (const Implementation& impl : vectorized()) {
+        for (size_t round = 0; round < 2000; ++round) {
+            std::string data(random() % 100, '\0');
+            for (char& c : data) {
+                c = random() % 8 == 0 ? static_cast<char>(random() % 256)
+                                      : common[random() % common.size()];
+            }
+            const size_t from = data.empty() ? 0 : random() % data.size();
+
+            ASSERT_EQ(impl.token(data.data(), data.size(), from),
+                      char_scan::token_scalar(data.data(), data.size(), from))
+                << impl.name << ' ' << data;
+            ASSERT_EQ(
+                impl.visible(data.data(), data.size(), from),
+                char_scan::visible_scalar(data.data(), data.size(), from))
+                << impl.name << ' ' << data;
+            ASSERT_EQ(impl.value(data.data(), data.size(), from),
+                      char_scan::value_scalar(data.data(), data.size(), from))
+                << impl.name << ' ' << data;
+        }
+    }
+}
+
+TEST(CharScan, EveryByte) {
+    for (const Implementation& impl : vectorized()) {
+        for (size_t byte = 0; byte < 256; ++byte) {
+            // the odd byte at every position of a vector
+            for (size_t pos = 0; pos < 40; ++pos) {
+                std::string data(40, 'a');
+                data[pos] = static_cast<char>(byte);
+                ASSERT_EQ(
+                    impl.token(data.data(), data.size(), 0),
+                    char_scan::token_scalar(data.data(), data.size(), 0))
+                    << impl.name << ' ' << byte << ' ' << pos;
+                ASSERT_EQ(
+                    impl.visible(data.data(), data.size(), 0),
+                    char_scan::visible_scalar(data.data(), data.size(), 0))
+                    << impl.name << ' ' << byte << ' ' << pos;
+                ASSERT_EQ(
+                    impl.value(data.data(), data.size(), 0),
+                    char_scan::value_scalar(data.data(), data.size(), 0))
+                    << impl.name << ' ' << byte << ' ' << pos;
+            }
+        }
+    }
+}
+}  // namespace waxwing
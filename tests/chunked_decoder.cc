@@ -0,0 +1,137 @@
+#include "chunked_decoder.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "waxwing/config.hh"
+#include "waxwing/http.hh"
+
+namespace waxwing {
+using internal::ChunkedDecoder;
+
+namespace {
+constexpr std::string_view BODY =
+    "4\r\nWiki\r\n"
+    "7;name=\"value\"\r\npedia i\r\n"
+    "B \t;ext\r\nn \r\nchunks.\r\n"
+    "0\r\n"
+    "Checksum: abc \r\n"
+    "X-Empty:\r\n"
+    "\r\n";
+
+struct Outcome {
+    std::string body;
+    size_t consumed = 0;
+    bool done = false;
+};
+
+/// Feed `input` to the decoder in pieces of `step` bytes
+Outcome decode(ChunkedDecoder& decoder, const std::string_view input,
+               const size_t step) {
+    Outcome outcome;
+    for (size_t offset = 0; offset < input.size() && !outcome.done;) {
+        const std::string_view piece = input.substr(offset, step);
+        size_t used = 0;
+        while (used < piece.size() && !outcome.done) {
+            const auto decoded = decoder.decode(piece.substr(used));
+            EXPECT_TRUE(decoded);
+            if (!decoded) {
+                return outcome;
+            }
+            used += decoded->consumed;
+            outcome.body += decoded->data;
+            outcome.done = decoded->done;
+        }
+        offset += used;
+        outcome.consumed = offset;
+    }
+    return outcome;
+}
+
+HttpStatusCode rejection(const std::string_view input, const size_t max_size,
+                         const ServerConfig& config = {}) {
+    ChunkedDecoder decoder{config};
+    decoder.reset(max_size);
+    for (size_t used = 0; used < input.size();) {
+        const auto decoded = decoder.decode(input.substr(used));
+        if (!decoded) {
+            return decoded.error().status;
+        }
+        used += decoded->consumed;
+    }
+    ADD_FAILURE() << "accepted " << input;
+    return HttpStatusCode::Ok_200;
+}
+}  // namespace
+
+TEST(ChunkedDecoder, Decodes) {
+    const ServerConfig config;
+    for (const size_t step : {size_t{1}, size_t{3}, BODY.size()}) {
+        ChunkedDecoder decoder{config};
+        decoder.reset(0);
+
+        const Outcome outcome = decode(decoder, BODY, step);
+        EXPECT_TRUE(outcome.done) << step;
+        EXPECT_EQ(outcome.body, "Wikipedia in \r\nchunks.") << step;
+        EXPECT_EQ(outcome.consumed, BODY.size()) << step;
+        EXPECT_EQ(decoder.decoded(), 22);
+
+        ASSERT_EQ(decoder.trailers().size(), 2);
+        EXPECT_EQ(decoder.trailers()[0].name, "Checksum");
+        EXPECT_EQ(decoder.trailers()[0].value, "abc");
+        EXPECT_EQ(decoder.trailers()[1].name, "X-Empty");
+        EXPECT_EQ(decoder.trailers()[1].value, "");
+    }
+}
+
+TEST(ChunkedDecoder, StopsAtTheEnd) {
+    const ServerConfig config;
+    ChunkedDecoder decoder{config};
+    decoder.reset(0);
+
+    // bare line feeds are accepted, and the next request is left alone
+    const std::string input = "2\nab\n0\n\nGET / HTTP/1.1\r\n\r\n";
+    const Outcome outcome = decode(decoder, input, input.size());
+    EXPECT_TRUE(outcome.done);
+    EXPECT_EQ(outcome.body, "ab");
+    EXPECT_EQ(outcome.consumed, input.find("GET"));
+    EXPECT_TRUE(decoder.trailers().empty());
+
+    decoder.reset(0);
+    EXPECT_EQ(decode(decoder, "0\r\n\r\n", 5).body, "");
+}
+
+TEST(ChunkedDecoder, Rejects) {
+    EXPECT_EQ(rejection("x\r\n", 0), HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("\r\n", 0), HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("1x\r\n", 0), HttpStatusCode::BadRequest_400);
+    // only an extension may follow the whitespace after the size
+    EXPECT_EQ(rejection("5 x\r\nhello\r\n0\r\n\r\n", 0),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("5 \t5\r\n", 0), HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("1\r\nab\r\n", 0), HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("1\rx", 0), HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("1;\x01\r\n", 0), HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("1;" + std::string(40, 'x') + "\x7f\r\n", 0),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("1;" + std::string(2048, 'x') + "\r\n", 0),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection(std::string(16, 'f') + "\r\n", 0),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("0\r\nNo colon\r\n\r\n", 0),
+              HttpStatusCode::BadRequest_400);
+
+    // the limit is checked before the data arrives
+    EXPECT_EQ(rejection("4\r\nabcd\r\n1\r\n", 4),
+              HttpStatusCode::ContentTooLarge_413);
+
+    const ServerConfig config{.max_headers_size = 16, .max_header_count = 1};
+    EXPECT_EQ(rejection("0\r\nX-Large: " + std::string(16, 'a'), 0, config),
+              HttpStatusCode::RequestHeaderFieldsTooLarge_431);
+    EXPECT_EQ(rejection("0\r\nA: 1\r\nB: 2\r\n\r\n", 0, config),
+              HttpStatusCode::RequestHeaderFieldsTooLarge_431);
+}
+}  // namespace waxwing
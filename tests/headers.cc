@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "waxwing/http.hh"
+
+namespace waxwing {
+TEST(Headers, CaseInsensitive) {
+    Headers headers;
+    headers.insert("Content-Length", "5");
+    headers.insert("X-Custom", "custom");
+
+    // known and unknown names take different paths
+    EXPECT_EQ(headers.get("content-length"), "5");
+    EXPECT_EQ(headers.get("CONTENT-LENGTH"), "5");
+    EXPECT_EQ(headers.get("x-custom"), "custom");
+    EXPECT_TRUE(headers.contains("X-CUSTOM"));
+
+    EXPECT_FALSE(headers.contains("content-type"));
+    EXPECT_FALSE(headers.contains("x-other"));
+    EXPECT_FALSE(headers.contains("content-lengt"));
+}
+
+TEST(Headers, InsertKeepsFirst) {
+    Headers headers;
+    headers.insert("Host", "first");
+    headers.insert("host", "second");
+    headers.insert("X-Custom", "first");
+    headers.insert("x-custom", "second");
+
+    EXPECT_EQ(headers.size(), 2);
+    EXPECT_EQ(headers.get("Host"), "first");
+    EXPECT_EQ(headers.get("X-Custom"), "first");
+}
+
+TEST(Headers, InsertOrAssign) {
+    Headers headers;
+    headers.insert_or_assign("Connection", "keep-alive");
+    headers.insert_or_assign("connection", "close");
+    headers.insert_or_assign("X-Custom", "first");
+    headers.insert_or_assign("X-CUSTOM", "second");
+
+    EXPECT_EQ(headers.size(), 2);
+    EXPECT_EQ(headers.get("Connection"), "close");
+    EXPECT_EQ(headers.get("x-custom"), "second");
+}
+
+TEST(Headers, KeepsOrder) {
+    Headers headers;
+    headers.insert("Content-Type", "text/plain");
+    headers.insert("X-Custom", "custom");
+    headers.insert("Date", "today");
+
+    std::vector<std::pair<std::string, std::string>> fields;
+    for (const auto& [name, value] : headers) {
+        fields.emplace_back(name, value);
+    }
+    const std::vector<std::pair<std::string, std::string>> expected{
+        {"Content-Type", "text/plain"},
+        {"X-Custom", "custom"},
+        {"Date", "today"},
+    };
+    EXPECT_EQ(fields, expected);
+}
+
+TEST(Headers, EveryKnownField) {
+    const std::vector<std::string_view> names{
+        "Accept",        "Accept-Encoding",   "Accept-Language",
+        "Accept-Ranges", "Authorization",     "Cache-Control",
+        "Connection",    "Content-Encoding",  "Content-Length",
+        "Content-Range", "Content-Type",      "Cookie",
+        "Date",          "ETag",              "Expect",
+        "Host",          "If-Modified-Since", "If-None-Match",
+        "Keep-Alive",    "Last-Modified",     "Location",
+        "Origin",        "Range",             "Referer",
+        "Server",        "Set-Cookie",        "TE",
+        "Trailer",       "Transfer-Encoding", "Upgrade",
+        "User-Agent",    "Vary",
+    };
+
+    Headers headers;
+    for (const std::string_view name : names) {
+        headers.insert(name, name);
+    }
+    ASSERT_EQ(headers.size(), names.size());
+    for (const std::string_view name : names) {
+        EXPECT_EQ(headers.get(name), name);
+    }
+}
+}  // namespace waxwing
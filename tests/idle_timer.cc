@@ -0,0 +1,91 @@
+#include "idle_timer.hh"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+using waxwing::internal::IdleTimer;
+
+std::vector<uint64_t> expired(IdleTimer& timer) {
+    std::vector<uint64_t> result;
+    timer.expire([&result](const uint64_t id) { result.push_back(id); });
+    return result;
+}
+
+TEST(IdleTimer, ReportsEarliestDeadline) {
+    IdleTimer timer{1h};
+    EXPECT_FALSE(timer.next_expiry().has_value());
+
+    IdleTimer::Handle first;
+    timer.start(1, first);
+    EXPECT_TRUE(first.has_value());
+    ASSERT_TRUE(timer.next_expiry().has_value());
+    EXPECT_GT(*timer.next_expiry(), 59min);
+    EXPECT_LE(*timer.next_expiry(), 1h);
+
+    timer.stop(first);
+    EXPECT_FALSE(first.has_value());
+    EXPECT_FALSE(timer.next_expiry().has_value());
+    // stopping twice does nothing
+    timer.stop(first);
+}
+
+TEST(IdleTimer, ExpiresInOrderOfLastActivity) {
+    IdleTimer timer{100ms};
+    IdleTimer::Handle first;
+    IdleTimer::Handle second;
+    IdleTimer::Handle third;
+    timer.start(1, first);
+    timer.start(2, second);
+    timer.start(3, third);
+    EXPECT_TRUE(expired(timer).empty());
+
+    // the first one had traffic last, so it's the last to expire
+    std::this_thread::sleep_for(60ms);
+    timer.touch(first);
+    std::this_thread::sleep_for(60ms);
+    EXPECT_EQ(expired(timer), (std::vector<uint64_t>{2, 3}));
+    EXPECT_FALSE(second.has_value());
+    EXPECT_FALSE(third.has_value());
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(timer.next_expiry().has_value());
+    EXPECT_LE(*timer.next_expiry(), 40ms);
+
+    std::this_thread::sleep_for(60ms);
+    EXPECT_EQ(*timer.next_expiry(), IdleTimer::Clock::duration::zero());
+    EXPECT_EQ(expired(timer), std::vector<uint64_t>{1});
+    EXPECT_FALSE(first.has_value());
+    EXPECT_FALSE(timer.next_expiry().has_value());
+}
+
+TEST(IdleTimer, StoppedConnectionsDontExpire) {
+    IdleTimer timer{10ms};
+    IdleTimer::Handle first;
+    IdleTimer::Handle second;
+    timer.start(1, first);
+    timer.start(2, second);
+    timer.stop(first);
+
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(expired(timer), std::vector<uint64_t>{2});
+    // touching an expired connection does nothing
+    timer.touch(second);
+    EXPECT_FALSE(second.has_value());
+    EXPECT_FALSE(timer.next_expiry().has_value());
+}
+
+TEST(IdleTimer, ZeroTimeoutTracksNothing) {
+    IdleTimer timer{IdleTimer::Clock::duration::zero()};
+    IdleTimer::Handle handle;
+    timer.start(1, handle);
+    EXPECT_FALSE(handle.has_value());
+    EXPECT_FALSE(timer.next_expiry().has_value());
+    timer.touch(handle);
+    EXPECT_TRUE(expired(timer).empty());
+}
+}  // namespace
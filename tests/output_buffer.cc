@@ -0,0 +1,134 @@
+#include "output_buffer.hh"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace waxwing {
+using internal::OutputBuffer;
+
+namespace {
+std::string_view view(const iovec& vec) {
+    return {static_cast<const char*>(vec.iov_base), vec.iov_len};
+}
+}  // namespace
+
+TEST(OutputBuffer, SmallPiecesAreJoined) {
+    OutputBuffer buffer;
+    EXPECT_TRUE(buffer.empty());
+
+    buffer.append(std::string_view{"foo"});
+    buffer.append(std::string{"bar"});
+
+    std::array<iovec, 4> iovecs{};
+    ASSERT_EQ(buffer.gather(iovecs), 1);
+    EXPECT_EQ(view(iovecs[0]), "foobar");
+
+    buffer.consume(4);
+    ASSERT_EQ(buffer.gather(iovecs), 1);
+    EXPECT_EQ(view(iovecs[0]), "ar");
+    EXPECT_EQ(buffer.size(), 2);
+
+    buffer.consume(2);
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.size(), 0);
+}
+
+TEST(OutputBuffer, LargePiecesAreNotCopied) {
+    OutputBuffer buffer;
+    std::string body(OutputBuffer::SEPARATE_CHUNK_SIZE, 'x');
+    const char* const body_data = body.data();
+
+    buffer.append(std::string_view{"head"});
+    buffer.append(std::move(body));
+    buffer.append(std::string_view{"tail"});
+    EXPECT_EQ(buffer.size(), OutputBuffer::SEPARATE_CHUNK_SIZE + 8);
+
+    std::array<iovec, 4> iovecs{};
+    ASSERT_EQ(buffer.gather(iovecs), 3);
+    EXPECT_EQ(view(iovecs[0]), "head");
+    EXPECT_EQ(iovecs[1].iov_base, body_data);
+    EXPECT_EQ(iovecs[1].iov_len, OutputBuffer::SEPARATE_CHUNK_SIZE);
+    EXPECT_EQ(view(iovecs[2]), "tail");
+
+    // partial write ending in the middle of the body
+    buffer.consume(4 + 10);
+    ASSERT_EQ(buffer.gather(iovecs), 2);
+    EXPECT_EQ(buffer.size(), OutputBuffer::SEPARATE_CHUNK_SIZE - 10 + 4);
+    EXPECT_EQ(iovecs[0].iov_base, body_data + 10);
+    EXPECT_EQ(iovecs[0].iov_len, OutputBuffer::SEPARATE_CHUNK_SIZE - 10);
+
+    std::array<iovec, 1> single{};
+    ASSERT_EQ(buffer.gather(single), 1);
+    EXPECT_EQ(single[0].iov_base, body_data + 10);
+
+    buffer.consume(OutputBuffer::SEPARATE_CHUNK_SIZE - 10 + 4);
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.size(), 0);
+}
+
+TEST(OutputBuffer, SharedPiecesAreNotCopied) {
+    const auto shared = std::make_shared<const std::string>(
+        OutputBuffer::SEPARATE_CHUNK_SIZE, 'x');
+    const std::string borrowed(OutputBuffer::SEPARATE_CHUNK_SIZE, 'y');
+
+    OutputBuffer first;
+    OutputBuffer second;
+    for (OutputBuffer* buffer : {&first, &second}) {
+        buffer->append(shared);
+        buffer->append_borrowed(borrowed);
+        // small pieces are still cheaper to copy than to write separately
+        buffer->append(std::make_shared<const std::string>("tail"));
+        buffer->append_borrowed("end");
+    }
+    EXPECT_EQ(shared.use_count(), 3);
+
+    std::array<iovec, 4> iovecs{};
+    for (OutputBuffer* buffer : {&first, &second}) {
+        ASSERT_EQ(buffer->gather(iovecs), 3);
+        EXPECT_EQ(iovecs[0].iov_base, shared->data());
+        EXPECT_EQ(iovecs[1].iov_base, borrowed.data());
+        EXPECT_EQ(view(iovecs[2]), "tailend");
+    }
+
+    first.consume(OutputBuffer::SEPARATE_CHUNK_SIZE + 1);
+    ASSERT_EQ(first.gather(iovecs), 2);
+    EXPECT_EQ(iovecs[0].iov_base, borrowed.data() + 1);
+    EXPECT_EQ(shared.use_count(), 2);
+}
+
+TEST(OutputBuffer, FilesAreSentSeparately) {
+    OutputBuffer buffer;
+    buffer.append(std::string_view{"head"});
+    buffer.append(FileRange{nullptr, 100, 50});
+    buffer.append(std::string_view{"next"});
+    EXPECT_EQ(buffer.size(), 4 + 50 + 4);
+
+    // memory is gathered only up to the file
+    std::array<iovec, 4> iovecs{};
+    EXPECT_FALSE(buffer.front_file().has_value());
+    ASSERT_EQ(buffer.gather(iovecs), 1);
+    EXPECT_EQ(view(iovecs[0]), "head");
+    buffer.consume(4);
+
+    std::optional<FileRange> file = buffer.front_file();
+    ASSERT_TRUE(file.has_value());
+    EXPECT_EQ(file->offset, 100);
+    EXPECT_EQ(file->length, 50);
+
+    buffer.consume(20);
+    file = buffer.front_file();
+    ASSERT_TRUE(file.has_value());
+    EXPECT_EQ(file->offset, 120);
+    EXPECT_EQ(file->length, 30);
+
+    buffer.consume(30);
+    EXPECT_FALSE(buffer.front_file().has_value());
+    ASSERT_EQ(buffer.gather(iovecs), 1);
+    EXPECT_EQ(view(iovecs[0]), "next");
+}
+}  // namespace waxwing
@@ -0,0 +1,74 @@
+#include "receive_buffer.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <span>
+#include <string_view>
+
+namespace waxwing {
+using internal::ReceiveBuffer;
+using internal::ReceiveBufferPool;
+
+namespace {
+void receive(ReceiveBuffer& buffer, const std::string_view data) {
+    const std::span<char> space = buffer.prepare(data.size());
+    ASSERT_GE(space.size(), data.size());
+    std::copy(data.begin(), data.end(), space.begin());
+    buffer.commit(data.size());
+}
+}  // namespace
+
+TEST(ReceiveBuffer, Basic) {
+    ReceiveBuffer buffer{8};
+    EXPECT_TRUE(buffer.empty());
+
+    receive(buffer, "foo");
+    receive(buffer, "bar");
+    EXPECT_EQ(buffer.data(), "foobar");
+
+    buffer.consume(3);
+    EXPECT_EQ(buffer.data(), "bar");
+
+    // processed data is dropped to make space instead of growing
+    receive(buffer, "bazqux");
+    EXPECT_EQ(buffer.data(), "barbazqux");
+    EXPECT_EQ(buffer.capacity(), 16);
+
+    buffer.consume(9);
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(ReceiveBuffer, Grows) {
+    ReceiveBuffer buffer{4};
+    receive(buffer, "abc");
+    receive(buffer, "defgh");
+    buffer.append("ijklmnopq");
+    EXPECT_EQ(buffer.data(), "abcdefghijklmnopq");
+    EXPECT_GE(buffer.capacity(), 17);
+}
+
+TEST(ReceiveBufferPool, ReusesBuffers) {
+    ReceiveBufferPool pool;
+
+    ReceiveBuffer buffer = pool.acquire();
+    EXPECT_EQ(buffer.capacity(), ReceiveBufferPool::BUFFER_SIZE);
+    buffer.append("leftover");
+    const char* const data = buffer.data().data();
+
+    pool.release(std::move(buffer));
+    ReceiveBuffer reused = pool.acquire();
+    EXPECT_TRUE(reused.empty());
+    EXPECT_EQ(reused.prepare(1).data(), data);
+}
+
+TEST(ReceiveBufferPool, DropsLargeBuffers) {
+    ReceiveBufferPool pool;
+
+    ReceiveBuffer buffer = pool.acquire();
+    buffer.prepare(ReceiveBufferPool::MAX_POOLED_CAPACITY + 1);
+    pool.release(std::move(buffer));
+
+    EXPECT_EQ(pool.acquire().capacity(), ReceiveBufferPool::BUFFER_SIZE);
+}
+}  // namespace waxwing
@@ -0,0 +1,48 @@
+#include "waxwing/request.hh"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "waxwing/http.hh"
+
+namespace waxwing {
+TEST(Request, Builder) {
+    Request req = RequestBuilder{HttpMethod::Post, "/upload"}
+                      .header("Content-Type", "text/plain")
+                      .body("hello")
+                      .build();
+
+    // the views have to survive moving the request around
+    const Request moved = std::move(req);
+    EXPECT_EQ(moved.method(), HttpMethod::Post);
+    EXPECT_EQ(moved.target(), "/upload");
+    EXPECT_EQ(moved.body(), "hello");
+    EXPECT_EQ(moved.header("content-type"), "text/plain");
+    EXPECT_EQ(moved.header("CONTENT-TYPE"), "text/plain");
+    EXPECT_EQ(moved.header("accept"), std::nullopt);
+    ASSERT_EQ(moved.headers().size(), 1);
+    EXPECT_EQ(moved.headers()[0].name, "Content-Type");
+}
+
+TEST(Request, ToOwned) {
+    std::optional<Request> owned;
+    {
+        const Request original = RequestBuilder{HttpMethod::Get, "/target"}
+                                     .header("Host", "localhost")
+                                     .body("body")
+                                     .build();
+        owned.emplace(original.to_owned());
+        EXPECT_NE(owned->target().data(), original.target().data());
+    }
+
+    // still valid after the original is gone
+    EXPECT_EQ(owned->method(), HttpMethod::Get);
+    EXPECT_EQ(owned->target(), "/target");
+    EXPECT_EQ(owned->header("host"), "localhost");
+    EXPECT_EQ(owned->body(), "body");
+}
+}  // namespace waxwing
@@ -0,0 +1,81 @@
+#include "request_arena.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+
+#include "waxwing/http.hh"
+
+namespace waxwing {
+using internal::RequestArena;
+
+namespace {
+/// Resource counting what it's asked for
+class CountingResource final : public std::pmr::memory_resource {
+public:
+    size_t allocations = 0;
+    size_t deallocations = 0;
+
+private:
+    void* do_allocate(const size_t bytes, const size_t alignment) override {
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* const p, const size_t bytes,
+                       const size_t alignment) override {
+        ++deallocations;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+}  // namespace
+
+TEST(RequestArena, AllocatesWithinScope) {
+    CountingResource upstream;
+    RequestArena arena{4096, &upstream};
+    EXPECT_EQ(request_memory(), std::pmr::get_default_resource());
+
+    for (int request = 0; request < 2; ++request) {
+        const RequestArena::Scope scope{arena};
+        EXPECT_NE(request_memory(), std::pmr::get_default_resource());
+
+        Headers headers{request_memory()};
+        headers.insert("Content-Type", "text/plain");
+        headers.insert("X-Long", std::string(200, 'x'));
+        EXPECT_EQ(upstream.allocations, 0);
+        EXPECT_EQ(headers.get("x-long")->size(), 200);
+
+        // copies don't depend on the arena
+        const Headers copy = headers;
+        EXPECT_EQ(copy.get("content-type"), "text/plain");
+    }
+    EXPECT_EQ(request_memory(), std::pmr::get_default_resource());
+}
+
+TEST(RequestArena, ReturnsOverflowUpstream) {
+    CountingResource upstream;
+    RequestArena arena{1024, &upstream};
+    {
+        const RequestArena::Scope scope{arena};
+        {
+            // only the outermost scope releases the memory
+            const RequestArena::Scope nested{RequestArena::local()};
+            EXPECT_NE(request_memory(), std::pmr::get_default_resource());
+        }
+        EXPECT_NE(request_memory(), std::pmr::get_default_resource());
+
+        Headers headers{request_memory()};
+        headers.insert("X-Large", std::string(4096, 'x'));
+        EXPECT_GT(upstream.allocations, 0);
+        EXPECT_EQ(upstream.deallocations, 0);
+    }
+    EXPECT_EQ(upstream.deallocations, upstream.allocations);
+}
+}  // namespace waxwing
@@ -0,0 +1,222 @@
+#include "request_parser.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+
+#include "waxwing/config.hh"
+#include "waxwing/http.hh"
+
+namespace waxwing {
+using internal::ParseStatus;
+using internal::RequestParser;
+
+namespace {
+constexpr std::string_view REQUEST =
+    "POST /upload?x=1 HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Content-Length:  5 \r\n"
+    "X-Empty:\r\n"
+    "\r\n"
+    "hello";
+
+void expect_parsed(const RequestParser& parser,
+                   const std::string_view message) {
+    EXPECT_EQ(parser.method(), HttpMethod::Post);
+    EXPECT_EQ(parser.target().in(message), "/upload?x=1");
+    EXPECT_FALSE(parser.http_1_0());
+    ASSERT_EQ(parser.headers().size(), 3);
+    EXPECT_EQ(parser.headers()[0].name.in(message), "Host");
+    EXPECT_EQ(parser.headers()[0].value.in(message), "localhost");
+    EXPECT_EQ(parser.headers()[1].value.in(message), "5");
+    EXPECT_EQ(parser.headers()[2].value.in(message), "");
+    EXPECT_EQ(parser.body(message), "hello");
+    EXPECT_EQ(parser.length(), REQUEST.size());
+}
+
+/// Parse `message`, letting the body through without a limit
+Result<ParseStatus, internal::ParseError> parse_whole(
+    RequestParser& parser, const std::string_view message) {
+    auto status = parser.parse(message);
+    if (status && *status == ParseStatus::NeedMore && parser.head_complete()) {
+        const auto allowed = parser.allow_body(0);
+        if (!allowed) {
+            return Error{allowed.error()};
+        }
+        status = parser.parse(message);
+    }
+    return status;
+}
+
+HttpStatusCode rejection(const std::string_view message,
+                         const ServerConfig& config = {}) {
+    RequestParser parser{config};
+    const auto status = parse_whole(parser, message);
+    EXPECT_FALSE(status);
+    return status ? HttpStatusCode::Ok_200 : status.error().status;
+}
+}  // namespace
+
+TEST(RequestParser, Whole) {
+    const ServerConfig config;
+    RequestParser parser{config};
+
+    const auto status = parse_whole(parser, REQUEST);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(*status, ParseStatus::Complete);
+    expect_parsed(parser, REQUEST);
+}
+
+TEST(RequestParser, ByteByByte) {
+    const ServerConfig config;
+    RequestParser parser{config};
+
+    for (size_t size = 0; size < REQUEST.size(); ++size) {
+        const auto status = parse_whole(parser, REQUEST.substr(0, size));
+        ASSERT_TRUE(status);
+        ASSERT_EQ(*status, ParseStatus::NeedMore) << size;
+    }
+    const auto status = parser.parse(REQUEST);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(*status, ParseStatus::Complete);
+    expect_parsed(parser, REQUEST);
+}
+
+TEST(RequestParser, Reset) {
+    const ServerConfig config;
+    RequestParser parser{config};
+
+    const std::string two = std::string{REQUEST} + "\r\nGET / HTTP/1.0\n\n";
+    ASSERT_EQ(*parse_whole(parser, two), ParseStatus::Complete);
+    const size_t first_length = parser.length();
+    parser.reset();
+
+    const std::string_view second = std::string_view{two}.substr(first_length);
+    ASSERT_EQ(*parser.parse(second), ParseStatus::Complete);
+    EXPECT_EQ(parser.method(), HttpMethod::Get);
+    EXPECT_EQ(parser.target().in(second), "/");
+    EXPECT_TRUE(parser.http_1_0());
+    EXPECT_TRUE(parser.headers().empty());
+    EXPECT_EQ(parser.length(), second.size());
+}
+
+TEST(RequestParser, SplitEmptyLine) {
+    const ServerConfig config;
+    RequestParser parser{config};
+
+    // the empty line before the request ends in the next part
+    const std::string_view message = "\r\nGET / HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(*parser.parse(message.substr(0, 1)), ParseStatus::NeedMore);
+    ASSERT_EQ(*parser.parse(message), ParseStatus::Complete);
+    EXPECT_EQ(parser.method(), HttpMethod::Get);
+    EXPECT_EQ(parser.target().in(message), "/");
+}
+
+TEST(RequestParser, Malformed) {
+    EXPECT_EQ(rejection("GET  / HTTP/1.1\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("GET /\r\n\r\n"), HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("GET / HTTP/1.1\rX"), HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("GET / HTTP/1.1\r\nNo colon\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("GET / HTTP/1.1\r\nA: b\r\n folded\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("GET / HTTP/1.1\r\nA: b\x01\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("GET / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("GET / HTTP/1.1\r\nContent-Length: 1\r\n"
+                        "Content-Length: 2\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("BREW / HTTP/1.1\r\n\r\n"),
+              HttpStatusCode::NotImplemented_501);
+    EXPECT_EQ(rejection("GET / HTTP/2.0\r\n\r\n"),
+              HttpStatusCode::HTTPVersionNotSupported_505);
+    EXPECT_EQ(rejection("GET / HTTP/1.x\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("GET / HTTP/x.1\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+}
+
+TEST(RequestParser, Limits) {
+    const ServerConfig config{.max_request_line_size = 32,
+                              .max_headers_size = 32,
+                              .max_header_count = 2};
+
+    // detected before the line is complete
+    EXPECT_EQ(rejection("GET /" + std::string(40, 'a'), config),
+              HttpStatusCode::URITooLong_414);
+    EXPECT_EQ(rejection("GET / HTTP/1.1\r\nA: " + std::string(40, 'a'),
+                        config),
+              HttpStatusCode::RequestHeaderFieldsTooLarge_431);
+    EXPECT_EQ(rejection("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n",
+                        config),
+              HttpStatusCode::RequestHeaderFieldsTooLarge_431);
+
+    RequestParser parser{config};
+    const auto status = parser.parse("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\n\r\n");
+    ASSERT_TRUE(status);
+    EXPECT_EQ(*status, ParseStatus::Complete);
+}
+TEST(RequestParser, WaitsForBodyToBeAllowed) {
+    const ServerConfig config;
+    RequestParser parser{config};
+
+    auto status = parser.parse(REQUEST);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(*status, ParseStatus::NeedMore);
+    EXPECT_TRUE(parser.head_complete());
+    EXPECT_EQ(parser.content_length(), 5);
+
+    EXPECT_EQ(parser.allow_body(4).error().status,
+              HttpStatusCode::ContentTooLarge_413);
+    ASSERT_TRUE(parser.allow_body(5));
+    status = parser.parse(REQUEST);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(*status, ParseStatus::Complete);
+    expect_parsed(parser, REQUEST);
+}
+
+TEST(RequestParser, Chunked) {
+    const ServerConfig config;
+    RequestParser parser{config};
+
+    const std::string message =
+        "POST / HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n"
+        "3\r\nabc\r\n2\r\nde\r\n0\r\nChecksum: 1\r\n\r\n"
+        "GET / HTTP/1.1\r\n\r\n";
+    for (size_t size = 0; size < message.find("GET"); ++size) {
+        const auto status = parse_whole(parser, message.substr(0, size));
+        ASSERT_TRUE(status);
+        ASSERT_EQ(*status, ParseStatus::NeedMore) << size;
+    }
+    const auto status = parse_whole(parser, message);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(*status, ParseStatus::Complete);
+
+    EXPECT_TRUE(parser.chunked());
+    EXPECT_EQ(parser.body(message), "abcde");
+    EXPECT_EQ(parser.length(), message.find("GET"));
+    ASSERT_EQ(parser.trailers().size(), 1);
+    EXPECT_EQ(parser.trailers()[0].name, "Checksum");
+}
+
+TEST(RequestParser, RejectsTransferCodings) {
+    EXPECT_EQ(rejection("POST / HTTP/1.1\r\nTransfer-Encoding: gzip, "
+                        "chunked\r\n\r\n"),
+              HttpStatusCode::NotImplemented_501);
+    EXPECT_EQ(rejection("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+                        "Content-Length: 5\r\n\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("POST / HTTP/1.0\r\nTransfer-Encoding: chunked\r\n"
+                        "\r\n"),
+              HttpStatusCode::BadRequest_400);
+    EXPECT_EQ(rejection("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+                        "\r\nz\r\n"),
+              HttpStatusCode::BadRequest_400);
+}
+}  // namespace waxwing
@@ -3,6 +3,14 @@
 #include <fmt/core.h>
 #include <gtest/gtest.h>
 
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
 namespace waxwing {
 using waxwing::internal::RouteTree;
 
@@ -136,6 +144,341 @@ TEST(Router, PathParametersRollback) {
     EXPECT_FALSE(tree.get(HttpMethod::Get, "hello").has_value());
 }
 
+TEST(Router, PrefixRoutes) {
+    auto body_handler = [](std::string_view body) {
+        return [body](const Request&, const PathParameters params) {
+            return ResponseBuilder{HttpStatusCode::Ok_200}
+                .body(fmt::format("{}:{}", body,
+                                  params.empty() ? "" : params[0]))
+                .build();
+        };
+    };
+
+    internal::Router router;
+    router.add_prefix_route(HttpMethod::Get, "/assets", body_handler("assets"));
+    router.add_prefix_route(HttpMethod::Get, "/assets/img/",
+                            body_handler("img"));
+    router.add_route(HttpMethod::Get, "/assets/index", body_handler("index"));
+
+    auto req = RequestBuilder(HttpMethod::Get, "").build();
+    auto body_of = [&](HttpMethod method, std::string_view target) {
+        const internal::RoutingResult result = router.route(method, target);
+        const Response resp = result.handler()(req, result.parameters());
+        return std::string{resp.body().value_or("")};
+    };
+
+    EXPECT_EQ(body_of(HttpMethod::Get, "/assets/js/app.js"),
+              "assets:js/app.js");
+    EXPECT_EQ(body_of(HttpMethod::Get, "/assets/img/logo.png"),
+              "img:logo.png");
+    EXPECT_EQ(body_of(HttpMethod::Get, "/assets/index"), "index:");
+
+    // only whole components match
+    EXPECT_EQ(body_of(HttpMethod::Get, "/assetsfoo"), "");
+    EXPECT_EQ(body_of(HttpMethod::Post, "/assets/js/app.js"), "");
+}
+
+TEST(Router, MethodNotAllowed) {
+    auto ok = [](const Request&, const PathParameters) {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.build();
+    };
+
+    internal::Router router;
+    router.add_route(HttpMethod::Post, "/upload", ok,
+                     RouteConfig{.max_body_size = 10});
+    router.add_prefix_route(HttpMethod::Get, "/assets", ok);
+
+    auto req = RequestBuilder(HttpMethod::Get, "").build();
+    auto status_of = [&](HttpMethod method, std::string_view target) {
+        const internal::RoutingResult result = router.route(method, target);
+        return result.handler()(req, result.parameters()).status();
+    };
+
+    const internal::RoutingResult found =
+        router.route(HttpMethod::Post, "/upload");
+    EXPECT_TRUE(found.found());
+    EXPECT_EQ(found.config().max_body_size, 10);
+
+    EXPECT_FALSE(router.route(HttpMethod::Get, "/upload").found());
+    EXPECT_EQ(router.route(HttpMethod::Get, "/upload").allowed_methods(),
+              internal::method_bit(HttpMethod::Post));
+    EXPECT_EQ(router.route(HttpMethod::Post, "/unknown").allowed_methods(), 0);
+    EXPECT_EQ(status_of(HttpMethod::Get, "/upload"),
+              HttpStatusCode::MethodNotAllowed_405);
+    EXPECT_EQ(status_of(HttpMethod::Post, "/assets/app.js"),
+              HttpStatusCode::MethodNotAllowed_405);
+    EXPECT_EQ(status_of(HttpMethod::Post, "/unknown"),
+              HttpStatusCode::NotFound_404);
+}
+
+TEST(Router, FrozenTableMatchesTree) {
+    auto ok = [](const Request&, const PathParameters) {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.build();
+    };
+
+    // the routers refer to the targets, so they have to outlive them
+    std::vector<std::string> items;
+    items.reserve(300);
+
+    // routes are told apart by their configs
+    internal::Router tree;
+    internal::Router frozen;
+    size_t routes = 0;
+    auto add_route = [&](HttpMethod method, std::string_view target) {
+        const RouteConfig config{.max_body_size = ++routes};
+        tree.add_route(method, target, ok, config);
+        frozen.add_route(method, target, ok, config);
+    };
+    add_route(HttpMethod::Get, "/");
+    add_route(HttpMethod::Get, "/foo/bar");
+    add_route(HttpMethod::Get, "/:param/");
+    add_route(HttpMethod::Post, "/:param/baz");
+    add_route(HttpMethod::Get, "/*any/baz");
+    add_route(HttpMethod::Get, "/users/me");
+    add_route(HttpMethod::Get, "/users/:id");
+    add_route(HttpMethod::Put, "/users/:id");
+    add_route(HttpMethod::Get, "/users/:name/posts/*post");
+    add_route(HttpMethod::Get, "/users/:id/posts/latest");
+    add_route(HttpMethod::Delete, "/users/:id/posts");
+    for (size_t i = 0; i < 300; ++i) {
+        add_route(HttpMethod::Get,
+                  items.emplace_back(fmt::format("/items/{}/:detail", i)));
+    }
+    ASSERT_TRUE(frozen.freeze());
+
+    const std::vector<std::pair<HttpMethod, std::string_view>> targets{
+        {HttpMethod::Get, "/"},
+        {HttpMethod::Get, ""},
+        {HttpMethod::Get, "/foo/bar"},
+        {HttpMethod::Get, "/foo/"},
+        {HttpMethod::Get, "/foo/baz"},
+        {HttpMethod::Post, "/foo/baz"},
+        {HttpMethod::Get, "//baz"},
+        {HttpMethod::Get, "/users/me"},
+        {HttpMethod::Delete, "/users/me"},
+        {HttpMethod::Get, "/users/42"},
+        {HttpMethod::Get, "/users/42/posts/"},
+        {HttpMethod::Get, "/users/42/posts/latest"},
+        {HttpMethod::Get, "/users/42/posts"},
+        {HttpMethod::Get, "/items/0/a"},
+        {HttpMethod::Get, "/items/299/b"},
+        {HttpMethod::Get, "/items/300/c"},
+        {HttpMethod::Get, "/items/17/"},
+        {HttpMethod::Get, "/unknown/path"},
+    };
+    for (const auto& [method, target] : targets) {
+        const internal::RoutingResult expected = tree.route(method, target);
+        const internal::RoutingResult result = frozen.route(method, target);
+        EXPECT_EQ(result.found(), expected.found()) << target;
+        EXPECT_EQ(result.config().max_body_size,
+                  expected.config().max_body_size)
+            << target;
+        EXPECT_EQ(result.allowed_methods(), expected.allowed_methods())
+            << target;
+        const PathParameters expected_params = expected.parameters();
+        const PathParameters params = result.parameters();
+        EXPECT_EQ(std::vector(params.begin(), params.end()),
+                  std::vector(expected_params.begin(), expected_params.end()))
+            << target;
+    }
+
+    // adding a route drops the table, so the route is found
+    frozen.add_route(HttpMethod::Get, "/late", ok);
+    EXPECT_TRUE(frozen.route(HttpMethod::Get, "/late").found());
+}
+
+TEST(Router, FrozenTableResolvesAmbiguity) {
+    auto ok = [](const Request&, const PathParameters) {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.build();
+    };
+
+    // every combination of a literal and two kinds of parameters, so most
+    // targets match several routes
+    const std::vector<std::string_view> route_components{"a", ":p", "*w"};
+    const std::vector<std::string_view> target_components{"a", "b", "", "end"};
+    std::vector<std::string> route_targets{""};
+    for (size_t depth = 0; depth < 3; ++depth) {
+        const size_t count = route_targets.size();
+        for (size_t i = 0; i < count; ++i) {
+            for (const std::string_view component : route_components) {
+                route_targets.push_back(
+                    fmt::format("{}/{}", route_targets[i], component));
+            }
+        }
+    }
+    std::vector<std::string> targets{""};
+    for (size_t depth = 0; depth < 4; ++depth) {
+        const size_t count = targets.size();
+        for (size_t i = 0; i < count; ++i) {
+            for (const std::string_view component : target_components) {
+                targets.push_back(fmt::format("{}/{}", targets[i], component));
+            }
+        }
+    }
+
+    internal::Router tree;
+    internal::Router frozen;
+    for (size_t i = 0; i < route_targets.size(); ++i) {
+        // only some targets end with a route, the rest have to backtrack
+        const std::string& target = route_targets[i];
+        const RouteConfig config{.max_body_size = i};
+        const HttpMethod method =
+            i % 3 == 0 ? HttpMethod::Post : HttpMethod::Get;
+        if (i % 2 == 0) {
+            tree.add_route(method, target, ok, config);
+            frozen.add_route(method, target, ok, config);
+        }
+    }
+    ASSERT_TRUE(frozen.freeze());
+
+    size_t found = 0;
+    for (const std::string& target : targets) {
+        for (const HttpMethod method : {HttpMethod::Get, HttpMethod::Post}) {
+            const internal::RoutingResult expected =
+                tree.route(method, target);
+            const internal::RoutingResult result =
+                frozen.route(method, target);
+            ASSERT_EQ(result.found(), expected.found()) << target;
+            found += result.found() ? 1 : 0;
+            EXPECT_EQ(result.config().max_body_size,
+                      expected.config().max_body_size)
+                << target;
+            EXPECT_EQ(result.allowed_methods(), expected.allowed_methods())
+                << target;
+            const PathParameters expected_params = expected.parameters();
+            const PathParameters params = result.parameters();
+            EXPECT_EQ(
+                std::vector(params.begin(), params.end()),
+                std::vector(expected_params.begin(), expected_params.end()))
+                << target;
+        }
+    }
+    EXPECT_GT(found, 100);
+}
+
+TEST(Router, FrozenTableTracksNodesBeyondMaxStates) {
+    auto ok = [](const Request&, const PathParameters) {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.build();
+    };
+
+    // every node of the literal routes needs a state of its own, so there
+    // are too many of them with the ambiguous routes on top
+    std::deque<std::string> route_targets;
+    for (size_t i = 0; i < 17 * 17 * 17 * 17; ++i) {
+        route_targets.push_back(fmt::format("/a{}/b{}/c{}/d{}", i % 17,
+                                            i / 17 % 17, i / 289 % 17,
+                                            i / 4913));
+    }
+    const std::vector<std::string_view> route_components{"a", ":p", "*w"};
+    const size_t literal_routes = route_targets.size();
+    route_targets.emplace_back("");
+    for (size_t depth = 0; depth < 3; ++depth) {
+        const size_t count = route_targets.size();
+        for (size_t i = literal_routes; i < count; ++i) {
+            for (const std::string_view component : route_components) {
+                route_targets.push_back(
+                    fmt::format("{}/{}", route_targets[i], component));
+            }
+        }
+    }
+
+    RouteTree tree;
+    for (size_t i = 0; i < route_targets.size(); ++i) {
+        const HttpMethod method =
+            i % 3 == 0 ? HttpMethod::Post : HttpMethod::Get;
+        if (i < literal_routes || i % 2 == 0) {
+            tree.insert(method, route_targets[i], ok);
+        }
+    }
+    const std::optional<internal::FrozenRouteTable> table =
+        internal::FrozenRouteTable::compile(tree);
+    ASSERT_TRUE(table.has_value());
+    ASSERT_FALSE(table->determinized());
+
+    std::vector<std::string> targets{""};
+    for (size_t depth = 0; depth < 4; ++depth) {
+        const size_t count = targets.size();
+        for (size_t i = 0; i < count; ++i) {
+            for (const std::string_view component : {"a", "b", "", "end"}) {
+                targets.push_back(fmt::format("{}/{}", targets[i], component));
+            }
+        }
+    }
+    for (const std::string_view target :
+         {"/a0/b0/c0/d0", "/a16/b16/c16/d16", "/a3/b7/c1/d9", "/a3/b7/c1/d17",
+          "/a3/b7/c1/d9/a", "/a17/b0/c0/d0", "/a3/b7/a", "/a3/a/a/end"}) {
+        targets.emplace_back(target);
+    }
+
+    // the same routes are found, with the same parameters
+    size_t found = 0;
+    for (const std::string& target : targets) {
+        for (const HttpMethod method : {HttpMethod::Get, HttpMethod::Post}) {
+            internal::MethodMask expected_allowed = 0;
+            const std::optional<internal::RoutingResult> expected =
+                tree.get(method, target, expected_allowed);
+            internal::MethodMask allowed = 0;
+            const std::optional<internal::RoutingResult> result =
+                table->get(method, target, allowed);
+            ASSERT_EQ(result.has_value(), expected.has_value()) << target;
+            if (!result.has_value()) {
+                EXPECT_EQ(allowed, expected_allowed) << target;
+                continue;
+            }
+            ++found;
+            EXPECT_EQ(&result->config(), &expected->config()) << target;
+            const PathParameters expected_params = expected->parameters();
+            const PathParameters params = result->parameters();
+            EXPECT_EQ(
+                std::vector(params.begin(), params.end()),
+                std::vector(expected_params.begin(), expected_params.end()))
+                << target;
+        }
+    }
+    EXPECT_GT(found, 100);
+
+    // too many parameters may match the same component to track them
+    // without allocating
+    std::deque<std::string> parameter_targets;
+    for (size_t i = 0; i <= internal::FrozenRouteTable::MAX_LOCKSTEP_WIDTH;
+         ++i) {
+        tree.insert(HttpMethod::Get,
+                    parameter_targets.emplace_back(fmt::format("/:p{}/x", i)),
+                    ok);
+    }
+    EXPECT_FALSE(internal::FrozenRouteTable::compile(tree).has_value());
+}
+
+TEST(Router, CollectsAllowedMethods) {
+    auto ok = [](const Request&, const PathParameters) {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.build();
+    };
+
+    internal::Router router;
+    router.add_route(HttpMethod::Get, "/users/me", ok);
+    router.add_route(HttpMethod::Delete, "/users/:id", ok);
+    router.add_route(HttpMethod::Put, "/users/:id", ok);
+    router.add_route(HttpMethod::Patch, "/users/:id/name", ok);
+    router.add_prefix_route(HttpMethod::Get, "/users/me", ok);
+
+    // every route the target matches counts, parameters included
+    const internal::RoutingResult me =
+        router.route(HttpMethod::Post, "/users/me");
+    EXPECT_FALSE(me.found());
+    EXPECT_EQ(me.allow(), "GET, PUT, DELETE");
+
+    const internal::RoutingResult other =
+        router.route(HttpMethod::Get, "/users/42");
+    EXPECT_EQ(other.allow(), "PUT, DELETE");
+
+    const internal::RoutingResult prefixed =
+        router.route(HttpMethod::Post, "/users/me/avatar");
+    EXPECT_EQ(prefixed.allow(), "GET");
+    EXPECT_EQ(internal::format_allowed_methods(
+                  (1U << internal::METHOD_COUNT) - 1),
+              "GET, HEAD, POST, PUT, DELETE, CONNECT, OPTIONS, TRACE, PATCH");
+}
+
 TEST(Router, RouteValidation) {
     EXPECT_TRUE(internal::RouteTarget::check("/foo/bar"));
     EXPECT_TRUE(internal::RouteTarget::check("foo/bar/"));
@@ -145,5 +488,9 @@ TEST(Router, RouteValidation) {
     EXPECT_FALSE(internal::RouteTarget::check("/b?/"));
     EXPECT_FALSE(internal::RouteTarget::check("/::foo/"));
     EXPECT_FALSE(internal::RouteTarget::check("/*action*"));
+    EXPECT_TRUE(internal::RouteTarget::check(
+        "/:a/:b/:c/:d/:e/:f/:g/:h/:i/:j/:k/:l/:m/:n/:o/:p"));
+    EXPECT_FALSE(internal::RouteTarget::check(
+        "/:a/:b/:c/:d/:e/:f/:g/:h/:i/:j/:k/:l/:m/:n/:o/:p/:q"));
 }
 }  // namespace waxwing
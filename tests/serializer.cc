@@ -0,0 +1,81 @@
+#include "serializer.hh"
+
+#include <gtest/gtest.h>
+
+#include <regex>
+#include <string>
+#include <string_view>
+
+#include "waxwing/http.hh"
+
+namespace waxwing {
+using internal::HeadFields;
+using internal::serialize_head;
+
+TEST(Serializer, StatusLines) {
+    EXPECT_EQ(format_status_line(HttpStatusCode::Ok_200),
+              "HTTP/1.1 200 OK\r\n");
+    EXPECT_EQ(
+        format_status_line(HttpStatusCode::NetworkAuthenticationRequired_511),
+        "HTTP/1.1 511 Network Authentication Required\r\n");
+    EXPECT_EQ(format_status_code(HttpStatusCode::NotFound_404),
+              "404 Not Found");
+}
+
+TEST(Serializer, FormatsDate) {
+    const std::string_view date = internal::date_header();
+    EXPECT_TRUE(std::regex_match(
+        std::string{date},
+        std::regex{"Date: (Mon|Tue|Wed|Thu|Fri|Sat|Sun), [0-9]{2} "
+                   "(Jan|Feb|Mar|Apr|May|Jun|Jul|Aug|Sep|Oct|Nov|Dec) "
+                   "[0-9]{4} [0-9]{2}:[0-9]{2}:[0-9]{2} GMT\r\n"}))
+        << date;
+    // the same line is handed out until the second changes
+    EXPECT_EQ(internal::date_header().data(), date.data());
+}
+
+TEST(Serializer, ReplacesServerFields) {
+    Headers headers;
+    headers.insert("Content-Type", "text/plain");
+    headers.insert("content-length", "5");
+    headers.insert("Connection", "keep-alive");
+
+    std::string head = "previous";
+    serialize_head(head, HttpStatusCode::Ok_200, headers,
+                   HeadFields{.content_length = 12345678901234,
+                              .connection = "close",
+                              .date = false});
+    EXPECT_EQ(head,
+              "previousHTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+              "Content-Length: 12345678901234\r\nConnection: close\r\n");
+
+    // fields the server doesn't write are left alone
+    head.clear();
+    serialize_head(head, HttpStatusCode::NoContent_204, headers,
+                   HeadFields{.date = false});
+    EXPECT_EQ(head,
+              "HTTP/1.1 204 No Content\r\nContent-Type: text/plain\r\n"
+              "content-length: 5\r\nConnection: keep-alive\r\n");
+
+    // a chunked body is never framed with a length as well
+    head.clear();
+    serialize_head(head, HttpStatusCode::Ok_200, headers,
+                   HeadFields{.chunked = true, .date = false});
+    EXPECT_EQ(head,
+              "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+              "Connection: keep-alive\r\nTransfer-Encoding: chunked\r\n");
+}
+
+TEST(Serializer, KeepsHandlersDate) {
+    Headers headers;
+    std::string head;
+    serialize_head(head, HttpStatusCode::Ok_200, headers, HeadFields{});
+    EXPECT_TRUE(head.ends_with(internal::date_header()));
+
+    headers.insert("Date", "Sun, 06 Nov 1994 08:49:37 GMT");
+    head.clear();
+    serialize_head(head, HttpStatusCode::Ok_200, headers, HeadFields{});
+    EXPECT_EQ(head,
+              "HTTP/1.1 200 OK\r\nDate: Sun, 06 Nov 1994 08:49:37 GMT\r\n");
+}
+}  // namespace waxwing
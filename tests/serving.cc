@@ -0,0 +1,371 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "epoll_server.hh"
+#include "uring_server.hh"
+#include "waxwing/config.hh"
+#include "waxwing/io.hh"
+#include "waxwing/router.hh"
+#include "waxwing/server.hh"
+
+namespace waxwing {
+using internal::Connection;
+using internal::Router;
+using internal::Socket;
+
+namespace {
+using ServeFunction = Result<void, std::string> (*)(const Router&,
+                                                    const Socket&,
+                                                    const ServerConfig&);
+
+/// Serve `router` on a loopback port from a thread of its own, returning the
+/// port. Serving only returns on failure, so the server is left running
+/// until the test exits
+uint16_t start_server(const ServeFunction serve, Router router,
+                      const ServerConfig& config = {}) {
+    spdlog::set_level(spdlog::level::warn);
+
+    struct Served {
+        Router router;
+        ServerConfig config;
+        Socket socket;
+    };
+    Result<Socket, std::string> socket = Socket::create("127.0.0.1", 0, 64);
+    if (!socket) {
+        ADD_FAILURE() << socket.error();
+        return 0;
+    }
+    auto* const served =
+        new Served{std::move(router), config, std::move(*socket)};
+
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+    ::getsockname(served->socket.fd(), reinterpret_cast<sockaddr*>(&address),
+                  &length);
+
+    std::thread{[serve, served] {
+        const Result<void, std::string> result =
+            serve(served->router, served->socket, served->config);
+        ADD_FAILURE() << (result ? "serving returned" : result.error());
+    }}.detach();
+    return ntohs(address.sin_port);
+}
+
+/// Bind `server` to a loopback port and serve in `mode` from a thread of its
+/// own, returning the port. The server is left running until the test exits
+uint16_t start_server(std::unique_ptr<Server> server, const ServeMode mode,
+                      const bool share_port = false) {
+    spdlog::set_level(spdlog::level::warn);
+    const Result<void, std::string> bound =
+        server->bind("127.0.0.1", 0, 64, share_port);
+    if (!bound) {
+        ADD_FAILURE() << bound.error();
+        return 0;
+    }
+    const uint16_t port = server->port();
+    std::thread{[server = std::move(server), mode] {
+        server->serve(mode);
+    }}.detach();
+    return port;
+}
+
+/// Blocking connection to the `port` of the loopback, with socket buffers of
+/// `buffer_size` unless it's zero
+Connection connect_to(const uint16_t port, const int buffer_size = 0) {
+    Connection connection{::socket(AF_INET, SOCK_STREAM, 0)};
+    if (buffer_size != 0) {
+        for (const int option : {SO_RCVBUF, SO_SNDBUF}) {
+            ::setsockopt(connection.fd(), SOL_SOCKET, option, &buffer_size,
+                         sizeof(buffer_size));
+        }
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    EXPECT_EQ(::connect(connection.fd(), reinterpret_cast<sockaddr*>(&address),
+                        sizeof(address)),
+              0);
+    return connection;
+}
+
+void send_all(const Connection& connection, const std::string_view data) {
+    EXPECT_EQ(connection.send(std::span{data.data(), data.size()}),
+              data.size());
+}
+
+/// Receive until `done` says the received data is complete, or the peer
+/// closes the connection
+template <typename F>
+std::string receive_until(const Connection& connection, F&& done) {
+    std::string received;
+    while (!done(received) && connection.recv(received, 64 * 1024) > 0) {
+    }
+    return received;
+}
+
+/// Receive a single response, whose body has a known length
+std::string receive_response(const Connection& connection) {
+    return receive_until(connection, [](const std::string_view received) {
+        const size_t head_end = received.find("\r\n\r\n");
+        const size_t length_pos = received.find("Content-Length: ");
+        if (head_end == std::string_view::npos ||
+            length_pos == std::string_view::npos) {
+            return false;
+        }
+        const size_t length = std::stoul(
+            std::string{received.substr(length_pos + 16, 20)});
+        return received.size() >= head_end + 4 + length;
+    });
+}
+
+size_t count(const std::string_view haystack, const std::string_view needle) {
+    size_t result = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string_view::npos;
+         pos = haystack.find(needle, pos + needle.size())) {
+        ++result;
+    }
+    return result;
+}
+
+Router page_router(const size_t size) {
+    Router router;
+    router.add_route(HttpMethod::Get, "/page",
+                     [size](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body(std::string(size, 'x'))
+                             .build();
+                     });
+    return router;
+}
+
+/// Pipeline `requests` to a `/page` of `body_size` bytes without reading the
+/// responses at first, checking that the server stops receiving them, and
+/// that every one is answered once they're read
+void pipeline_without_reading(const uint16_t port, const size_t requests,
+                              const size_t body_size) {
+    const Connection connection = connect_to(port, 4096);
+
+    std::string burst;
+    for (size_t i = 0; i < requests; ++i) {
+        burst += "GET /page HTTP/1.1\r\n\r\n";
+    }
+    std::atomic<bool> sent = false;
+    std::thread writer{[&] {
+        send_all(connection, burst);
+        sent = true;
+    }};
+
+    // a server that kept receiving would take the whole burst by now
+    std::this_thread::sleep_for(std::chrono::milliseconds{300});
+    EXPECT_FALSE(sent);
+
+    // the responses only differ in their bodies
+    const std::string responses =
+        receive_until(connection, [&](const std::string_view received) {
+            const size_t head_end = received.find("\r\n\r\n");
+            return head_end != std::string_view::npos &&
+                   received.size() >= requests * (head_end + 4 + body_size);
+        });
+    writer.join();
+    EXPECT_TRUE(sent);
+    EXPECT_EQ(count(responses, "HTTP/1.1 200"), requests);
+}
+/// Check that a connection to `port` is closed by the server once it stays
+/// idle after a request, which has to happen within a second
+void expect_closed_when_idle(const uint16_t port) {
+    const Connection connection = connect_to(port);
+    // a server that never closes it makes the receive fail instead
+    const timeval timeout{.tv_sec = 1, .tv_usec = 0};
+    ::setsockopt(connection.fd(), SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                 sizeof(timeout));
+
+    send_all(connection, "GET /page HTTP/1.1\r\n\r\n");
+    EXPECT_TRUE(receive_response(connection).starts_with("HTTP/1.1 200"));
+
+    std::array<char, 16> buffer{};
+    const internal::IoResult received = connection.try_recv(buffer);
+    ASSERT_TRUE(received) << std::make_error_code(received.error()).message();
+    EXPECT_EQ(*received, 0);
+}
+
+Router hello_router() {
+    Router router;
+    router.add_route(HttpMethod::Get, "/page",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body("hello")
+                             .build();
+                     });
+    return router;
+}
+
+/// Whether the kernel lets us set up an io_uring instance at all
+bool uring_available() {
+    io_uring_params params{};
+    const long fd = ::syscall(__NR_io_uring_setup, 1, &params);
+    if (fd < 0) {
+        return false;
+    }
+    ::close(static_cast<int>(fd));
+    return true;
+}
+}  // namespace
+
+TEST(Epoll, SendsLargeResponseToSlowReader) {
+    constexpr size_t SIZE = 8 * 1024 * 1024;
+    const uint16_t port =
+        start_server(&internal::serve_epoll, page_router(SIZE));
+    const Connection connection = connect_to(port, 4096);
+
+    send_all(connection, "GET /page HTTP/1.1\r\n\r\n");
+    // the socket fills up and the rest waits until it's writable again
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    const std::string response = receive_response(connection);
+    ASSERT_TRUE(response.starts_with("HTTP/1.1 200"));
+    const std::string_view body =
+        std::string_view{response}.substr(response.find("\r\n\r\n") + 4);
+    EXPECT_EQ(body.size(), SIZE);
+    EXPECT_EQ(body.find_first_not_of('x'), std::string_view::npos);
+}
+
+TEST(Epoll, StopsReceivingFromClientThatDoesNotRead) {
+    const uint16_t port =
+        start_server(&internal::serve_epoll, page_router(1024),
+                     {.max_requests_per_connection = 0});
+    pipeline_without_reading(port, 20000, 1024);
+}
+
+TEST(Uring, KeepsConnectionAliveUntilClosed) {
+    if (!uring_available()) {
+        GTEST_SKIP() << "io_uring isn't available";
+    }
+    const uint16_t port =
+        start_server(&internal::serve_uring, page_router(16));
+    const Connection connection = connect_to(port);
+
+    for (int request = 0; request < 2; ++request) {
+        send_all(connection, "GET /page HTTP/1.1\r\n\r\n");
+        const std::string response = receive_response(connection);
+        EXPECT_TRUE(response.starts_with("HTTP/1.1 200")) << request;
+        EXPECT_TRUE(response.ends_with("\r\n\r\nxxxxxxxxxxxxxxxx"))
+            << request;
+    }
+
+    send_all(connection, "GET /page HTTP/1.1\r\nConnection: close\r\n\r\n");
+    // received until the server closes the connection
+    const std::string last =
+        receive_until(connection, [](const std::string_view) { return false; });
+    EXPECT_TRUE(last.starts_with("HTTP/1.1 200"));
+    EXPECT_EQ(count(last, "Connection: close\r\n"), 1);
+    EXPECT_TRUE(last.ends_with("\r\n\r\nxxxxxxxxxxxxxxxx"));
+}
+
+TEST(Uring, StopsReceivingFromClientThatDoesNotRead) {
+    if (!uring_available()) {
+        GTEST_SKIP() << "io_uring isn't available";
+    }
+    const uint16_t port =
+        start_server(&internal::serve_uring, page_router(1024),
+                     {.max_requests_per_connection = 0});
+    pipeline_without_reading(port, 20000, 1024);
+}
+
+TEST(Sharded, ServesOnPortPickedByKernel) {
+    auto server = std::make_unique<Server>();
+    server->route(HttpMethod::Get, "/page", [] {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.body("sharded").build();
+    });
+    const uint16_t port =
+        start_server(std::move(server), ServeMode::Sharded, true);
+    ASSERT_NE(port, 0);
+
+    // the kernel spreads the connections over the shards, every one of them
+    // must be listening on the reported port
+    for (int client = 0; client < 32; ++client) {
+        const Connection connection = connect_to(port);
+        send_all(connection, "GET /page HTTP/1.1\r\n\r\n");
+        const std::string response = receive_response(connection);
+        EXPECT_TRUE(response.starts_with("HTTP/1.1 200")) << client;
+        EXPECT_TRUE(response.ends_with("\r\n\r\nsharded")) << client;
+    }
+}
+
+TEST(ThreadPool, ClosesIdleConnection) {
+    auto server = std::make_unique<Server>();
+    server->route(HttpMethod::Get, "/page", [] {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.body("hello").build();
+    });
+    server->configure({.idle_timeout = std::chrono::milliseconds{100}});
+    expect_closed_when_idle(
+        start_server(std::move(server), ServeMode::ThreadPool));
+}
+
+TEST(ThreadPool, ServesWhileClientsStayIdle) {
+    auto server = std::make_unique<Server>();
+    server->route(HttpMethod::Get, "/page", [] {
+        return ResponseBuilder{HttpStatusCode::Ok_200}.body("hello").build();
+    });
+    server->configure({.idle_timeout = std::chrono::hours{1}});
+    const uint16_t port =
+        start_server(std::move(server), ServeMode::ThreadPool);
+
+    // more idle clients than workers, some in the middle of a request, none
+    // of which may keep a worker waiting
+    std::vector<Connection> idle;
+    for (unsigned i = 0; i < std::thread::hardware_concurrency() + 2; ++i) {
+        idle.push_back(connect_to(port));
+        if (i % 2 == 0) {
+            send_all(idle.back(), "GET /pa");
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+
+    const Connection connection = connect_to(port);
+    const timeval timeout{.tv_sec = 1, .tv_usec = 0};
+    ::setsockopt(connection.fd(), SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                 sizeof(timeout));
+    send_all(connection, "GET /page HTTP/1.1\r\n\r\n");
+    EXPECT_TRUE(receive_response(connection).ends_with("\r\n\r\nhello"));
+
+    // the parked requests are served once the rest of them arrives
+    send_all(idle.front(), "ge HTTP/1.1\r\n\r\n");
+    EXPECT_TRUE(receive_response(idle.front()).ends_with("\r\n\r\nhello"));
+}
+
+TEST(Epoll, ClosesIdleConnection) {
+    expect_closed_when_idle(
+        start_server(&internal::serve_epoll, hello_router(),
+                     {.idle_timeout = std::chrono::milliseconds{100}}));
+}
+
+TEST(Uring, ClosesIdleConnection) {
+    if (!uring_available()) {
+        GTEST_SKIP() << "io_uring isn't available";
+    }
+    expect_closed_when_idle(
+        start_server(&internal::serve_uring, hello_router(),
+                     {.idle_timeout = std::chrono::milliseconds{100}}));
+}
+}  // namespace waxwing
@@ -0,0 +1,809 @@
+#include "session.hh"
+
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "waxwing/config.hh"
+#include "waxwing/router.hh"
+#include "waxwing/static_routes.hh"
+
+namespace waxwing {
+using internal::Router;
+using internal::Session;
+
+namespace {
+Router hello_router() {
+    Router router;
+    router.add_route(HttpMethod::Get, "/hello",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body("hello")
+                             .build();
+                     });
+    return router;
+}
+
+/// Router with a `POST /upload` route, echoing bodies of up to 8 bytes
+Router upload_router() {
+    Router router = hello_router();
+    router.add_route(
+        HttpMethod::Post, "/upload",
+        [](const Request& req, const PathParameters) {
+            return ResponseBuilder{HttpStatusCode::Ok_200}
+                .body(std::string{req.body()})
+                .build();
+        },
+        RouteConfig{.max_body_size = 8});
+    return router;
+}
+
+/// Everything the session has to send, concatenated
+std::string output_of(Session& session) {
+    internal::OutputBuffer output = session.take_output();
+    std::string result;
+
+    std::array<iovec, internal::OutputBuffer::MAX_IOVECS> iovecs{};
+    while (!output.empty()) {
+        const size_t count = output.gather(iovecs);
+        size_t gathered = 0;
+        for (size_t i = 0; i < count; ++i) {
+            result.append(static_cast<const char*>(iovecs[i].iov_base),
+                          iovecs[i].iov_len);
+            gathered += iovecs[i].iov_len;
+        }
+        output.consume(gathered);
+    }
+    return result;
+}
+
+size_t count(const std::string_view haystack, const std::string_view needle) {
+    size_t result = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string_view::npos;
+         pos = haystack.find(needle, pos + needle.size())) {
+        ++result;
+    }
+    return result;
+}
+}  // namespace
+
+TEST(Session, KeepsHttp11ConnectionsAlive) {
+    const Router router = hello_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /hello HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_TRUE(output.starts_with("HTTP/1.1 200"));
+    EXPECT_FALSE(session.should_close());
+    EXPECT_EQ(count(output, "Connection"), 0);
+
+    session.feed("GET /hello HTTP/1.1\r\n\r\n");
+    EXPECT_TRUE(output_of(session).starts_with("HTTP/1.1 200"));
+    EXPECT_FALSE(session.should_close());
+}
+
+TEST(Session, HonorsConnectionClose) {
+    const Router router = hello_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed(
+        "GET /hello HTTP/1.1\r\nConnection: keep-alive, Close\r\n\r\n"
+        "GET /hello HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_EQ(count(output, "HTTP/1.1 200"), 1);
+    EXPECT_EQ(count(output, "Connection: close\r\n"), 1);
+    EXPECT_TRUE(session.should_close());
+}
+
+TEST(Session, Http10ClosesUnlessAsked) {
+    const Router router = hello_router();
+    const ServerConfig config;
+
+    Session session{router, config};
+    session.feed("GET /hello HTTP/1.0\r\n\r\n");
+    EXPECT_EQ(count(output_of(session), "Connection: close\r\n"), 1);
+    EXPECT_TRUE(session.should_close());
+
+    Session keep_alive{router, config};
+    keep_alive.feed("GET /hello HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    EXPECT_EQ(count(output_of(keep_alive), "Connection: keep-alive\r\n"),
+              1);
+    EXPECT_FALSE(keep_alive.should_close());
+}
+
+TEST(Session, RequestsLimit) {
+    const Router router = hello_router();
+    const ServerConfig config{.max_requests_per_connection = 2};
+    Session session{router, config};
+
+    session.feed("GET /hello HTTP/1.1\r\n\r\n");
+    EXPECT_FALSE(session.should_close());
+    session.feed("GET /hello HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_EQ(count(output, "HTTP/1.1 200"), 2);
+    EXPECT_EQ(count(output, "Connection: close\r\n"), 1);
+    EXPECT_TRUE(session.should_close());
+}
+
+TEST(Session, RequestSplitAcrossReads) {
+    const Router router = hello_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /hel");
+    EXPECT_FALSE(session.has_output());
+    session.feed("lo HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\n");
+    EXPECT_EQ(count(output_of(session), "HTTP/1.1 200"), 1);
+    session.feed("\r\n");
+    EXPECT_EQ(count(output_of(session), "HTTP/1.1 200"), 1);
+}
+
+TEST(Session, ReceivesIntoInputBuffer) {
+    const Router router = hello_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    const auto receive = [&session](const std::string_view data) {
+        const std::span<char> space = session.input_buffer();
+        ASSERT_GE(space.size(), data.size());
+        std::copy(data.begin(), data.end(), space.begin());
+        session.commit_input(data.size());
+    };
+
+    receive("GET /hello HTTP/1.1\r\n");
+    EXPECT_FALSE(session.has_output());
+    receive("\r\nGET /hello HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(count(output_of(session), "HTTP/1.1 200"), 2);
+
+    // nothing received
+    session.input_buffer();
+    session.commit_input(0);
+    EXPECT_FALSE(session.has_output());
+}
+
+TEST(Session, EmptyBodyHasLength) {
+    const Router router = hello_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /unknown HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_TRUE(output.starts_with("HTTP/1.1 404"));
+    EXPECT_EQ(count(output, "Content-Length: 0\r\n"), 1);
+}
+
+TEST(Session, RejectsOversizedRequests) {
+    const Router router = hello_router();
+    const ServerConfig config{.max_request_line_size = 64,
+                              .max_headers_size = 64};
+
+    Session long_target{router, config};
+    long_target.feed("GET /" + std::string(100, 'a'));
+    EXPECT_TRUE(output_of(long_target).starts_with("HTTP/1.1 414"));
+    EXPECT_TRUE(long_target.should_close());
+
+    // the limit holds even when the whole head arrives at once
+    Session large_headers{router, config};
+    large_headers.feed("GET /hello HTTP/1.1\r\nX-Large: " +
+                       std::string(100, 'a') + "\r\n\r\n");
+    EXPECT_TRUE(output_of(large_headers).starts_with("HTTP/1.1 431"));
+    EXPECT_TRUE(large_headers.should_close());
+}
+
+TEST(Session, RejectsMalformedRequests) {
+    const Router router = hello_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /hello HTTP/1.1\r\n\r\nGET /hello\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_TRUE(output.starts_with("HTTP/1.1 200"));
+    EXPECT_EQ(count(output, "HTTP/1.1 400"), 1);
+    EXPECT_TRUE(session.should_close());
+}
+TEST(Session, RoutesBeforeBody) {
+    const Router router = upload_router();
+    const ServerConfig config;
+
+    Session accepted{router, config};
+    accepted.feed("POST /upload HTTP/1.1\r\nContent-Length: 4\r\n\r\n");
+    EXPECT_FALSE(accepted.has_output());
+    accepted.feed("ab");
+    EXPECT_FALSE(accepted.has_output());
+    accepted.feed("cd");
+    const std::string output = output_of(accepted);
+    EXPECT_TRUE(output.starts_with("HTTP/1.1 200"));
+    EXPECT_TRUE(output.ends_with("\r\n\r\nabcd"));
+    EXPECT_FALSE(accepted.should_close());
+
+    // refused without waiting for the body
+    Session not_found{router, config};
+    not_found.feed("POST /unknown HTTP/1.1\r\nContent-Length: 100\r\n\r\n");
+    EXPECT_TRUE(output_of(not_found).starts_with("HTTP/1.1 404"));
+    EXPECT_TRUE(not_found.should_close());
+
+    Session not_allowed{router, config};
+    not_allowed.feed("PUT /upload HTTP/1.1\r\nContent-Length: 100\r\n\r\n");
+    const std::string refused = output_of(not_allowed);
+    EXPECT_TRUE(refused.starts_with("HTTP/1.1 405"));
+    EXPECT_EQ(count(refused, "Allow: POST\r\n"), 1);
+    EXPECT_TRUE(not_allowed.should_close());
+
+    // whole requests are answered like before, on the same connection
+    Session received{router, config};
+    received.feed("PUT /upload HTTP/1.1\r\nContent-Length: 2\r\n\r\nab");
+    EXPECT_TRUE(output_of(received).starts_with("HTTP/1.1 405"));
+    EXPECT_FALSE(received.should_close());
+}
+
+TEST(Session, LimitsBodySize) {
+    const Router router = upload_router();
+    const ServerConfig config{.max_body_size = 4};
+
+    Session too_large{router, config};
+    too_large.feed("POST /upload HTTP/1.1\r\nContent-Length: 9\r\n\r\n");
+    EXPECT_TRUE(output_of(too_large).starts_with("HTTP/1.1 413"));
+    EXPECT_TRUE(too_large.should_close());
+
+    // the route overrides the server-wide limit
+    Session route_limit{router, config};
+    route_limit.feed(
+        "POST /upload HTTP/1.1\r\nContent-Length: 8\r\n\r\n12345678");
+    EXPECT_TRUE(output_of(route_limit).starts_with("HTTP/1.1 200"));
+
+    Session server_limit{router, config};
+    server_limit.feed("GET /hello HTTP/1.1\r\nContent-Length: 5\r\n\r\n");
+    EXPECT_TRUE(output_of(server_limit).starts_with("HTTP/1.1 413"));
+}
+
+TEST(Session, ContinuesExpectedBody) {
+    const Router router = upload_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed(
+        "POST /upload HTTP/1.1\r\nExpect: 100-continue\r\n"
+        "Content-Length: 2\r\n\r\n");
+    EXPECT_EQ(output_of(session), "HTTP/1.1 100 Continue\r\n\r\n");
+    session.feed("ab");
+    EXPECT_TRUE(output_of(session).starts_with("HTTP/1.1 200"));
+}
+namespace {
+/// Collects the chunks of a body, answering with their number and contents
+class CollectingConsumer final : public BodyConsumer {
+    std::string body_;
+    size_t chunks_ = 0;
+
+public:
+    void consume(const std::span<const char> chunk) override {
+        if (std::string_view{chunk.data(), chunk.size()} == "throw") {
+            throw std::runtime_error{"unexpected chunk"};
+        }
+        body_.append(chunk.data(), chunk.size());
+        ++chunks_;
+    }
+
+    Response finish() override {
+        return ResponseBuilder{HttpStatusCode::Ok_200}
+            .body(std::to_string(chunks_) + ":" + body_)
+            .build();
+    }
+};
+
+Router streaming_router() {
+    Router router = hello_router();
+    router.add_streaming_route(
+        HttpMethod::Post, "/stream",
+        [](const Request&, const PathParameters) {
+            return std::make_unique<CollectingConsumer>();
+        });
+    return router;
+}
+}  // namespace
+
+TEST(Session, StreamsBody) {
+    const Router router = streaming_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("POST /stream HTTP/1.1\r\nContent-Length: 6\r\n\r\nab");
+    EXPECT_FALSE(session.has_output());
+    session.feed("cd");
+    EXPECT_FALSE(session.has_output());
+    session.feed("efGET /hello HTTP/1.1\r\n\r\n");
+
+    const std::string output = output_of(session);
+    EXPECT_EQ(count(output, "HTTP/1.1 200"), 2);
+    EXPECT_EQ(count(output, "\r\n\r\n3:abcdef"), 1);
+    EXPECT_FALSE(session.should_close());
+
+    Session empty{router, config};
+    empty.feed("POST /stream HTTP/1.1\r\n\r\n");
+    EXPECT_TRUE(output_of(empty).ends_with("\r\n\r\n0:"));
+}
+
+TEST(Session, StreamingConsumerThrows) {
+    const Router router = streaming_router();
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("POST /stream HTTP/1.1\r\nContent-Length: 9\r\n\r\n");
+    session.feed("throw");
+    EXPECT_TRUE(output_of(session).starts_with("HTTP/1.1 500"));
+    EXPECT_TRUE(session.should_close());
+}
+TEST(Session, DecodesChunkedBody) {
+    const Router router = upload_router();
+    const ServerConfig config;
+
+    Session session{router, config};
+    session.feed(
+        "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "3\r\nabc\r");
+    EXPECT_FALSE(session.has_output());
+    session.feed("\n2\r\nde\r\n0\r\n\r\nGET /hello HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_EQ(count(output, "HTTP/1.1 200"), 2);
+    EXPECT_EQ(count(output, "\r\n\r\nabcde"), 1);
+    EXPECT_FALSE(session.should_close());
+
+    // the route allows 8 bytes at most
+    Session too_large{router, config};
+    too_large.feed(
+        "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5\r\nabcde\r\n5\r\n");
+    EXPECT_TRUE(output_of(too_large).starts_with("HTTP/1.1 413"));
+    EXPECT_TRUE(too_large.should_close());
+}
+
+namespace {
+/// Answers with the trailer fields of the body
+class TrailerConsumer final : public BodyConsumer {
+    std::string body_;
+    std::string trailers_;
+
+public:
+    void consume(const std::span<const char> chunk) override {
+        body_.append(chunk.data(), chunk.size());
+    }
+
+    void consume_trailers(
+        const std::span<const HeaderField> trailers) override {
+        for (const HeaderField& field : trailers) {
+            trailers_ += std::string{field.name} + "=" +
+                         std::string{field.value} + ";";
+        }
+    }
+
+    Response finish() override {
+        return ResponseBuilder{HttpStatusCode::Ok_200}
+            .body(body_ + "|" + trailers_)
+            .build();
+    }
+};
+}  // namespace
+
+TEST(Session, StreamsChunkedBody) {
+    Router router;
+    router.add_streaming_route(HttpMethod::Post, "/stream",
+                               [](const Request&, const PathParameters) {
+                                   return std::make_unique<TrailerConsumer>();
+                               });
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed(
+        "POST /stream HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "3\r\nab");
+    session.feed("c\r\n0\r\nChecksum: 1\r\n");
+    EXPECT_FALSE(session.has_output());
+    session.feed("\r\n");
+    EXPECT_TRUE(output_of(session).ends_with("\r\n\r\nabc|Checksum=1;"));
+    EXPECT_FALSE(session.should_close());
+}
+namespace {
+/// Producer of `count` pieces of `size` bytes, counting the calls
+BodyProducer counting_producer(size_t count, size_t size, size_t& calls) {
+    return [count, size, &calls]() -> std::optional<std::string> {
+        if (calls == count) {
+            return std::nullopt;
+        }
+        return std::string(size, static_cast<char>('a' + calls++ % 26));
+    };
+}
+
+Router producing_router(size_t& calls) {
+    Router router = hello_router();
+    router.add_route(HttpMethod::Get, "/chunked",
+                     [&calls](const Request&, const PathParameters) {
+                         calls = 0;
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .producer(counting_producer(2, 3, calls))
+                             .build();
+                     });
+    router.add_route(HttpMethod::Get, "/sized",
+                     [&calls](const Request&, const PathParameters) {
+                         calls = 0;
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .producer(counting_producer(2, 3, calls), 6)
+                             .build();
+                     });
+    router.add_route(HttpMethod::Get, "/large",
+                     [&calls](const Request&, const PathParameters) {
+                         calls = 0;
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .producer(counting_producer(64, 16384, calls))
+                             .build();
+                     });
+    return router;
+}
+}  // namespace
+
+TEST(Session, ProducesChunkedBody) {
+    size_t calls = 0;
+    const Router router = producing_router(calls);
+    const ServerConfig config;
+    Session session{router, config};
+
+    // the pipelined request is answered after the produced body
+    session.feed("GET /chunked HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_EQ(count(output, "Transfer-Encoding: chunked\r\n"), 1);
+    EXPECT_EQ(count(output, "Content-Length"), 1);
+    EXPECT_EQ(count(output, "\r\n\r\n3\r\naaa\r\n3\r\nbbb\r\n0\r\n\r\n"
+                            "HTTP/1.1 200 OK\r\n"),
+              1);
+    EXPECT_TRUE(output.ends_with("hello"));
+    EXPECT_FALSE(session.should_close());
+}
+
+TEST(Session, ProducesSizedBody) {
+    size_t calls = 0;
+    const Router router = producing_router(calls);
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /sized HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_EQ(count(output, "Content-Length: 6\r\n"), 1);
+    EXPECT_TRUE(output.ends_with("\r\n\r\naaabbb"));
+
+    // HTTP/1.0 has no chunked coding, the end of the body is the end of the
+    // connection
+    Session http_1_0{router, config};
+    http_1_0.feed("GET /chunked HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    const std::string closed = output_of(http_1_0);
+    EXPECT_EQ(count(closed, "Transfer-Encoding"), 0);
+    EXPECT_EQ(count(closed, "Content-Length"), 0);
+    EXPECT_EQ(count(closed, "Connection: close\r\n"), 1);
+    EXPECT_TRUE(closed.ends_with("\r\n\r\naaabbb"));
+    EXPECT_TRUE(http_1_0.should_close());
+}
+
+TEST(Session, AnswersHeadWithoutBody) {
+    size_t calls = 0;
+    Router router = producing_router(calls);
+    router.add_route(HttpMethod::Head, "/hello",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body("hello")
+                             .build();
+                     });
+    router.add_route(HttpMethod::Head, "/chunked",
+                     [&calls](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .producer(counting_producer(2, 3, calls))
+                             .build();
+                     });
+    router.add_prepared_route(
+        HttpMethod::Head, "/health",
+        PreparedResponse{
+            ResponseBuilder{HttpStatusCode::Ok_200}.body("ok").build()});
+    const ServerConfig config;
+    Session session{router, config};
+
+    // the head is framed for the body, and the next response follows it
+    // right away
+    session.feed(
+        "HEAD /hello HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\n\r\n"
+        "HEAD /health HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\n\r\n"
+        "HEAD /chunked HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_EQ(count(output, "Content-Length: 5\r\n"), 4);
+    EXPECT_EQ(count(output, "Content-Length: 2\r\n"), 1);
+    EXPECT_EQ(count(output, "Transfer-Encoding: chunked\r\n"), 1);
+    EXPECT_EQ(count(output, "\r\n\r\nHTTP/1.1 200 OK\r\n"), 3);
+    EXPECT_EQ(count(output, "hello"), 3);
+    EXPECT_EQ(count(output, "ok"), 0);
+    EXPECT_EQ(calls, 0);
+    EXPECT_TRUE(output.ends_with("\r\n\r\nhello"));
+    EXPECT_FALSE(session.should_close());
+}
+
+TEST(Session, ProducesOnlyWhatIsTaken) {
+    size_t calls = 0;
+    const Router router = producing_router(calls);
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /large HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(calls, 0);
+    ASSERT_TRUE(session.has_output());
+    session.take_output();
+    const size_t first_batch = calls;
+    EXPECT_GT(first_batch, 0);
+    EXPECT_LT(first_batch, 64);
+
+    size_t batches = 1;
+    while (session.has_output()) {
+        session.take_output();
+        ++batches;
+    }
+    EXPECT_EQ(calls, 64);
+    EXPECT_GT(batches, 2);
+}
+
+TEST(Session, StopsReceivingDuringProduction) {
+    size_t calls = 0;
+    const Router router = producing_router(calls);
+    const ServerConfig config{.max_request_line_size = 64,
+                              .max_headers_size = 64};
+    Session session{router, config};
+
+    session.feed("GET /large HTTP/1.1\r\n\r\n");
+    constexpr std::string_view PIPELINED = "GET /hello HTTP/1.1\r\n\r\n";
+    size_t fed = 0;
+    while (session.wants_input()) {
+        ASSERT_LT(fed, 1000) << "input isn't bounded";
+        session.feed(PIPELINED);
+        ++fed;
+    }
+    EXPECT_LT((fed - 1) * PIPELINED.size(), 128);
+
+    // everything buffered is handled once the body is out
+    std::string output;
+    while (session.has_output()) {
+        output += output_of(session);
+    }
+    EXPECT_TRUE(session.wants_input());
+    EXPECT_EQ(count(output, "HTTP/1.1 200"), fed + 1);
+}
+
+TEST(Session, StopsReceivingUntilOutputIsTaken) {
+    Router router;
+    router.add_route(HttpMethod::Get, "/page",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body(std::string(4096, 'x'))
+                             .build();
+                     });
+    const ServerConfig config{.max_requests_per_connection = 0};
+    Session session{router, config};
+
+    // a client pipelining requests without reading the responses
+    constexpr std::string_view PIPELINED = "GET /page HTTP/1.1\r\n\r\n";
+    size_t fed = 0;
+    while (session.wants_input()) {
+        ASSERT_LT(fed, 100000) << "output isn't bounded";
+        session.feed(PIPELINED);
+        ++fed;
+    }
+    // a few dozen responses, and the requests a head may take
+    EXPECT_LT(fed * PIPELINED.size(), 64 * 1024);
+
+    std::string output;
+    while (session.has_output()) {
+        output += output_of(session);
+    }
+    EXPECT_TRUE(session.wants_input());
+    EXPECT_EQ(count(output, "HTTP/1.1 200"), fed);
+}
+
+TEST(Session, EmptyPieceEndsProducedBody) {
+    size_t calls = 0;
+    Router router;
+    router.add_route(HttpMethod::Get, "/empty",
+                     [&calls](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .producer([&calls] {
+                                 return std::string{calls++ == 0 ? "abc" : ""};
+                             })
+                             .build();
+                     });
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /empty HTTP/1.1\r\n\r\n");
+    EXPECT_TRUE(output_of(session).ends_with("\r\n\r\n3\r\nabc\r\n0\r\n\r\n"));
+    EXPECT_FALSE(session.has_output());
+    EXPECT_EQ(calls, 2);
+    EXPECT_FALSE(session.should_close());
+}
+
+TEST(Session, SharesBody) {
+    const auto payload = std::make_shared<const std::string>(
+        internal::OutputBuffer::SEPARATE_CHUNK_SIZE, 'x');
+    Router router;
+    router.add_route(HttpMethod::Get, "/shared",
+                     [&](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body(payload)
+                             .build();
+                     });
+    router.add_route(HttpMethod::Get, "/segments",
+                     [&](const Request&, const PathParameters) {
+                         using namespace std::string_view_literals;
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body("[")
+                             .segment(payload)
+                             .segment(std::string{","})
+                             .segment("]"sv)
+                             .build();
+                     });
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /shared HTTP/1.1\r\n\r\n");
+    internal::OutputBuffer output = session.take_output();
+    std::array<iovec, 4> iovecs{};
+    ASSERT_EQ(output.gather(iovecs), 2);
+    EXPECT_EQ(iovecs[1].iov_base, payload->data());
+
+    session.feed("GET /segments HTTP/1.1\r\n\r\n");
+    const std::string segmented = output_of(session);
+    EXPECT_EQ(count(segmented, fmt::format("Content-Length: {}\r\n",
+                                           payload->size() + 3)),
+              1);
+    EXPECT_EQ(count(segmented, "\r\n\r\n[x"), 1);
+    EXPECT_TRUE(segmented.ends_with("x,]"));
+}
+
+TEST(Session, WritesPreparedResponse) {
+    Router router;
+    router.add_prepared_route(
+        HttpMethod::Get, "/health",
+        PreparedResponse{ResponseBuilder{HttpStatusCode::Ok_200}
+                             .content_type("text/plain")
+                             .body("ok")
+                             .build()});
+    router.set_not_found_response(PreparedResponse{
+        ResponseBuilder{HttpStatusCode::NotFound_404}.body("nope").build()});
+    const ServerConfig config;
+
+    Session session{router, config};
+    session.feed("GET /health HTTP/1.1\r\n\r\nGET /health HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    const std::string_view head =
+        "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+        "Content-Length: 2\r\nDate: ";
+    EXPECT_EQ(count(output, head), 2);
+    EXPECT_EQ(count(output, " GMT\r\n\r\nok"), 2);
+
+    // only the connection header differs between requests
+    session.feed("GET /health HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    EXPECT_EQ(count(output_of(session), "Connection: keep-alive\r\n"), 1);
+    EXPECT_FALSE(session.should_close());
+
+    session.feed("GET /missing HTTP/1.1\r\nConnection: close\r\n\r\n");
+    const std::string missing = output_of(session);
+    EXPECT_TRUE(missing.starts_with("HTTP/1.1 404"));
+    EXPECT_EQ(count(missing, "Connection: close\r\n"), 1);
+    EXPECT_TRUE(missing.ends_with("\r\n\r\nnope"));
+    EXPECT_TRUE(session.should_close());
+
+    EXPECT_THROW(PreparedResponse{ResponseBuilder{HttpStatusCode::Ok_200}
+                                      .producer([] { return std::nullopt; })
+                                      .build()},
+                 std::invalid_argument);
+}
+
+TEST(Session, HandlesRequestInArena) {
+    Router router;
+    router.add_route(HttpMethod::Get, "/arena",
+                     [](const Request&, const PathParameters) {
+                         const bool in_arena = request_memory() !=
+                                               std::pmr::get_default_resource();
+                         return ResponseBuilder{HttpStatusCode::Ok_200,
+                                                request_memory()}
+                             .header("X-In-Arena", in_arena ? "yes" : "no")
+                             .build();
+                     });
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /arena HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(count(output_of(session), "X-In-Arena: yes\r\n"), 1);
+    EXPECT_EQ(request_memory(), std::pmr::get_default_resource());
+}
+
+TEST(Session, ResponsesOutliveRequest) {
+    // larger than the initial buffer of the arena, so it would be freed
+    const std::string large(64 * 1024, 'x');
+    std::optional<Response> kept;
+    Router router;
+    router.add_route(HttpMethod::Get, "/keep",
+                     [&](const Request&, const PathParameters) {
+                         if (!kept.has_value()) {
+                             kept.emplace(
+                                 ResponseBuilder{HttpStatusCode::Ok_200}
+                                     .header("X-Large", large)
+                                     .build());
+                         }
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .header("X-Other", "other")
+                             .build();
+                     });
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /keep HTTP/1.1\r\n\r\nGET /keep HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(count(output_of(session), "X-Other: other\r\n"), 2);
+    ASSERT_TRUE(kept.has_value());
+    EXPECT_EQ(kept->headers().get("x-large"), large);
+}
+
+TEST(Session, ClosesOnFailedProduction) {
+    Router router;
+    router.add_route(HttpMethod::Get, "/short",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .producer([] { return std::nullopt; }, 10)
+                             .build();
+                     });
+    router.add_route(
+        HttpMethod::Get, "/throws", [](const Request&, const PathParameters) {
+            return ResponseBuilder{HttpStatusCode::Ok_200}
+                .producer([]() -> std::optional<std::string> {
+                    throw std::runtime_error{"no data"};
+                })
+                .build();
+        });
+    const ServerConfig config;
+
+    for (const std::string_view target : {"/short", "/throws"}) {
+        Session session{router, config};
+        session.feed(fmt::format("GET {} HTTP/1.1\r\n\r\n"
+                                 "GET /short HTTP/1.1\r\n\r\n",
+                                 target));
+        const std::string output = output_of(session);
+        EXPECT_EQ(count(output, "HTTP/1.1 200"), 1) << target;
+        EXPECT_TRUE(session.should_close()) << target;
+        EXPECT_FALSE(session.has_output()) << target;
+    }
+}
+
+namespace {
+Response static_hello(const Request&, const PathParameters params) {
+    return ResponseBuilder{HttpStatusCode::Ok_200}
+        .body(fmt::format("hello {}", params[0]))
+        .build();
+}
+}  // namespace
+
+TEST(Session, CallsStaticRoute) {
+    Router router = hello_router();
+    router.set_static_routes(
+        &StaticRoutes<StaticRoute<HttpMethod::Get, "/hello/:name",
+                                  static_hello>>::get);
+    const ServerConfig config;
+    Session session{router, config};
+
+    session.feed("GET /hello/static HTTP/1.1\r\n\r\n"
+                 "GET /hello HTTP/1.1\r\n\r\n");
+    const std::string output = output_of(session);
+    EXPECT_EQ(count(output, "HTTP/1.1 200"), 2);
+    EXPECT_EQ(count(output, "hello static"), 1);
+}
+}  // namespace waxwing
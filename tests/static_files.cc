@@ -0,0 +1,181 @@
+#include "static_files.hh"
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "waxwing/file.hh"
+#include "waxwing/http.hh"
+#include "waxwing/request.hh"
+#include "waxwing/response.hh"
+
+namespace waxwing {
+using internal::ByteRange;
+using internal::parse_range;
+using internal::resolve_path;
+
+namespace {
+/// Temporary directory with a file and whatever the tests add next to it,
+/// removed on destruction
+class TempDir final {
+    std::string path_;
+
+public:
+    TempDir() {
+        std::string pattern = "/tmp/waxwing-test-XXXXXX";
+        path_ = mkdtemp(pattern.data());
+    }
+    ~TempDir() {
+        for (const char* name : {"/hello.txt", "/pipe", "/link"}) {
+            unlink((path_ + name).c_str());
+        }
+        rmdir(path_.c_str());
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::string& path() const noexcept { return path_; }
+
+    void write(const std::string& content) const {
+        std::ofstream{path_ + "/hello.txt"} << content;
+    }
+};
+
+Response get(const internal::RequestHandler& handler,
+             const std::string_view path,
+             const std::optional<std::string_view> range = std::nullopt) {
+    RequestBuilder builder{HttpMethod::Get, std::string{path}};
+    if (range.has_value()) {
+        Headers headers;
+        headers.insert("Range", *range);
+        builder.headers(std::move(headers));
+    }
+    const Request req = std::move(builder).build();
+    const std::string_view param = path;
+    return handler(req, PathParameters{&param, 1});
+}
+}  // namespace
+
+TEST(StaticFiles, ParseRange) {
+    auto range = [](std::string_view value, size_t size) {
+        return parse_range(value, size).value();
+    };
+
+    ASSERT_TRUE(range("bytes=0-9", 100).has_value());
+    EXPECT_EQ(range("bytes=0-9", 100)->first, 0);
+    EXPECT_EQ(range("bytes=0-9", 100)->last, 9);
+    EXPECT_EQ(range("bytes=90-", 100)->length(), 10);
+    EXPECT_EQ(range("bytes=-10", 100)->first, 90);
+    EXPECT_EQ(range("bytes=-1000", 100)->first, 0);
+    EXPECT_EQ(range("bytes=50-1000", 100)->last, 99);
+
+    // ignored, so the whole file is sent
+    EXPECT_FALSE(range("bytes=0-1,5-6", 100).has_value());
+    EXPECT_FALSE(range("items=0-9", 100).has_value());
+    EXPECT_FALSE(range("bytes=9-0", 100).has_value());
+    EXPECT_FALSE(range("bytes=a-b", 100).has_value());
+
+    // unsatisfiable
+    EXPECT_FALSE(parse_range("bytes=100-", 100));
+    EXPECT_FALSE(parse_range("bytes=-0", 100));
+}
+
+TEST(StaticFiles, ResolvePath) {
+    EXPECT_EQ(resolve_path("/srv/", "js/app.js"), "/srv/js/app.js");
+    EXPECT_EQ(resolve_path("/srv", "a//./b?x=1"), "/srv/a/b");
+    EXPECT_EQ(resolve_path("/srv", "my%20file.txt"), "/srv/my file.txt");
+    EXPECT_EQ(resolve_path("/srv", ""), "/srv/index.html");
+    EXPECT_EQ(resolve_path("/srv", "docs/"), "/srv/docs/index.html");
+
+    EXPECT_FALSE(resolve_path("/srv", "../etc/passwd").has_value());
+    EXPECT_FALSE(resolve_path("/srv", "a/%2e%2e/%2e%2e/etc").has_value());
+    EXPECT_FALSE(resolve_path("/srv", "a%2f..%2f..").has_value());
+    EXPECT_FALSE(resolve_path("/srv", "a%00.txt").has_value());
+    EXPECT_FALSE(resolve_path("/srv", "a%2").has_value());
+}
+
+TEST(StaticFiles, ContentType) {
+    EXPECT_EQ(internal::content_type_of("/a/index.HTML"), content_type::html);
+    EXPECT_EQ(internal::content_type_of("logo.png"), content_type::png);
+    EXPECT_EQ(internal::content_type_of("a.d/file"),
+              content_type::octet_stream);
+}
+
+TEST(StaticFiles, ServesFiles) {
+    TempDir dir;
+    dir.write("hello world");
+    const internal::RequestHandler handler =
+        internal::static_files_handler(dir.path());
+
+    Response full = get(handler, "hello.txt");
+    EXPECT_EQ(full.status(), HttpStatusCode::Ok_200);
+    EXPECT_EQ(full.headers().get("content-type"), content_type::plaintext);
+    std::optional<FileRange> body = full.take_file_body();
+    ASSERT_TRUE(body.has_value());
+    EXPECT_EQ(body->offset, 0);
+    EXPECT_EQ(body->length, 11);
+
+    Response partial = get(handler, "hello.txt", "bytes=6-");
+    EXPECT_EQ(partial.status(), HttpStatusCode::PartialContent_206);
+    EXPECT_EQ(partial.headers().get("content-range"), "bytes 6-10/11");
+    body = partial.take_file_body();
+    ASSERT_TRUE(body.has_value());
+    EXPECT_EQ(body->offset, 6);
+    EXPECT_EQ(body->length, 5);
+
+    Response unsatisfiable = get(handler, "hello.txt", "bytes=20-");
+    EXPECT_EQ(unsatisfiable.status(), HttpStatusCode::RangeNotSatisfiable_416);
+    EXPECT_EQ(unsatisfiable.headers().get("content-range"), "bytes */11");
+
+    EXPECT_EQ(get(handler, "missing.txt").status(),
+              HttpStatusCode::NotFound_404);
+    EXPECT_EQ(get(handler, "../hello.txt").status(),
+              HttpStatusCode::NotFound_404);
+}
+
+TEST(StaticFiles, CacheNoticesChanges) {
+    TempDir dir;
+    dir.write("hello");
+    internal::FileCache cache{4, std::chrono::seconds{0}};
+
+    auto first = cache.open(dir.path() + "/hello.txt");
+    ASSERT_TRUE(first);
+    EXPECT_EQ((*first)->size(), 5);
+
+    auto cached = cache.open(dir.path() + "/hello.txt");
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(cached->get(), first->get());
+
+    dir.write("hello world");
+    auto changed = cache.open(dir.path() + "/hello.txt");
+    ASSERT_TRUE(changed);
+    EXPECT_EQ((*changed)->size(), 11);
+}
+
+TEST(StaticFiles, ServesOnlyRegularFiles) {
+    TempDir dir;
+    dir.write("hello");
+    ASSERT_EQ(mkfifo((dir.path() + "/pipe").c_str(), 0600), 0);
+    ASSERT_EQ(symlink((dir.path() + "/hello.txt").c_str(),
+                      (dir.path() + "/link").c_str()),
+              0);
+
+    // opening the FIFO must not wait for a writer
+    EXPECT_FALSE(File::open(dir.path() + "/pipe"));
+    EXPECT_FALSE(File::open(dir.path() + "/link"));
+    EXPECT_FALSE(File::open(dir.path()));
+
+    const internal::RequestHandler handler =
+        internal::static_files_handler(dir.path());
+    EXPECT_EQ(get(handler, "pipe").status(), HttpStatusCode::NotFound_404);
+    EXPECT_EQ(get(handler, "link").status(), HttpStatusCode::NotFound_404);
+    EXPECT_EQ(get(handler, "hello.txt").status(), HttpStatusCode::Ok_200);
+}
+}  // namespace waxwing
@@ -0,0 +1,179 @@
+#include "waxwing/static_routes.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "waxwing/router.hh"
+
+namespace waxwing {
+namespace {
+/// Handler answering with its name followed by the path parameters
+template <const char* Name>
+Response named(const Request&, const PathParameters params) {
+    std::string body{Name};
+    for (const std::string_view param : params) {
+        body += param;
+    }
+    return ResponseBuilder{HttpStatusCode::Ok_200}.body(body).build();
+}
+
+constexpr char FOO[] = "foo";
+constexpr char BAR[] = "bar";
+constexpr char BAZ[] = "baz";
+constexpr char USER[] = "user";
+constexpr char ME[] = "me";
+
+using Routes =
+    StaticRoutes<StaticRoute<HttpMethod::Get, "/:bar", named<BAR>>,
+                 StaticRoute<HttpMethod::Get, "/*baz", named<BAZ>>,
+                 StaticRoute<HttpMethod::Get, "/foo", named<FOO>>,
+                 StaticRoute<HttpMethod::Get, "/foo/bar", named<FOO>>,
+                 StaticRoute<HttpMethod::Get, "/users/:id/", named<USER>>,
+                 StaticRoute<HttpMethod::Put, "/users/:id/", named<USER>>,
+                 StaticRoute<HttpMethod::Get, "/users/me/", named<ME>>>;
+
+std::string body_of(const internal::RoutingResult& result) {
+    const Request req = RequestBuilder(HttpMethod::Get, "").build();
+    return std::string{
+        result.function()(req, result.parameters()).body().value_or("")};
+}
+}  // namespace
+
+TEST(StaticRoutes, RoutesLikeTree) {
+    internal::RouteTree tree;
+    const std::vector<std::pair<HttpMethod, std::string_view>> routes{
+        {HttpMethod::Get, "/:bar"},       {HttpMethod::Get, "/*baz"},
+        {HttpMethod::Get, "/foo"},        {HttpMethod::Get, "/foo/bar"},
+        {HttpMethod::Get, "/users/:id/"}, {HttpMethod::Put, "/users/:id/"},
+        {HttpMethod::Get, "/users/me/"},
+    };
+    for (size_t i = 0; i < routes.size(); ++i) {
+        tree.insert(routes[i].first, routes[i].second,
+                    internal::Route{.config = {.max_body_size = i}});
+    }
+
+    for (const std::string_view target :
+         {"/foo", "/b", "/", "", "/foo/bar", "/foo/baz", "/users/42/",
+          "/users/me/", "/users/me", "/users//"}) {
+        internal::MethodMask allowed = 0;
+        internal::MethodMask expected_allowed = 0;
+        const std::optional<internal::RoutingResult> result =
+            Routes::get(HttpMethod::Get, target, allowed);
+        const std::optional<internal::RoutingResult> expected =
+            tree.get(HttpMethod::Get, target, expected_allowed);
+        ASSERT_EQ(result.has_value(), expected.has_value()) << target;
+        EXPECT_EQ(allowed, expected_allowed) << target;
+        if (!result.has_value()) {
+            continue;
+        }
+        const PathParameters params = result->parameters();
+        const PathParameters expected_params = expected->parameters();
+        EXPECT_EQ(std::vector(params.begin(), params.end()),
+                  std::vector(expected_params.begin(), expected_params.end()))
+            << target;
+    }
+
+    internal::MethodMask allowed = 0;
+    EXPECT_EQ(body_of(*Routes::get(HttpMethod::Get, "/foo", allowed)), "foo");
+    EXPECT_EQ(body_of(*Routes::get(HttpMethod::Get, "/b", allowed)), "barb");
+    EXPECT_EQ(body_of(*Routes::get(HttpMethod::Get, "/", allowed)), "baz");
+    EXPECT_EQ(body_of(*Routes::get(HttpMethod::Get, "/users/me/", allowed)),
+              "me");
+    EXPECT_EQ(body_of(*Routes::get(HttpMethod::Put, "/users/me/", allowed)),
+              "userme");
+}
+
+TEST(StaticRoutes, ResolvesAmbiguityLikeTree) {
+    using Ambiguous =
+        StaticRoutes<StaticRoute<HttpMethod::Get, "/a/*w/end", named<FOO>>,
+                     StaticRoute<HttpMethod::Get, "/:p/a/x", named<FOO>>,
+                     StaticRoute<HttpMethod::Get, "/*w/:q/end", named<FOO>>,
+                     StaticRoute<HttpMethod::Get, "/a/a/:r", named<FOO>>,
+                     StaticRoute<HttpMethod::Put, "/:p/:q/:r", named<FOO>>,
+                     StaticRoute<HttpMethod::Get, "/:p/*w", named<FOO>>>;
+    internal::RouteTree tree;
+    for (const auto& [method, target] :
+         std::vector<std::pair<HttpMethod, std::string_view>>{
+             {HttpMethod::Get, "/a/*w/end"},
+             {HttpMethod::Get, "/:p/a/x"},
+             {HttpMethod::Get, "/*w/:q/end"},
+             {HttpMethod::Get, "/a/a/:r"},
+             {HttpMethod::Put, "/:p/:q/:r"},
+             {HttpMethod::Get, "/:p/*w"},
+         }) {
+        tree.insert(method, target, internal::Route{});
+    }
+
+    std::vector<std::string> targets{""};
+    for (size_t depth = 0; depth < 3; ++depth) {
+        const size_t size = targets.size();
+        for (size_t i = 0; i < size; ++i) {
+            for (const std::string_view component : {"a", "x", "end", ""}) {
+                targets.push_back(targets[i] + "/" + std::string{component});
+            }
+        }
+    }
+    for (const std::string& target : targets) {
+        for (const HttpMethod method : {HttpMethod::Get, HttpMethod::Put}) {
+            internal::MethodMask allowed = 0;
+            internal::MethodMask expected_allowed = 0;
+            const std::optional<internal::RoutingResult> result =
+                Ambiguous::get(method, target, allowed);
+            const std::optional<internal::RoutingResult> expected =
+                tree.get(method, target, expected_allowed);
+            ASSERT_EQ(result.has_value(), expected.has_value()) << target;
+            EXPECT_EQ(allowed, expected_allowed) << target;
+            if (!result.has_value()) {
+                continue;
+            }
+            const PathParameters params = result->parameters();
+            const PathParameters expected_params = expected->parameters();
+            EXPECT_EQ(
+                std::vector(params.begin(), params.end()),
+                std::vector(expected_params.begin(), expected_params.end()))
+                << target;
+        }
+    }
+}
+
+TEST(StaticRoutes, TakePrecedenceInRouter) {
+    internal::Router router;
+    router.add_route(HttpMethod::Get, "/foo",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body("dynamic")
+                             .build();
+                     });
+    router.add_route(HttpMethod::Post, "/users/:id/",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .build();
+                     });
+    router.add_route(HttpMethod::Get, "/users/you/",
+                     [](const Request&, const PathParameters) {
+                         return ResponseBuilder{HttpStatusCode::Ok_200}
+                             .body("you")
+                             .build();
+                     });
+    router.set_static_routes(&Routes::get);
+
+    EXPECT_EQ(body_of(router.route(HttpMethod::Get, "/foo")), "foo");
+    // the static table is looked at first, even where a literal of the added
+    // routes would win over its parameter
+    EXPECT_EQ(body_of(router.route(HttpMethod::Get, "/users/you/")),
+              "useryou");
+
+    // methods of both kinds of routes are allowed
+    const internal::RoutingResult result =
+        router.route(HttpMethod::Delete, "/users/42/");
+    EXPECT_FALSE(result.found());
+    EXPECT_EQ(internal::format_allowed_methods(result.allowed_methods()),
+              "GET, POST, PUT");
+}
+}  // namespace waxwing
@@ -7,6 +7,7 @@ using namespace std::literals;
 
 namespace {
 using waxwing::str_util::case_insensitive_eq;
+using waxwing::str_util::case_insensitive_hash;
 using waxwing::str_util::ltrim;
 using waxwing::str_util::rtrim;
 using waxwing::str_util::split;
@@ -136,4 +137,12 @@ TEST(CaseInsensitiveEq, Basic) {
     EXPECT_FALSE(case_insensitive_eq("foo", "bar"));
     EXPECT_FALSE(case_insensitive_eq("foo", "fo"));
 }
+
+TEST(CaseInsensitiveHash, Basic) {
+    EXPECT_EQ(case_insensitive_hash("Content-Length"),
+              case_insensitive_hash("content-length"));
+    EXPECT_EQ(case_insensitive_hash("HOST"), case_insensitive_hash("host"));
+
+    EXPECT_NE(case_insensitive_hash("host"), case_insensitive_hash("hosts"));
+}
 }  // namespace